@@ -0,0 +1,155 @@
+#include "../src/batch.h"
+#include "../src/cpu.h"
+#include "../src/gameboy.h"
+#include "../src/interrupt.h"
+#include "../src/mmu.h"
+#include "../src/ppu.h"
+#include "../src/timer.h"
+#include "../tests/fixtures.h"
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+
+timer bench_timer{};
+interrupt bench_interrupt{};
+
+sf::RenderWindow window(sf::VideoMode({160 * draw::SCALE, 144 * draw::SCALE}),
+                        "RiceBoy");
+
+ppu bench_ppu{bench_interrupt, window};
+
+joypad bench_joypad{};
+
+flat_mmu test_mmu{bench_timer, bench_interrupt, bench_ppu, bench_joypad};
+
+cpu bench_cpu = cpu(test_mmu, bench_timer, bench_interrupt);
+
+static void load_loop_program() {
+    for (unsigned int i = 0; i < loop_program.size(); ++i) {
+        test_mmu.memory[0x0100 + i] = loop_program[i];
+    }
+    test_mmu.memory[0xff50] = 1; // boot rom complete
+    bench_cpu.PC = 0x0100;
+}
+
+// instructions per second, executed one instruction at a time like the sst
+// tests
+static void BM_cpu_instructions(benchmark::State &state) {
+    load_loop_program();
+    int64_t instructions = 0;
+
+    for (auto _ : state) {
+        for (int i = 0; i < 1000; ++i) {
+            bench_cpu.identify_opcode(bench_cpu._get(bench_cpu.PC));
+            while (!bench_cpu.M_operations.empty()) {
+                bench_cpu.execute_M_operations();
+            }
+        }
+        instructions += 1000;
+    }
+
+    state.SetItemsProcessed(instructions);
+}
+BENCHMARK(BM_cpu_instructions);
+
+// M-cycles per second through cpu::tick (interrupt checks, dma checks)
+static void BM_cpu_tick(benchmark::State &state) {
+    load_loop_program();
+    int64_t m_cycles = 0;
+
+    for (auto _ : state) {
+        for (int i = 0; i < 4000; ++i) {
+            bench_cpu.tick();
+        }
+        m_cycles += 1000;
+    }
+
+    state.SetItemsProcessed(m_cycles);
+}
+BENCHMARK(BM_cpu_tick);
+
+// register heavy loop for the batch core, lanes start from different B
+constexpr std::array<uint8_t, 0x13> lane_program{
+    0x3e, 0x01, // 0100: ld a, 01
+    0x80,       // 0102: add a, b
+    0x04,       // 0103: inc b
+    0xa9,       // 0104: xor c
+    0x4f,       // 0105: ld c, a
+    0x91,       // 0106: sub c
+    0x5f,       // 0107: ld e, a
+    0x83,       // 0108: add a, e
+    0x2f,       // 0109: cpl
+    0xe6, 0x7f, // 010a: and 7f
+    0x57,       // 010c: ld d, a
+    0x15,       // 010d: dec d
+    0x8a,       // 010e: adc a, d
+    0x3c,       // 010f: inc a
+    0x18, 0xf0, // 0110: jr 0102
+    0x00,
+};
+
+// instructions per second per lane of the lockstep batch core, lanes given by
+// the argument. lockstep is the share of instructions run across lanes
+static void BM_batch_lanes(benchmark::State &state) {
+    const std::size_t lanes = static_cast<std::size_t>(state.range(0));
+    batch lanes_batch(lanes, window);
+
+    std::array<uint8_t, 0x8000> rom{};
+    std::copy(lane_program.begin(), lane_program.end(), rom.begin() + 0x0100);
+    lanes_batch.load_rom(rom.data(), rom.size());
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+        lanes_batch.B[lane] = static_cast<uint8_t>(lane);
+        lanes_batch.SP[lane] = 0xfffe;
+        lanes_batch.PC[lane] = 0x0100;
+    }
+
+    int64_t steps = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < 1000; ++i) {
+            lanes_batch.step();
+        }
+        steps += 1000;
+    }
+
+    state.SetItemsProcessed(steps * static_cast<int64_t>(lanes));
+    state.counters["lane_instructions"] = benchmark::Counter(
+        static_cast<double>(steps), benchmark::Counter::kIsRate);
+    state.counters["lockstep"] =
+        static_cast<double>(lanes_batch.lockstep_instructions) /
+        static_cast<double>(lanes_batch.lockstep_instructions +
+                            lanes_batch.scalar_instructions);
+}
+BENCHMARK(BM_batch_lanes)->Arg(1)->Arg(8)->Arg(32)->Arg(64);
+
+// one emulated frame (70224 T-cycles) per iteration of a whole gameboy: the
+// loop program as a rom, lcd on with 10 sprites. argument 1 runs it in fast
+// mode. built with -DBENCHMARK_ENABLE_LIBPFM=ON, running with
+// --benchmark_perf_counters=L1-dcache-load-misses gives the L1 misses per
+// frame
+static void BM_frame(benchmark::State &state) {
+    std::unique_ptr<gameboy> instance = boot_instance(loop_rom());
+    instance->mode = state.range(0) ? gameboy::execution_mode::fast
+                                    : gameboy::execution_mode::accurate;
+
+    instance->gb_ppu.lcdc_ff40 |= 0x02; // sprites on
+    for (uint8_t sprite = 0; sprite < 10; ++sprite) {
+        instance->gb_ppu.oam_ram[sprite * 4] = 16 + sprite * 12;  // y
+        instance->gb_ppu.oam_ram[sprite * 4 + 1] = 8 + sprite * 15; // x
+    }
+    instance->run(70224); // settle into the frame loop
+
+    int64_t frames = 0;
+    for (auto _ : state) {
+        instance->run(70224);
+        frames++;
+    }
+
+    state.counters["frames"] =
+        benchmark::Counter(static_cast<double>(frames),
+                           benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_frame)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,334 @@
+#include "../src/cpu.h"
+#include "../src/interrupt.h"
+#include "../src/mmu.h"
+#include "../src/ppu.h"
+#include "../src/timer.h"
+#include "../tests/fixtures.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+using json = nlohmann::json;
+
+// time per instruction of every base and cb opcode, run through
+// identify_opcode + execute_M_operations like tests/sst.cpp with the same
+// sm83 vectors. the json is parsed once into a binary cache, after that a run
+// only reads the cache. opcodes far slower per M-cycle than the median are
+// listed at the end
+
+timer vector_timer{};
+interrupt vector_interrupt{};
+
+sf::RenderWindow window(sf::VideoMode({160 * draw::SCALE, 144 * draw::SCALE}),
+                        "RiceBoy");
+
+ppu vector_ppu{vector_interrupt, window};
+
+joypad vector_joypad{};
+
+flat_mmu test_mmu{vector_timer, vector_interrupt, vector_ppu, vector_joypad};
+
+cpu vector_cpu = cpu(test_mmu, vector_timer, vector_interrupt);
+
+namespace vectors {
+
+// a vector's initial state, its ram is ram_count entries of the opcode's ram
+// from ram_first
+struct initial_state {
+    uint16_t pc{};
+    uint16_t sp{};
+    uint8_t a{};
+    uint8_t b{};
+    uint8_t c{};
+    uint8_t d{};
+    uint8_t e{};
+    uint8_t f{};
+    uint8_t h{};
+    uint8_t l{};
+    uint8_t ime{};
+    uint8_t ram_count{};
+    uint32_t ram_first{};
+};
+
+struct ram_entry {
+    uint16_t address{};
+    uint8_t value{};
+};
+
+struct opcode_vectors {
+    uint16_t opcode{};   // 00-ff, cb00-cbff for the cb opcodes
+    uint32_t m_cycles{}; // of all the vectors together
+    std::vector<initial_state> states;
+    std::vector<ram_entry> ram;
+};
+
+// bumped whenever the layout above changes
+constexpr char cache_magic[8] = {'r', 'b', 's', 'm', '8', '3', 0, 1};
+
+template <typename T> void write_array(std::ofstream &f, const T &values) {
+    const uint32_t count = static_cast<uint32_t>(values.size());
+    f.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    f.write(reinterpret_cast<const char *>(values.data()),
+            static_cast<std::streamsize>(count * sizeof(values[0])));
+}
+
+template <typename T> bool read_array(std::ifstream &f, T &values) {
+    uint32_t count{};
+    if (!f.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+        return false;
+    }
+    values.resize(count);
+    return static_cast<bool>(
+        f.read(reinterpret_cast<char *>(values.data()),
+               static_cast<std::streamsize>(count * sizeof(values[0]))));
+}
+
+bool read_cache(const std::filesystem::path &cache,
+                std::vector<opcode_vectors> &opcodes) {
+    std::ifstream f(cache, std::ios::binary);
+    char magic[sizeof(cache_magic)]{};
+    if (!f.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, cache_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    uint32_t count{};
+    if (!f.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+        return false;
+    }
+    opcodes.resize(count);
+    for (opcode_vectors &opcode : opcodes) {
+        if (!f.read(reinterpret_cast<char *>(&opcode.opcode),
+                    sizeof(opcode.opcode)) ||
+            !f.read(reinterpret_cast<char *>(&opcode.m_cycles),
+                    sizeof(opcode.m_cycles)) ||
+            !read_array(f, opcode.states) || !read_array(f, opcode.ram)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void write_cache(const std::filesystem::path &cache,
+                 const std::vector<opcode_vectors> &opcodes) {
+    std::ofstream f(cache, std::ios::binary);
+    f.write(cache_magic, sizeof(cache_magic));
+    const uint32_t count = static_cast<uint32_t>(opcodes.size());
+    f.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (const opcode_vectors &opcode : opcodes) {
+        f.write(reinterpret_cast<const char *>(&opcode.opcode),
+                sizeof(opcode.opcode));
+        f.write(reinterpret_cast<const char *>(&opcode.m_cycles),
+                sizeof(opcode.m_cycles));
+        write_array(f, opcode.states);
+        write_array(f, opcode.ram);
+    }
+}
+
+// sm83/v1/xx.json or sm83/v1/cb xx.json, false when the opcode has none
+bool parse_opcode(const std::filesystem::path &directory,
+                  const uint16_t opcode, opcode_vectors &vectors) {
+    std::stringstream ss;
+    ss << (opcode > 0xff ? "cb " : "") << std::hex << std::setfill('0')
+       << std::setw(2) << (opcode & 0xff) << ".json";
+    std::ifstream f(directory / ss.str());
+    if (!f) {
+        return false;
+    }
+
+    vectors.opcode = opcode;
+    for (const json &test : json::parse(f)) {
+        const json &initial = test.at("initial");
+        initial_state state{};
+        initial.at("pc").get_to(state.pc);
+        initial.at("sp").get_to(state.sp);
+        initial.at("a").get_to(state.a);
+        initial.at("b").get_to(state.b);
+        initial.at("c").get_to(state.c);
+        initial.at("d").get_to(state.d);
+        initial.at("e").get_to(state.e);
+        initial.at("f").get_to(state.f);
+        initial.at("h").get_to(state.h);
+        initial.at("l").get_to(state.l);
+        initial.at("ime").get_to(state.ime);
+        state.f &= 0xf0; // the 4 LSBs of F are always 0
+        state.ram_first = static_cast<uint32_t>(vectors.ram.size());
+        for (const json &entry : initial.at("ram")) {
+            vectors.ram.push_back(ram_entry{entry[0].get<uint16_t>(),
+                                            entry[1].get<uint8_t>()});
+            state.ram_count++;
+        }
+        vectors.states.push_back(state);
+        vectors.m_cycles += static_cast<uint32_t>(test.at("cycles").size());
+    }
+    return true;
+}
+
+// the cache if it's there, the json otherwise (and the cache is written)
+std::vector<opcode_vectors> load(const std::filesystem::path &directory,
+                                 const std::filesystem::path &cache) {
+    std::vector<opcode_vectors> opcodes;
+    if (read_cache(cache, opcodes)) {
+        return opcodes;
+    }
+
+    std::cerr << "parsing " << directory << ", cached in " << cache << '\n';
+    opcodes.clear();
+    for (uint16_t opcode = 0; opcode <= 0xcbff;
+         opcode = opcode == 0xff ? 0xcb00 : opcode + 1) {
+        opcode_vectors vectors{};
+        if (parse_opcode(directory, opcode, vectors)) {
+            opcodes.push_back(std::move(vectors));
+        }
+    }
+    write_cache(cache, opcodes);
+    return opcodes;
+}
+
+} // namespace vectors
+
+// every vector of one opcode per iteration
+static void BM_opcode(benchmark::State &state,
+                      const vectors::opcode_vectors *opcode) {
+    for (auto _ : state) {
+        for (const vectors::initial_state &initial : opcode->states) {
+            vector_cpu.PC = initial.pc;
+            vector_cpu.SP = initial.sp;
+            vector_cpu.A = initial.a;
+            vector_cpu.B = initial.b;
+            vector_cpu.C = initial.c;
+            vector_cpu.D = initial.d;
+            vector_cpu.E = initial.e;
+            vector_cpu.sync_flags(); // drop flags left pending by the last one
+            vector_cpu.F = initial.f;
+            vector_cpu.H = initial.h;
+            vector_cpu.L = initial.l;
+            vector_interrupt.ime = initial.ime;
+            for (uint32_t i = 0; i < initial.ram_count; ++i) {
+                const vectors::ram_entry &entry =
+                    opcode->ram[initial.ram_first + i];
+                test_mmu.memory[entry.address] = entry.value;
+            }
+
+            vector_cpu.identify_opcode(vector_cpu._get(vector_cpu.PC));
+            while (!vector_cpu.M_operations.empty()) {
+                vector_cpu.execute_M_operations();
+            }
+            // halt and stop have nothing to wake them here
+            vector_cpu.halt = false;
+            vector_cpu.halt_bug = false;
+        }
+    }
+
+    const double instructions = static_cast<double>(opcode->states.size());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(opcode->states.size()));
+    state.counters["per_instruction"] = benchmark::Counter(
+        instructions, benchmark::Counter::kIsIterationInvariantRate |
+                          benchmark::Counter::kInvert);
+}
+
+// the console output, then the opcodes whose time per M-cycle is more than
+// outlier_factor times the median
+class outlier_reporter : public benchmark::ConsoleReporter {
+  public:
+    static constexpr double outlier_factor{2.0};
+
+    // average M-cycles per instruction, by benchmark name
+    std::map<std::string, double> m_cycles;
+
+    void ReportRuns(const std::vector<Run> &reports) override {
+        benchmark::ConsoleReporter::ReportRuns(reports);
+        for (const Run &run : reports) {
+            const auto counter = run.counters.find("per_instruction");
+            const auto cycles = this->m_cycles.find(run.benchmark_name());
+            if (run.run_type != Run::RT_Iteration ||
+                counter == run.counters.end() || cycles == m_cycles.end()) {
+                continue;
+            }
+            this->per_m_cycle.emplace_back(
+                counter->second.value * 1e9 / cycles->second,
+                run.benchmark_name());
+        }
+    }
+
+    void Finalize() override {
+        benchmark::ConsoleReporter::Finalize();
+        if (this->per_m_cycle.empty()) {
+            return;
+        }
+        std::vector<std::pair<double, std::string>> sorted = this->per_m_cycle;
+        std::sort(sorted.begin(), sorted.end());
+        const double median = sorted[sorted.size() / 2].first;
+
+        std::ostream &out = this->GetOutputStream();
+        out << std::fixed << std::setprecision(2) << "\nmedian " << median
+            << " ns per M-cycle, outliers above " << outlier_factor << "x:\n";
+        auto it = sorted.rbegin();
+        for (; it != sorted.rend() && it->first > median * outlier_factor;
+             ++it) {
+            out << "  " << it->second << ": " << it->first
+                << " ns per M-cycle (" << it->first / median << "x)\n";
+        }
+        if (it == sorted.rbegin()) {
+            out << "  none\n";
+        }
+    }
+
+  private:
+    std::vector<std::pair<double, std::string>> per_m_cycle;
+};
+
+// --vectors=<dir> and --cache=<file> override where the vectors are read from
+// and cached, the rest goes to google benchmark
+int main(int argc, char **argv) {
+    std::filesystem::path directory{RICEBOY_SM83_VECTORS};
+    std::filesystem::path cache{RICEBOY_SM83_CACHE};
+    std::vector<char *> arguments;
+    for (int i = 0; i < argc; ++i) {
+        const std::string argument{argv[i]};
+        if (argument.rfind("--vectors=", 0) == 0) {
+            directory = argument.substr(10);
+        } else if (argument.rfind("--cache=", 0) == 0) {
+            cache = argument.substr(8);
+        } else {
+            arguments.push_back(argv[i]);
+        }
+    }
+    int count = static_cast<int>(arguments.size());
+    benchmark::Initialize(&count, arguments.data());
+    if (benchmark::ReportUnrecognizedArguments(count, arguments.data())) {
+        return 1;
+    }
+
+    const std::vector<vectors::opcode_vectors> opcodes =
+        vectors::load(directory, cache);
+    if (opcodes.empty()) {
+        std::cerr << "no vectors in " << directory << '\n';
+        return 1;
+    }
+    test_mmu.memory[0xff50] = 1; // boot rom complete
+
+    outlier_reporter reporter;
+    for (const vectors::opcode_vectors &opcode : opcodes) {
+        std::stringstream name;
+        name << (opcode.opcode > 0xff ? "BM_opcode_cb/" : "BM_opcode/")
+             << std::hex << std::setfill('0') << std::setw(2)
+             << (opcode.opcode & 0xff);
+        benchmark::RegisterBenchmark(name.str().c_str(), BM_opcode, &opcode);
+        reporter.m_cycles[name.str()] =
+            static_cast<double>(opcode.m_cycles) /
+            static_cast<double>(opcode.states.size());
+    }
+
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "aot.h"
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace {
+
+void *open_library(const std::string &path) {
+#ifdef _WIN32
+    return reinterpret_cast<void *>(LoadLibraryA(path.c_str()));
+#else
+    // without a slash dlopen searches the library path instead
+    const std::string local =
+        path.find('/') == std::string::npos ? "./" + path : path;
+    return dlopen(local.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+const void *symbol(void *library, const char *name) {
+#ifdef _WIN32
+    return reinterpret_cast<const void *>(
+        GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+    return dlsym(library, name);
+#endif
+}
+
+void close_library(void *library) {
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+}
+
+} // namespace
+
+aot::~aot() { this->unload(); }
+
+void aot::load(const std::string &rom, const char *bytes,
+               const std::size_t size) {
+    this->unload();
+
+    const std::string path = plugin_path(rom);
+    void *library = open_library(path);
+    if (!library) {
+        return;
+    }
+
+    const auto *abi =
+        static_cast<const uint32_t *>(symbol(library, "riceboy_aot_abi"));
+    const auto *hash =
+        static_cast<const uint64_t *>(symbol(library, "riceboy_aot_rom_hash"));
+    const auto *count = static_cast<const uint32_t *>(
+        symbol(library, "riceboy_aot_entry_count"));
+    const auto *table =
+        static_cast<const entry *>(symbol(library, "riceboy_aot_entries"));
+    if (!abi || !hash || !count || !table || *abi != abi_version) {
+        std::cerr << path << ": not a riceboy-aot plugin for this build\n";
+        close_library(library);
+        return;
+    }
+    if (*hash != shared_code::rom_hash(bytes, size)) {
+        // built from another version of the rom
+        std::cerr << path << ": built from a different rom, ignored\n";
+        close_library(library);
+        return;
+    }
+
+    this->library = library;
+    this->banks = static_cast<uint16_t>(size / 0x4000);
+    for (uint32_t i = 0; i < *count; ++i) {
+        this->entries.emplace((table[i].bank << 16) | table[i].pc, &table[i]);
+    }
+}
+
+void aot::unload() {
+    this->entries.clear();
+    if (this->library) {
+        close_library(this->library);
+        this->library = nullptr;
+    }
+}
+
+const aot::entry *aot::find(const uint16_t bank, const uint16_t pc) const {
+    if (this->entries.empty()) {
+        return nullptr;
+    }
+    // the switchable bank wraps around the rom like mbc1 reads do
+    const uint32_t wrapped =
+        pc >= 0x4000 && this->banks ? bank % this->banks : bank;
+    const auto found = this->entries.find((wrapped << 16) | pc);
+    return found == this->entries.end() ? nullptr : found->second;
+}
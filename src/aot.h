@@ -0,0 +1,92 @@
+#pragma once
+
+#include "block_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// ahead-of-time compiled rom code (RICEBOY_AOT builds only). riceboy-aot
+// (tools/) translates the register only prefix of the rom blocks it can reach
+// into C++ and builds <rom>.aot.so next to the rom, load_rom() picks it up if
+// it was built from the same bytes. blocks run like jit blocks, the
+// interpreter takes over at the first instruction touching memory
+class aot {
+  public:
+    // the guest registers a block works on, copied in and out of the cpu.
+    // pairs overlay their halves the way the cpu's do
+    struct registers {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        union { uint16_t AF; struct { uint8_t A, F; }; };
+        union { uint16_t BC; struct { uint8_t B, C; }; };
+        union { uint16_t DE; struct { uint8_t D, E; }; };
+        union { uint16_t HL; struct { uint8_t H, L; }; };
+#else
+        union { uint16_t AF; struct { uint8_t F, A; }; };
+        union { uint16_t BC; struct { uint8_t C, B; }; };
+        union { uint16_t DE; struct { uint8_t E, D; }; };
+        union { uint16_t HL; struct { uint8_t L, H; }; };
+#endif
+        uint16_t SP;
+        uint16_t PC;
+    };
+
+    // runs the instructions and sets PC, returns the M-cycles they took
+    using block_function = uint8_t (*)(registers *);
+
+    // the block at pc in a rom bank (bank 0 below 0x4000) runs function for
+    // its first length instructions
+    struct entry {
+        uint16_t bank;
+        uint16_t pc;
+        uint8_t length;
+        block_function function;
+    };
+
+    // plugins export riceboy_aot_abi, riceboy_aot_rom_hash
+    // (shared_code::rom_hash), riceboy_aot_entry_count and
+    // riceboy_aot_entries. bump the version when any of them or the structs
+    // above change
+    static constexpr uint32_t abi_version{1};
+
+    aot() = default;
+    ~aot();
+    aot(const aot &) = delete;
+    aot &operator=(const aot &) = delete;
+
+    // load the plugin built for the rom file, if it matches its bytes.
+    // anything loaded before is dropped, blocks using it must be dropped too
+    void load(const std::string &rom, const char *bytes,
+              const std::size_t size);
+    void unload();
+
+    // the compiled block at pc, bank as the mmu numbers it. nullptr if none
+    const entry *find(const uint16_t bank, const uint16_t pc) const;
+
+    // <rom without its extension>.aot.so (.aot.dll on windows)
+    static std::string plugin_path(const std::string &rom) {
+        const std::size_t slash = rom.find_last_of("/\\");
+        const std::size_t dot = rom.find_last_of('.');
+        const bool extension = dot != std::string::npos &&
+                               (slash == std::string::npos || dot > slash);
+        const std::string base = extension ? rom.substr(0, dot) : rom;
+#ifdef _WIN32
+        return base + ".aot.dll";
+#else
+        return base + ".aot.so";
+#endif
+    }
+
+  private:
+    void *library{nullptr};
+    uint16_t banks{0};
+
+    // keyed by bank << 16 | pc
+    std::unordered_map<uint32_t, const entry *> entries{};
+};
+
+#ifdef _WIN32
+#define RICEBOY_AOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define RICEBOY_AOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
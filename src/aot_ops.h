@@ -0,0 +1,149 @@
+#pragma once
+
+#include "aot.h"
+#include <cstdint>
+
+// what riceboy-aot plugins are written with: the register only instructions
+// on aot::registers, flags as cpu::sync_flags() would leave them
+namespace aot_ops {
+
+using registers = aot::registers;
+
+constexpr uint8_t flag_z{0x80};
+constexpr uint8_t flag_n{0x40};
+constexpr uint8_t flag_h{0x20};
+constexpr uint8_t flag_c{0x10};
+
+// same order as the cpu's, y of the opcode
+enum alu_op { add, adc, sub, sbc, logic_and, logic_xor, logic_or, cp };
+enum rot_op { rlc, rrc, rl, rr, sla, sra, swap, srl };
+
+inline uint8_t flags(const bool z, const bool n, const bool h, const bool c) {
+    return (z << 7) | (n << 6) | (h << 5) | (c << 4);
+}
+
+inline uint8_t carry(const registers &r) { return (r.F >> 4) & 1; }
+
+template <alu_op op> void alu(registers &r, const uint8_t y) {
+    const uint8_t x = r.A;
+    if constexpr (op == add || op == adc) {
+        const uint8_t c = op == adc ? carry(r) : 0;
+        r.F = flags(static_cast<uint8_t>(x + y + c) == 0, false,
+                    (x & 0xf) + (y & 0xf) + c > 0xf, x + y + c > 0xff);
+        r.A = x + y + c;
+    } else if constexpr (op == sub || op == sbc || op == cp) {
+        const uint8_t c = op == sbc ? carry(r) : 0;
+        r.F = flags(static_cast<uint8_t>(x - y - c) == 0, true,
+                    (x & 0xf) < (y & 0xf) + c, x - y - c < 0);
+        if constexpr (op != cp) {
+            r.A = x - y - c;
+        }
+    } else if constexpr (op == logic_and) {
+        r.A = x & y;
+        r.F = flags(r.A == 0, false, true, false);
+    } else if constexpr (op == logic_xor) {
+        r.A = x ^ y;
+        r.F = flags(r.A == 0, false, false, false);
+    } else {
+        r.A = x | y;
+        r.F = flags(r.A == 0, false, false, false);
+    }
+}
+
+inline uint8_t inc(registers &r, const uint8_t x) {
+    r.F = (r.F & flag_c) | flags(x == 0xff, false, (x & 0xf) == 0xf, false);
+    return x + 1;
+}
+
+inline uint8_t dec(registers &r, const uint8_t x) {
+    r.F = (r.F & flag_c) | flags(x == 1, true, (x & 0xf) == 0, false);
+    return x - 1;
+}
+
+inline void add_hl(registers &r, const uint16_t value) {
+    const uint32_t sum = r.HL + value;
+    r.F = (r.F & flag_z) |
+          flags(false, false, (r.HL & 0xfff) + (value & 0xfff) > 0xfff,
+                sum > 0xffff);
+    r.HL = sum & 0xffff;
+}
+
+// add sp, e8 and ld hl, sp + e8
+inline uint16_t add_sp(registers &r, const uint8_t offset) {
+    r.F = flags(false, false, (r.SP & 0xf) + (offset & 0xf) > 0xf,
+                (r.SP & 0xff) + offset > 0xff);
+    return r.SP + static_cast<int8_t>(offset);
+}
+
+template <rot_op op> uint8_t rot(registers &r, const uint8_t value) {
+    uint8_t result{0};
+    uint8_t shifted{0}; // the bit shifted out
+    if constexpr (op == rlc) {
+        shifted = value >> 7;
+        result = (value << 1) | shifted;
+    } else if constexpr (op == rrc) {
+        shifted = value & 1;
+        result = (value >> 1) | (shifted << 7);
+    } else if constexpr (op == rl) {
+        shifted = value >> 7;
+        result = (value << 1) | carry(r);
+    } else if constexpr (op == rr) {
+        shifted = value & 1;
+        result = (value >> 1) | (carry(r) << 7);
+    } else if constexpr (op == sla) {
+        shifted = value >> 7;
+        result = value << 1;
+    } else if constexpr (op == sra) {
+        shifted = value & 1;
+        result = (value >> 1) | (value & 0x80);
+    } else if constexpr (op == swap) {
+        result = (value >> 4) | (value << 4);
+    } else {
+        shifted = value & 1;
+        result = value >> 1;
+    }
+    r.F = flags(result == 0, false, false, shifted);
+    return result;
+}
+
+// rlca, rrca, rla, rra always reset z
+template <rot_op op> void rot_a(registers &r) {
+    r.A = rot<op>(r, r.A);
+    r.F &= flag_c;
+}
+
+inline void bit(registers &r, const uint8_t bit, const uint8_t value) {
+    r.F = (r.F & flag_c) | flags(!((value >> bit) & 1), false, true, false);
+}
+
+inline void daa(registers &r) {
+    uint8_t c = r.F & flag_c;
+    if (!(r.F & flag_n)) {
+        if (c || r.A > 0x99) {
+            r.A += 0x60;
+            c = flag_c;
+        }
+        if ((r.F & flag_h) || (r.A & 0x0f) > 0x09) {
+            r.A += 0x6;
+        }
+    } else {
+        if (c) {
+            r.A -= 0x60;
+        }
+        if (r.F & flag_h) {
+            r.A -= 0x6;
+        }
+    }
+    r.F = (r.F & flag_n) | c | (r.A == 0 ? flag_z : 0);
+}
+
+inline void cpl(registers &r) {
+    r.A = ~r.A;
+    r.F |= flag_n | flag_h;
+}
+
+inline void scf(registers &r) { r.F = (r.F & flag_z) | flag_c; }
+
+inline void ccf(registers &r) { r.F = (r.F & (flag_z | flag_c)) ^ flag_c; }
+
+} // namespace aot_ops
@@ -0,0 +1,220 @@
+#include "batch.h"
+#include "batch_lanes.h"
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+// one lane per vec, for hosts without avx2 and for checking the avx2 build
+struct scalar_lanes {
+    using vec = uint8_t;
+    static constexpr std::size_t width{1};
+
+    static vec set(const uint8_t value) { return value; }
+    static vec load(const uint8_t *lanes) { return *lanes; }
+    static void store(uint8_t *lanes, const vec value) { *lanes = value; }
+    static vec add(const vec a, const vec b) { return a + b; }
+    static vec sub(const vec a, const vec b) { return a - b; }
+    static vec bit_and(const vec a, const vec b) { return a & b; }
+    static vec bit_or(const vec a, const vec b) { return a | b; }
+    static vec bit_xor(const vec a, const vec b) { return a ^ b; }
+    static vec eq(const vec a, const vec b) { return a == b ? 0xff : 0; }
+    static vec lt(const vec a, const vec b) { return a < b ? 0xff : 0; }
+    static vec select(const vec mask, const vec a, const vec b) {
+        return mask ? a : b;
+    }
+};
+
+// the lane kernel this host can run, avx2 if the build and the cpu have it
+using lane_kernel = void (*)(const lane_registers &, const uint8_t,
+                             const uint8_t);
+lane_kernel host_lane_kernel() {
+#ifdef RICEBOY_BATCH_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return lane_execute_avx2;
+    }
+#endif
+    return lane_execute_scalar;
+}
+
+// the scalar opcodes that only touch registers, a lane running one from rom
+// doesn't need its ram on the bus
+bool ram_free(const uint8_t opcode, const uint8_t cb_opcode) {
+    const uint8_t z = opcode & 7;
+    if (opcode <= 0x3f) {
+        // ld rr, nn, add hl, rr, inc/dec rr, the rotates of a, daa and jr
+        return z == 1 || z == 3 || z == 7 || (z == 0 && opcode >= 0x18);
+    }
+    // jp, jp hl, sp arithmetic, di, ei and cb on registers
+    return opcode == 0xc3 || (z == 2 && opcode >= 0xc2 && opcode <= 0xda) ||
+           opcode == 0xe9 || opcode == 0xe8 || opcode == 0xf8 ||
+           opcode == 0xf9 || opcode == 0xf3 || opcode == 0xfb ||
+           (opcode == 0xcb && (cb_opcode & 7) != 6);
+}
+
+} // namespace
+
+void lane_execute_scalar(const lane_registers &registers, const uint8_t opcode,
+                         const uint8_t operand) {
+    lane_execute<scalar_lanes>(registers, opcode, operand);
+}
+
+batch::batch(const std::size_t lanes, sf::RenderWindow &window)
+    : lane_count(lanes), padded((lanes + 31) & ~static_cast<std::size_t>(31)),
+      lane_ppu(lane_interrupt, window),
+      bus(lane_timer, lane_interrupt, lane_ppu, lane_joypad),
+      bus_lane(lanes), core(bus, lane_timer, lane_interrupt) {
+    for (std::vector<uint8_t> *r : {&A, &F, &B, &C, &D, &E, &H, &L}) {
+        r->assign(this->padded, 0);
+    }
+    this->SP.assign(this->padded, 0);
+    this->PC.assign(this->padded, 0);
+    // the padding never runs
+    this->halted.assign(this->padded, 1);
+    std::fill(this->halted.begin(), this->halted.begin() + lanes, 0);
+    this->IME.assign(this->padded, 0);
+    this->ei_delay.assign(this->padded, 0);
+    this->ram.assign(0x8000 * lanes, 0);
+    this->mask.assign(this->padded, 0);
+    this->bus.map_flat(0x0000, this->rom.size(), this->rom.data(), nullptr);
+}
+
+void batch::load_rom(const uint8_t *bytes, const std::size_t size) {
+    this->rom.fill(0xff);
+    std::copy(bytes, bytes + std::min(size, this->rom.size()),
+              this->rom.begin());
+}
+
+uint8_t batch::read(const std::size_t lane, const uint16_t address) const {
+    assert(lane < this->lane_count && "no such lane!");
+    if (address <= 0x7fff) {
+        return this->rom[address];
+    }
+    return this->ram[lane * 0x8000 + address - 0x8000];
+}
+
+void batch::write(const std::size_t lane, const uint16_t address,
+                  const uint8_t value) {
+    assert(lane < this->lane_count && "no such lane!");
+    if (address <= 0x7fff) {
+        return; // rom
+    }
+    this->ram[lane * 0x8000 + address - 0x8000] = value;
+}
+
+std::size_t batch::running() const {
+    std::size_t count{0};
+    for (std::size_t lane = 0; lane < this->lane_count; ++lane) {
+        count += !this->halted[lane];
+    }
+    return count;
+}
+
+void batch::step() {
+    // the first running lane leads
+    std::size_t leader{0};
+    while (leader < this->lane_count && this->halted[leader]) {
+        leader++;
+    }
+    if (leader == this->lane_count) {
+        return;
+    }
+
+    // lanes at the leader's PC run its opcode together if it only touches
+    // registers. rom is the same for all of them, ram code may not be
+    const uint16_t pc = this->PC[leader];
+    const uint8_t opcode = pc <= 0x7fff ? this->rom[pc] : 0;
+    const bool lockstep = pc <= 0x7ffe && lane_opcode(opcode);
+    std::size_t together{0};
+    for (std::size_t lane = 0; lane < this->padded; ++lane) {
+        const bool joins = lockstep && !this->halted[lane] &&
+                           this->PC[lane] == pc;
+        this->mask[lane] = joins ? 0xff : 0;
+        together += joins;
+    }
+
+    if (together) {
+        const lane_registers registers{
+            {this->B.data(), this->C.data(), this->D.data(), this->E.data(),
+             this->H.data(), this->L.data(), nullptr, this->A.data()},
+            this->F.data(),
+            this->mask.data(),
+            this->padded};
+        static const lane_kernel execute = host_lane_kernel();
+        execute(registers, opcode, this->rom[pc + 1]);
+        const uint16_t next = pc + lane_opcode_length(opcode);
+        for (std::size_t lane = 0; lane < this->lane_count; ++lane) {
+            if (this->mask[lane]) {
+                this->PC[lane] = next;
+                // an ei before it takes effect now
+                this->IME[lane] |= this->ei_delay[lane];
+                this->ei_delay[lane] = 0;
+            }
+        }
+        this->lockstep_instructions += together;
+    }
+
+    // everyone else, one at a time
+    for (std::size_t lane = 0; lane < this->lane_count; ++lane) {
+        if (!this->halted[lane] && !this->mask[lane]) {
+            this->_step_lane(lane);
+            this->scalar_instructions++;
+        }
+    }
+}
+
+void batch::_step_lane(const std::size_t lane) {
+    // remapping is most of a step, skip it while the lane can't see its ram
+    const uint16_t pc = this->PC[lane];
+    if (this->bus_lane != lane &&
+        (pc >= 0x7ffd || !ram_free(this->rom[pc], this->rom[pc + 1]))) {
+        uint8_t *const lane_ram = &this->ram[lane * 0x8000];
+        this->bus.map_flat(0x8000, 0x8000, lane_ram, lane_ram);
+        this->bus_lane = lane;
+    }
+    this->core.sync_flags();
+    this->core.A = this->A[lane];
+    this->core.F = this->F[lane];
+    this->core.B = this->B[lane];
+    this->core.C = this->C[lane];
+    this->core.D = this->D[lane];
+    this->core.E = this->E[lane];
+    this->core.H = this->H[lane];
+    this->core.L = this->L[lane];
+    this->core.SP = this->SP[lane];
+    this->core.PC = this->PC[lane];
+    this->lane_interrupt.ime = this->IME[lane];
+    this->lane_interrupt.ei_delay = this->ei_delay[lane];
+
+    // as the cpu does before each fetch, an ei before it takes effect unless
+    // this is another ei
+    const uint8_t opcode = this->core._fetch(this->core.PC);
+    if (this->lane_interrupt.ei_delay && opcode != 0xfb) {
+        this->lane_interrupt.ime = true;
+        this->lane_interrupt.ei_delay = false;
+    }
+    this->core.identify_opcode(opcode);
+    while (!this->core.M_operations.empty()) {
+        this->core.execute_M_operations();
+    }
+
+    this->core.sync_flags();
+    this->A[lane] = this->core.A;
+    this->F[lane] = this->core.F;
+    this->B[lane] = this->core.B;
+    this->C[lane] = this->core.C;
+    this->D[lane] = this->core.D;
+    this->E[lane] = this->core.E;
+    this->H[lane] = this->core.H;
+    this->L[lane] = this->core.L;
+    this->SP[lane] = this->core.SP;
+    this->PC[lane] = this->core.PC;
+    this->IME[lane] = this->lane_interrupt.ime;
+    this->ei_delay[lane] = this->lane_interrupt.ei_delay;
+
+    if (this->core.halt || this->core.halt_bug) {
+        this->halted[lane] = 1;
+        this->core.halt = false;
+        this->core.halt_bug = false;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cpu.h"
+#include "interrupt.h"
+#include "joypad.h"
+#include "mmu.h"
+#include "ppu.h"
+#include "timer.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// experimental lockstep core for many instances of one rom (reinforcement
+// learning workers). lanes run on a flat 64 KiB bus without the timer, ppu or
+// interrupt dispatch, like the benchmarks, with the registers and ram of every lane
+// kept as struct of arrays. each step() runs one instruction on every running
+// lane: the lanes at the leading PC run register only opcodes together (avx2
+// where the host has it, batch_lanes.h), lanes whose PC went elsewhere and
+// every other opcode go through a scalar cpu one lane at a time
+class batch {
+  public:
+    batch(const std::size_t lanes, sf::RenderWindow &window);
+
+    // rom at 0000-7fff, shared by every lane and never written
+    void load_rom(const uint8_t *bytes, const std::size_t size);
+
+    uint8_t read(const std::size_t lane, const uint16_t address) const;
+    void write(const std::size_t lane, const uint16_t address,
+               const uint8_t value);
+
+    // one instruction on every lane that hasn't halted
+    void step();
+
+    std::size_t lanes() const { return this->lane_count; }
+    std::size_t running() const;
+
+    // registers, lane i at [i]. F as the cpu's sync_flags() leaves it
+    std::vector<uint8_t> A, F, B, C, D, E, H, L;
+    std::vector<uint16_t> SP, PC;
+    // lanes stop at halt or stop, nothing can wake them
+    std::vector<uint8_t> halted;
+    // ime of each lane and an ei waiting for the next instruction, the
+    // scalar cpu's interrupt gets the lane's before it runs an instruction
+    std::vector<uint8_t> IME, ei_delay;
+
+    // instructions run in lockstep and one lane at a time
+    uint64_t lockstep_instructions{0};
+    uint64_t scalar_instructions{0};
+
+  private:
+    std::size_t lane_count;
+    std::size_t padded; // lanes rounded up to 32, the register arrays' size
+
+    std::array<uint8_t, 0x8000> rom{};
+    // 8000-ffff of every lane, one after the other:
+    // [lane * 0x8000 + address - 0x8000]. only the scalar cpu touches it
+    std::vector<uint8_t> ram;
+    // 0xff for the lanes running the leading PC's opcode together
+    std::vector<uint8_t> mask;
+
+    timer lane_timer{};
+    interrupt lane_interrupt{};
+    joypad lane_joypad{};
+    ppu lane_ppu;
+    // the scalar cpu's bus, flat memory: the shared rom (read only) and the
+    // ram of the lane it's running
+    mmu bus;
+    std::size_t bus_lane;
+    cpu core;
+
+    // run the next instruction of one lane on the scalar cpu
+    void _step_lane(const std::size_t lane);
+};
@@ -0,0 +1,49 @@
+// built with -mavx2, only called once the host is known to have it. nothing
+// here may come from a header other translation units share inline code with
+#include "batch_lanes.h"
+#include <immintrin.h>
+
+namespace {
+
+// 32 lanes per register
+struct avx2_lanes {
+    using vec = __m256i;
+    static constexpr std::size_t width{32};
+
+    static vec set(const uint8_t value) {
+        return _mm256_set1_epi8(static_cast<char>(value));
+    }
+    static vec load(const uint8_t *lanes) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes));
+    }
+    static void store(uint8_t *lanes, const vec value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), value);
+    }
+    static vec add(const vec a, const vec b) { return _mm256_add_epi8(a, b); }
+    static vec sub(const vec a, const vec b) { return _mm256_sub_epi8(a, b); }
+    static vec bit_and(const vec a, const vec b) {
+        return _mm256_and_si256(a, b);
+    }
+    static vec bit_or(const vec a, const vec b) {
+        return _mm256_or_si256(a, b);
+    }
+    static vec bit_xor(const vec a, const vec b) {
+        return _mm256_xor_si256(a, b);
+    }
+    static vec eq(const vec a, const vec b) { return _mm256_cmpeq_epi8(a, b); }
+    static vec lt(const vec a, const vec b) {
+        // a >= b where max(a, b) is a, unsigned
+        return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a),
+                                _mm256_set1_epi8(-1));
+    }
+    static vec select(const vec mask, const vec a, const vec b) {
+        return _mm256_blendv_epi8(b, a, mask);
+    }
+};
+
+} // namespace
+
+void lane_execute_avx2(const lane_registers &registers, const uint8_t opcode,
+                       const uint8_t operand) {
+    lane_execute<avx2_lanes>(registers, opcode, operand);
+}
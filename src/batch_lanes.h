@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// the register only opcodes a batch runs on many lanes at once. included by
+// batch.cpp (one lane at a time) and batch_avx2.cpp (32 lanes per avx2
+// register, built with -mavx2), everything but the entry points has internal
+// linkage so neither build's code ends up in the other
+
+// a batch's registers, struct of arrays with lane i at [i]. r8 is indexed by
+// the opcode's 3-bit register field (b, c, d, e, h, l, (hl), a), (hl) is null
+struct lane_registers {
+    uint8_t *r8[8];
+    uint8_t *f;
+    const uint8_t *mask; // 0xff for the lanes running the opcode, 0 otherwise
+    std::size_t lanes;   // a multiple of 32
+};
+
+// run opcode (lane_opcode() true for it) on the lanes in the mask, operand is
+// the imm8 of the forms that have one
+void lane_execute_scalar(const lane_registers &registers, const uint8_t opcode,
+                         const uint8_t operand);
+#ifdef RICEBOY_BATCH_AVX2
+void lane_execute_avx2(const lane_registers &registers, const uint8_t opcode,
+                       const uint8_t operand);
+#endif
+
+namespace {
+
+constexpr uint8_t lane_flag_z{0x80};
+constexpr uint8_t lane_flag_n{0x40};
+constexpr uint8_t lane_flag_h{0x20};
+constexpr uint8_t lane_flag_c{0x10};
+
+// nop, ld r,r, ld r,imm8, inc r, dec r, alu a,r, alu a,imm8, cpl, scf, ccf.
+// none of them touch memory or PC
+inline bool lane_opcode(const uint8_t opcode) {
+    const uint8_t x = opcode >> 6;
+    const uint8_t y = (opcode >> 3) & 7;
+    const uint8_t z = opcode & 7;
+    switch (x) {
+    case 0:
+        return opcode == 0x00 || opcode == 0x2f || opcode == 0x37 ||
+               opcode == 0x3f || ((z == 4 || z == 5 || z == 6) && y != 6);
+    case 1: return y != 6 && z != 6;
+    case 2: return z != 6;
+    default: return z == 6;
+    }
+}
+
+// 2 for the imm8 forms
+inline uint8_t lane_opcode_length(const uint8_t opcode) {
+    return (opcode & 0xc7) == 0x06 || (opcode & 0xc7) == 0xc6 ? 2 : 1;
+}
+
+// the flags from per-lane masks (0xff true, 0 false) of z, n, h and c
+template <typename ops>
+typename ops::vec lane_flags(const typename ops::vec z,
+                             const typename ops::vec n,
+                             const typename ops::vec h,
+                             const typename ops::vec c) {
+    return ops::bit_or(
+        ops::bit_or(ops::bit_and(z, ops::set(lane_flag_z)),
+                    ops::bit_and(n, ops::set(lane_flag_n))),
+        ops::bit_or(ops::bit_and(h, ops::set(lane_flag_h)),
+                    ops::bit_and(c, ops::set(lane_flag_c))));
+}
+
+// same results as the cpu's handlers, flags as sync_flags() leaves them.
+// ops is a vector of ops::width lanes: set, load, store, add, sub, bit_and,
+// bit_or, bit_xor, eq (0xff where equal), lt (0xff where unsigned less) and
+// select (mask ? a : b per lane)
+template <typename ops>
+void lane_execute(const lane_registers &registers, const uint8_t opcode,
+                  const uint8_t operand) {
+    using vec = typename ops::vec;
+    const uint8_t x = opcode >> 6;
+    const uint8_t y = (opcode >> 3) & 7;
+    const uint8_t z = opcode & 7;
+    const vec zero = ops::set(0);
+    const vec ones = ops::set(0xff);
+
+    for (std::size_t i = 0; i < registers.lanes; i += ops::width) {
+        const vec mask = ops::load(registers.mask + i);
+        const vec f = ops::load(registers.f + i);
+        uint8_t *const a_lanes = registers.r8[7] + i;
+        vec result_f = f;
+
+        if (x == 1) {
+            // ld r, r
+            uint8_t *const target = registers.r8[y] + i;
+            ops::store(target, ops::select(mask,
+                                           ops::load(registers.r8[z] + i),
+                                           ops::load(target)));
+            continue;
+        }
+
+        if (x == 0 && z == 6) {
+            // ld r, imm8
+            uint8_t *const target = registers.r8[y] + i;
+            ops::store(target, ops::select(mask, ops::set(operand),
+                                           ops::load(target)));
+            continue;
+        }
+
+        if (x == 0 && (z == 4 || z == 5)) {
+            // inc r, dec r, the carry is kept
+            uint8_t *const target = registers.r8[y] + i;
+            const vec value = ops::load(target);
+            const vec low = ops::bit_and(value, ops::set(0x0f));
+            vec result{};
+            vec h{};
+            if (z == 4) {
+                result = ops::add(value, ops::set(1));
+                h = ops::eq(low, ops::set(0x0f));
+            } else {
+                result = ops::sub(value, ops::set(1));
+                h = ops::eq(low, zero);
+            }
+            result_f = ops::bit_or(
+                lane_flags<ops>(ops::eq(result, zero), z == 5 ? ones : zero,
+                                h, zero),
+                ops::bit_and(f, ops::set(lane_flag_c)));
+            ops::store(target, ops::select(mask, result, value));
+        } else if (x == 2 || x == 3) {
+            // alu a, r and alu a, imm8
+            const vec a = ops::load(a_lanes);
+            const vec value =
+                x == 2 ? ops::load(registers.r8[z] + i) : ops::set(operand);
+            const vec carry = ops::bit_and(f, ops::set(lane_flag_c));
+            const vec carry_in =
+                y == 1 || y == 3
+                    ? ops::bit_and(ops::eq(carry, ops::set(lane_flag_c)),
+                                   ops::set(1))
+                    : zero;
+            const vec low_a = ops::bit_and(a, ops::set(0x0f));
+            const vec low_value = ops::bit_and(value, ops::set(0x0f));
+            vec result{};
+            switch (y) {
+            case 0: // add
+            case 1: // adc
+            {
+                const vec partial = ops::add(a, value);
+                result = ops::add(partial, carry_in);
+                const vec c = ops::bit_or(ops::lt(partial, a),
+                                          ops::lt(result, partial));
+                const vec h = ops::eq(
+                    ops::bit_and(ops::add(ops::add(low_a, low_value), carry_in),
+                                 ops::set(0x10)),
+                    ops::set(0x10));
+                result_f = lane_flags<ops>(ops::eq(result, zero), zero, h, c);
+                break;
+            }
+            case 2: // sub
+            case 3: // sbc
+            case 7: // cp
+            {
+                const vec partial = ops::sub(a, value);
+                result = ops::sub(partial, carry_in);
+                const vec c = ops::bit_or(ops::lt(a, value),
+                                          ops::lt(partial, carry_in));
+                const vec h = ops::eq(
+                    ops::bit_and(ops::sub(ops::sub(low_a, low_value), carry_in),
+                                 ops::set(0x10)),
+                    ops::set(0x10));
+                result_f = lane_flags<ops>(ops::eq(result, zero), ones, h, c);
+                break;
+            }
+            case 4: // and
+                result = ops::bit_and(a, value);
+                result_f =
+                    lane_flags<ops>(ops::eq(result, zero), zero, ones, zero);
+                break;
+            case 5: // xor
+                result = ops::bit_xor(a, value);
+                result_f =
+                    lane_flags<ops>(ops::eq(result, zero), zero, zero, zero);
+                break;
+            default: // or
+                result = ops::bit_or(a, value);
+                result_f =
+                    lane_flags<ops>(ops::eq(result, zero), zero, zero, zero);
+                break;
+            }
+            if (y != 7) {
+                ops::store(a_lanes, ops::select(mask, result, a));
+            }
+        } else if (opcode == 0x2f) {
+            // cpl
+            const vec a = ops::load(a_lanes);
+            ops::store(a_lanes, ops::select(mask, ops::bit_xor(a, ones), a));
+            result_f = ops::bit_or(f, ops::set(lane_flag_n | lane_flag_h));
+        } else if (opcode == 0x37) {
+            // scf
+            result_f = ops::bit_or(ops::bit_and(f, ops::set(lane_flag_z)),
+                                   ops::set(lane_flag_c));
+        } else if (opcode == 0x3f) {
+            // ccf
+            result_f = ops::bit_xor(
+                ops::bit_and(f, ops::set(lane_flag_z | lane_flag_c)),
+                ops::set(lane_flag_c));
+        }
+        // nop falls through with F unchanged
+
+        ops::store(registers.f + i, ops::select(mask, result_f, f));
+    }
+}
+
+} // namespace
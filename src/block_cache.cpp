@@ -0,0 +1,75 @@
+#include "block_cache.h"
+#include <iterator>
+#include <utility>
+
+block_cache::block &block_cache::get(const uint16_t bank, const uint16_t pc) {
+    return this->blocks[(static_cast<uint32_t>(bank) << 16) | pc];
+}
+
+block_cache::decoded_block &block_cache::own(const uint16_t bank,
+                                             const uint16_t pc) {
+    return this->ram_code[(static_cast<uint32_t>(bank) << 16) | pc];
+}
+
+const block_cache::decoded_block block_cache::uncached{};
+
+uint16_t block_cache::decoded_block::m_cycles(const std::size_t count) const {
+    uint16_t cycles{0};
+    for (std::size_t i = 0; i < count && i < this->instructions.size(); ++i) {
+        cycles += this->instructions[i].m_cycles;
+    }
+    return cycles;
+}
+
+void block_cache::clear() {
+    this->blocks.clear();
+    this->ram_code.clear();
+}
+
+void block_cache::drop_native() {
+    for (auto &entry : this->blocks) {
+        entry.second.runs = 0;
+        entry.second.native = nullptr;
+        entry.second.native_length = 0;
+        entry.second.native_m_cycles = 0;
+    }
+}
+
+std::shared_ptr<shared_code> shared_code::of(const shared_rom::image &rom) {
+    // by image, an entry expires with the last cpu holding its store
+    static std::mutex lock{};
+    static std::unordered_map<const std::vector<uint8_t> *,
+                              std::weak_ptr<shared_code>>
+        stores{};
+
+    const std::lock_guard<std::mutex> guard(lock);
+    for (auto held = stores.begin(); held != stores.end();) {
+        held = held->second.expired() ? stores.erase(held) : std::next(held);
+    }
+    std::weak_ptr<shared_code> &entry = stores[rom.get()];
+    std::shared_ptr<shared_code> store = entry.lock();
+    if (!store) {
+        store = std::shared_ptr<shared_code>(new shared_code(rom));
+        entry = store;
+    }
+    return store;
+}
+
+const block_cache::decoded_block *shared_code::find(const uint16_t bank,
+                                                    const uint16_t pc) {
+    const std::lock_guard<std::mutex> guard(this->lock);
+    const auto found =
+        this->blocks.find((static_cast<uint32_t>(bank) << 16) | pc);
+    return found == this->blocks.end() ? nullptr : &found->second;
+}
+
+const block_cache::decoded_block *
+shared_code::insert(const uint16_t bank, const uint16_t pc,
+                    block_cache::decoded_block &&decoded) {
+    const std::lock_guard<std::mutex> guard(this->lock);
+    // emplace keeps the block already there
+    return &this->blocks
+                .emplace((static_cast<uint32_t>(bank) << 16) | pc,
+                         std::move(decoded))
+                .first->second;
+}
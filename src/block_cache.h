@@ -0,0 +1,122 @@
+#pragma once
+
+#include "cartridge.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// straight-line runs of decoded guest code keyed by (bank, pc), the cpu walks
+// through a block instead of fetching each opcode over the bus
+class block_cache {
+  public:
+    struct decoded_instruction {
+        uint16_t pc{0};
+        uint16_t index{0};  // into the instruction table, cb opcodes are 256 + cb
+        uint8_t opcode{0};
+        uint8_t length{0};   // bytes, including operands
+        uint8_t m_cycles{0}; // including the fetch, branch taken
+    };
+
+    // what a block decodes to, only depends on the bytes it was decoded from
+    struct decoded_block {
+        std::vector<decoded_instruction> instructions{};
+
+        // M-cycles per iteration if the block is a polling loop: a read into A,
+        // register ops that only change A and the flags, and a conditional
+        // branch back to the start. 0 otherwise
+        uint8_t poll_cycles{0};
+
+        // M-cycles per iteration if the block is a memory copy or fill loop:
+        // a store of A (read through a pointer first for a copy), pointer
+        // steps, a dec r8 or dec bc; ld a,b; or c counter and a jr nz / jp nz
+        // back to the start. 0 otherwise
+        uint8_t bulk_cycles{0};
+
+        // M-cycles of the first count instructions, branches taken
+        uint16_t m_cycles(const std::size_t count) const;
+    };
+
+    // what a cpu keeps per block it entered, the instructions themselves are
+    // shared_code's for rom code and the cache's own (ram_code) for ram code
+    struct block {
+        uint32_t version{0}; // mmu page version when decoded (wram/hram)
+
+        const decoded_block *decoded{nullptr};
+
+        // jit and aot builds only: times the block was entered, and its host
+        // code covering the first native_length instructions, which take at
+        // most native_m_cycles
+        uint16_t runs{0};
+        const void *native{nullptr};
+        uint8_t native_length{0};
+        uint16_t native_m_cycles{0};
+    };
+
+    // returns the block starting at pc in bank, decoded null if not decoded
+    // yet. references stay valid until clear()
+    block &get(const uint16_t bank, const uint16_t pc);
+
+    // where code the cpu decodes itself goes (ram, or rom without a
+    // shared_code): the body of the block at pc in bank. stays valid until
+    // clear()
+    decoded_block &own(const uint16_t bank, const uint16_t pc);
+
+    // no instructions, the cpu runs the code at pc uncached
+    static const decoded_block uncached;
+
+    void clear();
+
+    // the host code was flushed: forget every block's, the blocks themselves
+    // stay valid and get compiled again once they are hot
+    void drop_native();
+
+  private:
+    // both by bank << 16 | pc
+    std::unordered_map<uint32_t, block> blocks{};
+    std::unordered_map<uint32_t, decoded_block> ram_code{};
+};
+
+// decoded rom code, one store per rom image (shared_rom) in the process.
+// instances running the same rom decode each block once between them. find()
+// and insert() take the store's lock, a cpu only calls them when it decodes a
+// block. the blocks handed out are never changed or dropped while the store
+// lives, so cpus run through them without the lock
+class shared_code {
+  public:
+    // the rom's store, made by the first cpu to ask for it. it holds on to the
+    // image and goes away with the last cpu running it
+    static std::shared_ptr<shared_code> of(const shared_rom::image &rom);
+
+    // nullptr if no cpu has decoded it yet
+    const block_cache::decoded_block *find(const uint16_t bank,
+                                           const uint16_t pc);
+    // adds a block decoded from the rom, unless another cpu got there first.
+    // returns the one to use either way
+    const block_cache::decoded_block *
+    insert(const uint16_t bank, const uint16_t pc,
+           block_cache::decoded_block &&decoded);
+
+    // fnv-1a of the rom file, 0 is never returned (no rom loaded)
+    static uint64_t rom_hash(const char *bytes, const std::size_t size) {
+        uint64_t hash{0xcbf29ce484222325};
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<uint8_t>(bytes[i])) * 0x100000001b3;
+        }
+        return hash ? hash : 1;
+    }
+
+  private:
+    explicit shared_code(shared_rom::image rom) : rom(std::move(rom)) {}
+
+    // the image the store is keyed by, its address isn't reused while the
+    // store is around
+    shared_rom::image rom{};
+
+    std::mutex lock{};
+    // bank << 16 | pc
+    std::unordered_map<uint32_t, block_cache::decoded_block> blocks{};
+};
@@ -0,0 +1,34 @@
+#include "cartridge.h"
+#include "block_cache.h"
+#include <mutex>
+#include <unordered_map>
+
+shared_rom::image shared_rom::load(const char *bytes,
+                                   const std::size_t size) {
+    std::vector<uint8_t> rom(bytes, bytes + size);
+    if (rom.size() < 0x8000) {
+        rom.resize(0x8000, 0xff);
+    }
+
+    // by shared_code::rom_hash, an entry expires with the last instance
+    // holding its rom
+    static std::mutex lock{};
+    static std::unordered_map<uint64_t,
+                              std::weak_ptr<const std::vector<uint8_t>>>
+        roms{};
+
+    const std::lock_guard<std::mutex> guard(lock);
+    std::weak_ptr<const std::vector<uint8_t>> &entry =
+        roms[shared_code::rom_hash(bytes, size)];
+    image loaded = entry.lock();
+    if (loaded && *loaded == rom) {
+        return loaded;
+    }
+    if (loaded) {
+        // another rom with the same hash, this one goes unshared
+        return std::make_shared<const std::vector<uint8_t>>(std::move(rom));
+    }
+    loaded = std::make_shared<const std::vector<uint8_t>>(std::move(rom));
+    entry = loaded;
+    return loaded;
+}
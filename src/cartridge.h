@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 class cartridge {
   public:
@@ -8,4 +11,16 @@ class cartridge {
     virtual uint16_t read_memory(uint16_t address) = 0;
     virtual void write_memory(uint16_t address, uint8_t value) = 0;
     virtual void set_load_rom_complete() = 0;
-};
\ No newline at end of file
+    virtual uint16_t rom_bank(uint16_t address) const = 0; // bank mapped at a rom address
+    virtual const uint8_t *rom_page(uint16_t address) const = 0; // 256 bytes mapped at a rom page, nullptr if unmapped
+};
+
+// rom files loaded in the process. instances running the same rom share one
+// read only copy, it goes away with the last of them
+class shared_rom {
+  public:
+    using image = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // the copy of the file, at least 0000 - 7fff (padded with 0xff)
+    static image load(const char *bytes, const std::size_t size);
+};
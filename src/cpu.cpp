@@ -1,1845 +1,759 @@
 #include "cpu.h"
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
 
-// TODO: abstract utility later
-template <typename... Args>
-std::tuple<uint8_t, bool, bool, bool, bool> cpu::_addition_8bit(Args... args) {
-    uint8_t result = 0;
-    // Iterate over all arguments and add them to the result
-    result += (... + args);
-    // Check if the result is zero
-    bool zero = result == 0;
-    bool half_carry =
-        ((args & 0xf) + ...) > 0xf; // see if 4 bit sum fits in 4 bits
-    bool full_carry = (static_cast<uint16_t>(args) + ...) > 0xff;
-    return {result, zero, false, half_carry, full_carry};
-}
+namespace {
+// a register pair declared the way cpu declares them, standard layout so
+// offsetof works on it: the high half is the msb of the pair
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+union register_pair { uint16_t pair; struct { uint8_t high, low; }; };
+constexpr std::size_t msb_offset{0};
+#else
+union register_pair { uint16_t pair; struct { uint8_t low, high; }; };
+constexpr std::size_t msb_offset{1};
+#endif
+static_assert(sizeof(register_pair) == sizeof(uint16_t),
+              "register pair halves must not be padded");
+static_assert(offsetof(register_pair, high) == msb_offset,
+              "register pair high half must be the msb");
+static_assert(sizeof(cpu::AF) == 2 && sizeof(cpu::A) == 1 &&
+                  sizeof(cpu::F) == 1,
+              "register pairs must be 16-bit over two 8-bit halves");
+} // namespace
+
+void cpu::interrupt_m3() {
+    // write pc high to stack (upper byte push)
+    this->_set(this->SP, this->PC >> 8);
+    this->SP--;
+}
+
+void cpu::interrupt_m4() {
+    // write pc low to stack (lower byte push)
+
+    // NOTE: if IE was pushed this cycle, it's too late. the reason is
+    // because this whole function (handle interrupts) occurs BEFORE cpu
+    // execution, so we are always looking at the IE value BEFORE the
+    // current M-cycle
+
+    this->_set(this->SP, this->PC & 0xff);
+
+    this->PC = static_cast<uint16_t>(this->gb_interrupt->current_interrupt);
+#ifdef RICEBOY_PROFILER
+    this->profile->interrupt(this->SP + 2);
+#endif
+
+    this->gb_interrupt->interrupt_flags &=
+        static_cast<uint8_t>(this->gb_interrupt->current_if_mask);
+}
+
+void cpu::interrupt_m5() {
+    this->gb_interrupt->ime = false;
+    this->gb_interrupt->current_interrupt = interrupt::interrupts::none;
+    this->gb_interrupt->current_if_mask = interrupt::if_mask::none;
+}
+
+// NOP, pre-decrement SP, push pc high, push pc low and jump, clear ime
+const cpu::micro_program cpu::interrupt_program{
+    {&cpu::fill, &cpu::decrement_sp, &cpu::interrupt_m3, &cpu::interrupt_m4,
+     &cpu::interrupt_m5},
+    5};
 
-std::tuple<uint16_t, bool, bool, bool, bool>
-cpu::_addition_16bit(uint16_t x, uint16_t y, bool s8) {
+uint8_t cpu::identify_opcode(const uint8_t opcode) {
+#ifdef RICEBOY_PROFILER
+    this->_profile_instruction(this->PC, opcode);
+#endif
 
-    uint16_t Hf_sum = 0xfff;
-    if (s8) {
-        Hf_sum = 0xf;
+    // code on watched pages is never decoded into blocks, all of it comes
+    // through here
+    if (this->gb_mmu->watching_code(this->PC)) {
+        this->gb_mmu->watch_execute(this->PC, opcode);
     }
 
-    bool full_carry{};
-    bool half_carry{};
-
-    uint16_t result{};
-    if (s8) {
-        int8_t imm8 = static_cast<int8_t>(y);
-        result = x + imm8;
-    } else {
-        result = x + y;
+    if (!this->halt_bug) {
+        this->PC++; // increment program counter, fails to increment if halt bug
+                    // is active
+    } else if (this->halt_bug) {
+        this->halt_bug = false; // reset halt bug
     }
 
-    bool zero = result == 0;
+    // the block cursor does not follow opcodes fetched over the bus
+    this->cached_block = nullptr;
 
-    half_carry = (x & Hf_sum) + (y & Hf_sum) > Hf_sum;
-
-    if (!s8) {
-        full_carry = static_cast<uint32_t>(x) + static_cast<uint32_t>(y) >
-                     0xffff; // see if added numbers > 16 bits
-    } else {
-        full_carry = (x & 0xff) + (y & 0xff) > 0xff;
+    handle_opcode(opcode); // handle the opcode
+    if (!this->M_operations.empty()) {
+        this->fetch_opcode = false; // going past fetch opcode,
     }
-
-    return {result, zero, false, half_carry, full_carry};
-}
-
-std::tuple<uint8_t, bool, bool, bool, bool>
-cpu::_subtraction_8bit(uint8_t x, uint8_t y, uint8_t Cf) {
-    // return result, zero, sub, half_carry, full_carry
-    uint8_t result = x - y - Cf;
-    bool zero = result == 0;
-    bool half_carry = (x & 0xf) < (y & 0xf) + Cf;
-    bool full_carry =
-        (static_cast<int>(x) - static_cast<int>(y) - static_cast<int>(Cf)) < 0;
-    return {result, zero, true, half_carry, full_carry};
-}
-
-uint8_t cpu::_flags_to_byte() const {
-    uint8_t Z = this->Zf;
-    uint8_t N = this->Nf;
-    uint8_t H = this->Hf;
-    uint8_t C = this->Cf;
-    return (Z << 7) | (N << 6) | (H << 5) | (C << 4);
-}
-
-std::tuple<bool, bool, bool, bool> cpu::_byte_to_flags(uint8_t byte) {
-    bool z = (byte >> 7) & 1;
-    bool n = (byte >> 6) & 1;
-    bool h = (byte >> 5) & 1;
-    bool c = (byte >> 4) & 1;
-
-    return {z, n, h, c};
+    return opcode;
 }
 
-// TODO: all pairs can be converted to const expr inside constructor ? maybe not
-uint16_t cpu::_combine_2_8bits(const uint8_t msb, const uint8_t lsb) {
-    return (msb << 8) | lsb;
+uint8_t cpu::_fetch_span(const uint16_t address) {
+    this->fetch_span = this->gb_mmu->code_span_at(address);
+    this->fetch_version = this->gb_mmu->code_map_version;
+    if (this->fetch_span.data == nullptr) {
+        // i/o, vram, oam, cartridge ram, or under oam dma, the bus decides
+        return this->_get(address);
+    }
+    return this->fetch_span.data[address - this->fetch_span.first];
 }
 
-std::tuple<uint8_t, uint8_t> cpu::_split_16bit(const uint16_t r16) {
-    uint8_t msb = (r16 >> 8) & 0x00ff; // msb
-    uint8_t lsb = r16 & 0x00ff;        // lsb
+const block_cache::decoded_instruction *cpu::_cached_instruction() {
+    // the halt bug repeats the fetch without incrementing PC, and during dma
+    // the bus can return the dma source byte for rom and wram, go through the
+    // bus for those
+    if (!this->boot_rom_complete || this->halt_bug ||
+        (this->gb_mmu->gb_ppu->dma_mode && this->PC < 0xff80)) {
+        return nullptr;
+    }
 
-    return {msb, lsb};
-    // return (r1 << 8) | r2;
-}
+    const uint32_t version = this->gb_mmu->page_versions[this->PC >> 8];
 
-uint8_t *cpu::_get_register(const registers r8) {
-    uint8_t *register_value{};
-    switch (r8) {
-    case registers::A: {
-        register_value = &this->A;
-        break;
-    }
-    case registers::B: {
-        register_value = &this->B;
-        break;
-    }
-    case registers::C: {
-        register_value = &this->C;
-        break;
-    }
-    case registers::D: {
-        register_value = &this->D;
-        break;
-    }
-    case registers::E: {
-        register_value = &this->E;
-        break;
+    // PC is still running through the current block
+    if (this->cached_block &&
+        this->cached_index < this->cached_block->decoded->instructions.size() &&
+        this->cached_block->decoded->instructions[this->cached_index].pc ==
+            this->PC &&
+        this->cached_block->version == version &&
+        this->cached_bank_switches == this->gb_mmu->bank_switches) {
+        return &this->cached_block->decoded->instructions[this->cached_index];
     }
-    case registers::H: {
-        register_value = &this->H;
-        break;
+
+    // only rom, wram and hram are cached, code anywhere else is rare
+    const uint16_t pc = this->PC;
+    const bool rom = pc <= 0x7fff;
+    if (!rom && !(pc >= 0xc000 && pc <= 0xdfff) &&
+        !(pc >= 0xff80 && pc <= 0xfffe)) {
+        this->cached_block = nullptr;
+        return nullptr;
     }
-    case registers::L: {
-        register_value = &this->L;
-        break;
+
+    block_cache::block &block =
+        this->code_cache.get(rom ? this->gb_mmu->rom_bank(pc) : 0, pc);
+    bool decoded{false};
+    if (!block.decoded || block.version != version) {
+        this->_decode_block(block, pc);
+        decoded = true;
     }
-    default: break;
+    if (block.runs != UINT16_MAX) {
+        block.runs++;
     }
 
-    return register_value;
-}
-
-uint8_t cpu::_get(const uint16_t address) {
-    return this->gb_mmu->bus_read_memory(address);
-}
-
-void cpu::_set(const uint16_t address, const uint8_t value) {
-    this->gb_mmu->bus_write_memory(address, value);
-}
-
-// abstracted M-operations
-
-// TODO: combine with add_a_r8 later on
-void cpu::add_a_hl() {
-    // TODO: if capture (this) goes out of scope it could cause crashes
-    auto _add_hl = [=]() {
-        const uint16_t hl = this->_combine_2_8bits(this->H, this->L);
-        this->W = _get(hl); // assign value of HL to temp register W
-                            // 1 M-cycle - add HL value to register A
-        auto [result, z, n, h, c] = _addition_8bit(this->A, this->W);
-
-        // optional: reset W after
-        this->W = 0;
-
-        // set a register to the result
-        this->A = result;
-
-        // flags
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    // pushed backwards due to FIFO
-    this->M_operations.push_back(_add_hl);
-}
-
-// TODO: use enum instead of char
-void cpu::add_a_r8(const registers r8) {
-    const uint8_t register_value = *(this->_get_register(r8));
-    // 1 M-cycle - add value in register_value to a
-    auto [result, z, n, h, c] = _addition_8bit(this->A, register_value);
-    // set a register to the result
-    this->A = result;
-    // flags
-    this->Zf = z;
-    this->Nf = n;
-    this->Hf = h;
-    this->Cf = c;
-}
-
-void cpu::add_or_sub_a_imm8(const bool add) {
-    auto m1_add = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        auto [result, z, n, h, c] = this->_addition_8bit(this->A, imm8);
-        this->A = result;
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    auto m1_sub = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        auto [result, z, n, h, c] = this->_subtraction_8bit(this->A, imm8);
-        this->A = result;
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    if (add) {
-        this->M_operations.push_back(m1_add);
-    } else {
-        this->M_operations.push_back(m1_sub);
+    const std::vector<block_cache::decoded_instruction> &code =
+        block.decoded->instructions;
+    if (code.empty()) {
+        this->cached_block = nullptr;
+        return nullptr;
     }
-}
 
-void cpu::adc_or_sbc_imm8(const bool add) {
-    auto m1_adc = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        auto [result, z, n, h, c] =
-            this->_addition_8bit(this->A, imm8, this->Cf);
-        this->A = result;
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    auto m1_sbc = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        auto [result, z, n, h, c] =
-            this->_subtraction_8bit(this->A, imm8, this->Cf);
-        this->A = result;
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    if (add) {
-        this->M_operations.push_back(m1_adc);
+    // a polling loop coming around from its own branch
+    if (block.decoded->poll_cycles && !decoded &&
+        this->cached_block == &block && this->cached_index == code.size()) {
+        this->poll_iterations++;
     } else {
-        this->M_operations.push_back(m1_sbc);
+        this->poll_iterations = 0;
+        this->poll_checked = UINT32_MAX;
     }
-}
 
-void cpu::and_xor_or_imm8(bitops op) {
-    auto m1_and = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        this->A = this->A & imm8;
-        this->Zf = this->A == 0;
-        this->Nf = false;
-        this->Hf = true;
-        this->Cf = false;
-    };
-
-    auto m1_or = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        this->A = this->A | imm8;
-        this->Zf = this->A == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = false;
-    };
-
-    auto m1_xor = [=]() {
-        uint8_t imm8 = _get(this->PC);
-        this->PC++;
-        this->A = this->A ^ imm8;
-        this->Zf = this->A == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = false;
-    };
-
-    if (op == bitops::AND) {
-        this->M_operations.push_back(m1_and);
-    } else if (op == bitops::OR) {
-        this->M_operations.push_back(m1_or);
-    } else if (op == bitops::XOR) {
-        this->M_operations.push_back(m1_xor);
-    }
+    this->cached_block = &block;
+    this->cached_index = 0;
+    this->cached_bank_switches = this->gb_mmu->bank_switches;
+    return &code[0];
 }
 
-void cpu::rst(const uint8_t opcode) {
-
-    auto m1 = [=]() { this->SP--; };
-
-    auto m2 = [=]() {
-        auto [p, c] = _split_16bit(this->PC);
-        this->Z = c;
-        this->_set(this->SP, p);
-        this->SP--;
-    };
-
-    auto m3 = [=]() {
-        uint16_t address{};
-        switch (opcode) {
-        case 0xC7: address = 0x00; break;
-
-        case 0xCF: address = 0x08; break;
-
-        case 0xD7: address = 0x10; break;
-
-        case 0xDF: address = 0x18; break;
-
-        case 0xE7: address = 0x20; break;
-
-        case 0xEF: address = 0x28; break;
-
-        case 0xF7: address = 0x30; break;
+void cpu::_decode_block(block_cache::block &block, const uint16_t pc) {
+    // blocks stay on one page so a single page version covers them
+    block.version = this->gb_mmu->page_versions[pc >> 8];
+    block.runs = 0;
+    block.native = nullptr;
+    block.native_length = 0;
+    block.native_m_cycles = 0;
 
-        case 0xFF: address = 0x38; break;
-        }
-        this->_set(this->SP, this->Z);
-        this->PC = address;
-    };
-
-    this->M_operations.push_back(m3);
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
-}
-
-void cpu::add_hl_rr(const registers r1, const registers r2, const bool sp) {
-    auto m1_nonsp = [=]() {
-        const uint8_t *p1 = _get_register(r1);
-        const uint8_t *p2 = _get_register(r2);
-
-        const uint16_t rr = _combine_2_8bits(*p1, *p2);
-        const uint16_t hl = _combine_2_8bits(this->H, this->L);
-
-        auto [result, z, n, h, c] = _addition_16bit(hl, rr);
-
-        auto [msb, lsb] = _split_16bit(result);
-        this->H = msb;
-        this->L = lsb;
-
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    auto m1_sp = [=]() {
-        const uint16_t hl = _combine_2_8bits(this->H, this->L);
-
-        auto [result, z, n, h, c] = _addition_16bit(hl, this->SP);
-
-        auto [msb, lsb] = _split_16bit(result);
-        this->H = msb;
-        this->L = lsb;
-
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    if (!sp) {
-        this->M_operations.push_back(m1_nonsp);
-    } else {
-        this->M_operations.push_back(m1_sp);
+    // execute watchpoints see every instruction, the cpu runs it uncached
+    if (this->gb_mmu->watching_code(pc)) {
+        block.decoded = &block_cache::uncached;
+        return;
     }
-}
 
-void cpu::call(const conditions condition) {
-    // get least and most significant byte via program_counter next
-    // M2
-    auto get_lsb = [=]() {
-        this->W = _get(this->PC);
-        this->PC++;
-    };
-
-    // M3
-    auto get_msb = [=]() {
-        this->Z = _get(this->PC);
-        this->PC++;
-    };
-
-    // M4
-    auto decrement_sp = [=]() {
-        this->SP--; // decrement stack pointer
-    };
-
-    // M5
-    auto store_pc_msb = [=]() {
-        // store the ms byte and ls byte of current pointer counter to stack
-        // pointer
-        uint8_t pc_msb = (this->PC >> 8) & 0x00ff;
-
-        this->_set(SP, pc_msb);
-        this->SP--;
-    };
-
-    // M6
-    auto store_pc_lsb = [=]() {
-        uint8_t pc_lsb = this->PC & 0x00ff;
-        this->_set(SP, pc_lsb);
-        // set program counter to function
-        this->PC = (this->Z << 8) | this->W; // the function
-    };
-
-    switch (condition) {
-    case conditions::NA: {
-        this->M_operations.push_back(store_pc_lsb);
-        this->M_operations.push_back(store_pc_msb);
-        this->M_operations.push_back(decrement_sp);
-        break;
-    }
-    case conditions::Z: {
-        if (this->Zf) {
-            this->M_operations.push_back(store_pc_lsb);
-            this->M_operations.push_back(store_pc_msb);
-            this->M_operations.push_back(decrement_sp);
+    const uint16_t bank = pc <= 0x7fff ? this->gb_mmu->rom_bank(pc) : 0;
+    if (pc <= 0x7fff && this->loaded_code) {
+        // rom code, decoded by whichever cpu running the rom got to it first
+        shared_code &shared = *this->loaded_code;
+        block.decoded = shared.find(bank, pc);
+        if (!block.decoded) {
+            block_cache::decoded_block decoded{};
+            this->_decode(decoded, pc);
+            block.decoded = shared.insert(bank, pc, std::move(decoded));
         }
-        break;
-    }
-    case conditions::NZ: {
-        if (!this->Zf) {
-            this->M_operations.push_back(store_pc_lsb);
-            this->M_operations.push_back(store_pc_msb);
-            this->M_operations.push_back(decrement_sp);
-        }
-        break;
-    }
-    case conditions::C: {
-        if (this->Cf) {
-            this->M_operations.push_back(store_pc_lsb);
-            this->M_operations.push_back(store_pc_msb);
-            this->M_operations.push_back(decrement_sp);
-        }
-        break;
-    }
-    case conditions::NC: {
-        if (!this->Cf) {
-            this->M_operations.push_back(store_pc_lsb);
-            this->M_operations.push_back(store_pc_msb);
-            this->M_operations.push_back(decrement_sp);
+    } else {
+        block_cache::decoded_block &own = this->code_cache.own(bank, pc);
+        this->_decode(own, pc);
+        block.decoded = &own;
+    }
+
+#ifdef RICEBOY_AOT
+    // rom blocks the plugin has host code for
+    if (!block.decoded->instructions.empty() && pc <= 0x7fff) {
+        const aot::entry *entry =
+            this->plugin.find(this->gb_mmu->rom_bank(pc), pc);
+        if (entry && entry->length <= block.decoded->instructions.size()) {
+            block.native = reinterpret_cast<const void *>(entry->function);
+            block.native_length = entry->length;
+            block.native_m_cycles = block.decoded->m_cycles(entry->length);
         }
-        break;
     }
-    }
-
-    this->M_operations.push_back(get_msb);
-    this->M_operations.push_back(get_lsb);
+#endif
 }
 
-void cpu::cp_a_imm8() {
-    auto read_imm8 = [=]() {
-        this->W = _get(this->PC); // imm8 stored in W
-        this->PC++;
-
-        // sub_and_set_flags
-        auto [result, z, n, h, c] = this->_subtraction_8bit(this->A, this->W);
-        // this->W = 0; // reset W (maybe not necessary)
-
-        // TODO: M3/M1 - overlaps with the fetch of the next operation, should
-        // occur 4 ticks after the last op, how to handle? set flags
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    this->M_operations.push_back(read_imm8);
-}
+void cpu::_decode(block_cache::decoded_block &decoded, uint16_t pc) const {
+    const uint8_t page = pc >> 8;
+    decoded.instructions.clear();
 
-void cpu::cp_a_r(const registers r, const bool hl) {
-    if (!hl) {
-        uint8_t *r1p = _get_register(r);
-        auto [result, z, n, h, c] = this->_subtraction_8bit(this->A, *r1p);
-
-        // set flags
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    } else {
-        auto read_hl = [=]() {
-            uint16_t hl = _combine_2_8bits(this->H, this->L);
-            this->W = _get(hl); // memory[hl] stored in W
-
-            // sub an set flags
-            auto [result, z, n, h, c] =
-                this->_subtraction_8bit(this->A, this->W);
-
-            // set flags
-            this->Zf = z;
-            this->Nf = n;
-            this->Hf = h;
-            this->Cf = c;
-        };
-
-        // push backwards because of FIFO
-        this->M_operations.push_back(read_hl);
-    }
-}
-
-void cpu::inc_or_dec_hl(const bool inc) {
-    uint16_t address = this->_combine_2_8bits(this->H, this->L);
-
-    auto m1 = [=]() { this->Z = _get(address); };
-
-    auto m2_dec = [=]() {
-        auto [result, z, n, h, c] = this->_subtraction_8bit(this->Z, 1);
-        this->_set(address, result);
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-    };
-
-    auto m2_inc = [=]() {
-        auto [result, z, n, h, c] = this->_addition_8bit(this->Z, 1);
-        this->_set(address, result);
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-    };
-
-    if (inc) {
-        this->M_operations.push_back(m2_inc);
-    } else {
-        this->M_operations.push_back(m2_dec);
-    }
-    this->M_operations.push_back(m1);
-}
+    while (true) {
+        const uint8_t opcode = this->gb_mmu->read_memory(pc);
+        uint16_t index = opcode;
 
-void cpu::inc_or_dec_r8(const registers r8, const bool inc) {
-    uint8_t *register_pointer = this->_get_register(r8);
-
-    if (inc) {
-        auto [result, z, n, h, c] = this->_addition_8bit(*register_pointer, 1);
-        *register_pointer = result; // modifies the appropriate register pointer
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-    } else if (!inc) {
-        auto [result, z, n, h, c] =
-            this->_subtraction_8bit(*register_pointer, 1);
-        *register_pointer = result; // modifies the appropriate register pointer
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-    }
-}
-
-void cpu::inc_or_dec_r16(const registers r1, const registers r2, const bool inc,
-                         const bool sp) {
-    auto _inc_or_dec_r16 = [=]() {
-        if (sp && inc) {
-            this->SP++;
-        } else if (sp && !inc) {
-            this->SP--;
-        } else {
-            uint8_t *r1_pointer = this->_get_register(r1);
-            uint8_t *r2_pointer = this->_get_register(r2);
-
-            uint16_t current_value = _combine_2_8bits(*r1_pointer, *r2_pointer);
-
-            // oam bug oam corruption bug write on r16 == bc, or de or hl
-            /*
-               if ((r1 == registers::B && r2 == registers::C) ||
-               (r1 == registers::D || r2 == registers::E) ||
-               (r1 == registers::H || r2 == registers::L)) {
-               this->gb_mmu->oam_bug_write(current_value);
-               }*/
-
-            if (inc) {
-                current_value++;
-            } else if (!inc) {
-                current_value--;
+        if (opcode == 0xcb) {
+            // the cb opcode is cached too, it must be on the same page
+            const uint16_t cb_address = pc + 1;
+            if ((cb_address >> 8) != page || cb_address == 0xffff) {
+                break;
             }
-
-            auto [r1_value, r2_value] = _split_16bit(current_value);
-            *r1_pointer = r1_value;
-            *r2_pointer = r2_value;
+            index = 256 + this->gb_mmu->read_memory(cb_address);
         }
-    };
-
-    this->M_operations.push_back(_inc_or_dec_r16);
-}
 
-void cpu::jp_hl() { this->PC = this->_combine_2_8bits(this->H, this->L); }
+        decoded.instructions.push_back(
+            {pc, index, opcode, instructions[opcode].length,
+             static_cast<uint8_t>(instructions[index].program.length + 1)});
 
-void cpu::jp_imm16(const conditions condition) {
-    // get least and most significant byte via program_counter next
-    auto get_lsb = [=]() {
-        this->W = _get(this->PC);
-        this->PC++;
-    };
-
-    auto get_msb = [=]() {
-        this->Z = _get(this->PC);
-        this->PC++;
-    };
-
-    auto set_pc = [=]() {
-        this->PC = (this->Z << 8) | this->W; // the function
-    };
-
-    switch (condition) {
-    case conditions::NA: {
-        this->M_operations.push_back(set_pc);
-        break;
-    }
-    case conditions::Z: {
-        if (this->Zf) {
-            this->M_operations.push_back(set_pc);
+        if (instructions[opcode].ends_block) {
+            break;
         }
-        break;
-    }
-    case conditions::NZ: {
-        if (!this->Zf) {
-            this->M_operations.push_back(set_pc);
-        }
-        break;
-    }
-    case conditions::C: {
-        if (this->Cf) {
-            this->M_operations.push_back(set_pc);
-        }
-        break;
-    }
-    case conditions::NC: {
-        if (!this->Cf) {
-            this->M_operations.push_back(set_pc);
-        }
-        break;
-    }
-    }
-
-    this->M_operations.push_back(get_msb);
-    this->M_operations.push_back(get_lsb);
-}
 
-void cpu::jr_s8(conditions condition) {
-    // jump relative to signed 8 bit next in memory
-    auto get_value = [=]() {
-        this->Z = _get(this->PC);
-        this->PC++;
-    };
-
-    auto set_pc = [=]() {
-        // 1001 0010
-        int8_t value = this->Z;
-        this->PC += value;
-    };
-
-    if (condition == conditions::NA) {
-        this->M_operations.push_back(set_pc);
-    } else if (condition == conditions::Z) {
-        if (this->Zf) {
-            this->M_operations.push_back(set_pc);
-        }
-    } else if (condition == conditions::NZ) {
-        if (!this->Zf) {
-            this->M_operations.push_back(set_pc);
+        // stop at the end of the page (and before ie at 0xffff)
+        const uint16_t next = pc + instructions[opcode].length;
+        if ((next >> 8) != page || next == 0xffff) {
+            break;
         }
+        pc = next;
+    }
+
+    decoded.poll_cycles = this->_polling_loop_cycles(decoded);
+    decoded.bulk_cycles = this->_bulk_loop_cycles(decoded);
+}
+
+// register ops that only write A and the flags and don't read the flags, a
+// polling loop running them on the same read value ends up the same way
+static bool _polling_loop_body(const uint16_t index) {
+    if (index >= 256) {
+        const uint8_t cb_opcode = index & 0xff;
+        // bit b,r and swap a
+        return (cb_opcode >= 0x40 && cb_opcode <= 0x7f &&
+                (cb_opcode & 7) != 6) ||
+               cb_opcode == 0x37;
+    }
+
+    switch (index) {
+    case 0x00: // nop
+    case 0x07: // rlca
+    case 0x0f: // rrca
+    case 0x2f: // cpl
+    case 0x3c: // inc a
+    case 0x3d: // dec a
+    case 0xc6: // add/sub/and/xor/or/cp imm8
+    case 0xd6:
+    case 0xe6:
+    case 0xee:
+    case 0xf6:
+    case 0xfe: return true;
+    }
+
+    // add/sub/and/xor/or/cp r (not adc/sbc, not (hl))
+    const uint8_t y = (index >> 3) & 7;
+    return index >= 0x80 && index <= 0xbf && (index & 7) != 6 && y != 1 &&
+           y != 3;
+}
+
+uint8_t
+cpu::_polling_loop_cycles(const block_cache::decoded_block &block) const {
+    const std::vector<block_cache::decoded_instruction> &code =
+        block.instructions;
+    if (code.size() < 2 || code.size() > 8) {
+        return 0;
+    }
+
+    // the read into A, its last M-cycle
+    switch (code.front().opcode) {
+    case 0xf0: // ldh a,(imm8)
+    case 0xfa: // ld a,(imm16)
+    case 0xf2: // ld a,(c)
+    case 0x7e: // ld a,(hl)
+    case 0x0a: // ld a,(bc)
+    case 0x1a: // ld a,(de)
+        break;
+    default: return 0;
     }
 
-    else if (condition == conditions::NC) {
-        if (!this->Cf) {
-            this->M_operations.push_back(set_pc);
+    for (std::size_t i = 1; i + 1 < code.size(); ++i) {
+        if (!_polling_loop_body(code[i].index)) {
+            return 0;
         }
     }
 
-    else if (condition == conditions::C) {
-        if (this->Cf) {
-            this->M_operations.push_back(set_pc);
+    // jr cc or jp cc back to the read
+    switch (code.back().opcode) {
+    case 0x20:
+    case 0x28:
+    case 0x30:
+    case 0x38:
+    case 0xc2:
+    case 0xca:
+    case 0xd2:
+    case 0xda: break;
+    default: return 0;
+    }
+    if (this->_branch_target(code.back()) != code.front().pc) {
+        return 0;
+    }
+
+    unsigned int cycles{0};
+    for (const block_cache::decoded_instruction &decoded : code) {
+        cycles += decoded.m_cycles;
+    }
+    return static_cast<uint8_t>(cycles);
+}
+
+uint16_t
+cpu::_branch_target(const block_cache::decoded_instruction &branch) const {
+    // jr e8, or jp imm16
+    if (branch.length == 2) {
+        return branch.pc + 2 +
+               static_cast<int8_t>(this->gb_mmu->read_memory(branch.pc + 1));
+    }
+    return (this->gb_mmu->read_memory(branch.pc + 2) << 8) |
+           this->gb_mmu->read_memory(branch.pc + 1);
+}
+
+bool cpu::_bulk_idiom(const block_cache::decoded_block &block,
+                      bulk_idiom &idiom) const {
+    const std::vector<block_cache::decoded_instruction> &code =
+        block.instructions;
+    if (code.size() < 3 || code.size() > 8) {
+        return false;
+    }
+
+    // bc, de and hl, and how far each moves per iteration
+    static constexpr std::array<uint16_t cpu::*, 3> pairs{&cpu::BC, &cpu::DE,
+                                                          &cpu::HL};
+    std::array<int, 3> steps{};
+    int source{-1};
+    int destination{-1};
+    std::size_t i{0};
+
+    // the read into A of a copy
+    switch (code[i].opcode) {
+    case 0x0a: source = 0; break; // ld a,(bc)
+    case 0x1a: source = 1; break; // ld a,(de)
+    case 0x2a: source = 2; steps[2]++; break; // ld a,(hl+)
+    case 0x3a: source = 2; steps[2]--; break; // ld a,(hl-)
+    case 0x7e: source = 2; break; // ld a,(hl)
+    }
+    if (source >= 0) {
+        i++;
+    }
+
+    // the store of A
+    switch (code[i].opcode) {
+    case 0x02: destination = 0; break; // ld (bc),a
+    case 0x12: destination = 1; break; // ld (de),a
+    case 0x22: destination = 2; steps[2]++; break; // ld (hl+),a
+    case 0x32: destination = 2; steps[2]--; break; // ld (hl-),a
+    case 0x77: destination = 2; break; // ld (hl),a
+    default: return false;
+    }
+    if (destination == source) {
+        return false;
+    }
+
+    // pointer steps and the counter, in any order before the branch
+    bool counted{false};
+    int counter_pair{0}; // the pair the counter is in
+    idiom.counter = nullptr;
+    for (i++; i + 1 < code.size(); ++i) {
+        const uint8_t opcode = code[i].opcode;
+        if (!counted && opcode == 0x0b && i + 3 < code.size() &&
+            ((code[i + 1].opcode == 0x78 && code[i + 2].opcode == 0xb1) ||
+             (code[i + 1].opcode == 0x79 && code[i + 2].opcode == 0xb0))) {
+            // dec bc; ld a,b; or c, a fill would store b | c from then on
+            if (source < 0) {
+                return false;
+            }
+            counted = true;
+            i += 2;
+            continue;
         }
-    }
-
-    this->M_operations.push_back(get_value);
-}
-
-void cpu::ld_imm16_sp() {
-    auto m1 = [=]() {
-        this->Z = _get(PC); // lsb
-        PC++;
-    };
-
-    auto m2 = [=]() {
-        this->W = _get(PC); // msb
-        PC++;
-    };
-
-    auto m3 = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->W, this->Z);
-        auto [msb, lsb] = this->_split_16bit(this->SP);
-        this->_set(address, lsb);
-    };
-
-    auto m4 = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->W, this->Z) + 1;
-        auto [msb, lsb] = this->_split_16bit(this->SP);
-        this->_set(address, msb);
-    };
-
-    this->M_operations.push_back(m4);
-    this->M_operations.push_back(m3);
-
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
-}
 
-void cpu::ld_imm16_a(const bool to_a) {
-    auto m1 = [=]() {
-        this->Z = _get(PC); // lsb
-        PC++;
-    };
-
-    auto m2 = [=]() {
-        this->W = _get(PC); // msb
-        PC++;
-    };
-
-    auto m3 = [=]() {
-        uint16_t address = this->_combine_2_8bits(W, Z);
-        if (!to_a) {
-            this->_set(address, this->A); // write A to address
-        } else {
-            this->A = _get(address); // write value from address to A
+        uint8_t cpu::*counter{nullptr};
+        switch (opcode) {
+        case 0x05: counter = &cpu::B; break;
+        case 0x0d: counter = &cpu::C; break;
+        case 0x15: counter = &cpu::D; break;
+        case 0x1d: counter = &cpu::E; break;
         }
-    };
-
-    this->M_operations.push_back(m3);
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ld_r_r(const registers r_to, const registers r_from) {
-    uint8_t *register_pointer_to = _get_register(r_to);
-    uint8_t *register_pointer_from = _get_register(r_from);
-    *register_pointer_to = *register_pointer_from;
-}
-
-void cpu::ld_hl_imm8() {
-    auto m1 = [=]() {
-        this->Z = _get(this->PC);
-        this->PC++;
-    };
-
-    auto m2 = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        this->_set(address, this->Z);
-    };
-
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ld_sp_hl() {
-    auto m1 = [=]() { this->SP = this->_combine_2_8bits(this->H, this->L); };
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ld_r_imm8(const registers r) {
-    auto m1 = [=]() {
-        uint8_t *register_pointer = this->_get_register(r);
-        uint8_t value = _get(this->PC);
-        *register_pointer = value;
-        this->PC++;
-    };
-
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ld_rr_address(const registers r1, const registers r2, const bool sp) {
-    auto m1 = [=]() {
-        this->Z = _get(PC); // lsb
-        this->PC++;
-        this->W = _get(PC); // msb
-        this->PC++;
-    };
-
-    auto f_sp = [=]() { this->SP = this->_combine_2_8bits(W, Z); };
-
-    auto non_sp = [=]() {
-        uint8_t *register_pointer_1 = this->_get_register(r1);
-        uint8_t *register_pointer_2 = this->_get_register(r2);
-
-        *register_pointer_1 = this->W; // r1 - msb
-        *register_pointer_2 = this->Z; // r2 - lsb
-    };
-
-    if (sp) {
-        this->M_operations.push_back(f_sp);
-    } else {
-        this->M_operations.push_back(non_sp);
-    }
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ld_hl_a(const bool increment, const bool to_a) {
-    auto m1 = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-
-        // oam bug oam corruption bug write on increment or decrement, i think
-        // its already handled by set
-        this->_set(address, this->A);
-
-        if (increment) {
-            address++;
-        } else {
-            address--;
+        if (counter && !counted) {
+            counted = true;
+            counter_pair = opcode >> 4;
+            idiom.counter = counter;
+            continue;
         }
-        auto [h, l] = this->_split_16bit(address);
-        this->H = h;
-        this->L = l;
-    };
-
-    auto m2 = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-
-        // oam bug oam corruption bug read inc (corruption happens before get
-        // address)
-        // this->gb_mmu->oam_bug_read_inc(address);
-
-        this->A = _get(address);
 
-        if (increment) {
-            address++;
-        } else {
-            address--;
+        // inc rr, dec rr (not sp)
+        if ((opcode & 0xc7) == 0x03 && opcode < 0x30) {
+            steps[opcode >> 4] += opcode & 0x08 ? -1 : 1;
+            continue;
         }
-        auto [h, l] = this->_split_16bit(address);
-        this->H = h;
-        this->L = l;
-    };
-
-    if (to_a) {
-        this->M_operations.push_back(m2);
-    } else {
-        this->M_operations.push_back(m1);
-    }
-} // covers hl+ and hl-
-
-void cpu::ld_hl_r8(const registers r, const bool to_hl) {
-    auto m1_to_hl = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        uint8_t *rp = this->_get_register(r);
-        this->_set(address, *rp);
-    };
-
-    auto m2 = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        uint8_t *rp = this->_get_register(r);
-        uint8_t value = _get(address);
-        *rp = value;
-    };
-
-    if (to_hl) {
-        this->M_operations.push_back(m1_to_hl);
-    } else {
-        this->M_operations.push_back(m2);
+        return false;
     }
-}
-
-void cpu::ld_hl_sp_s8() {
-    auto m1 = [=]() {
-        this->Z = _get(this->PC);
-        this->PC++;
-    };
-
-    auto m2 = [=]() {
-        auto [result, z, n, h, c] =
-            this->_addition_16bit(this->SP, this->Z, true);
-        auto [msb, lsb] = _split_16bit(result);
-        this->H = msb;
-        this->L = lsb;
-        this->Zf = false;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
-}
-
-void cpu::pop_rr(const registers r1, const registers r2, const bool af) {
-    auto m1 = [=]() {
-        this->Z = _get(this->SP); // lsb
-        this->SP++;
-    };
-
-    auto m2 = [=]() {
-        this->W = _get(this->SP); // msb
-        this->SP++;
-
-        uint8_t *r_pointer1 = _get_register(r1);
-        uint8_t *r_pointer2 = _get_register(r2);
-
-        *r_pointer1 = W;
-        *r_pointer2 = Z;
-    };
-
-    auto m2_af = [=]() {
-        this->W = _get(this->SP); // msb
-        this->SP++;
-
-        uint8_t *r_pointer1 = _get_register(registers::A);
-        // TODO: get F
-
-        auto [z, n, h, c] = this->_byte_to_flags(Z);
-
-        *r_pointer1 = W;
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    if (!af) {
-        this->M_operations.push_back(m2);
-    } else {
-        this->M_operations.push_back(m2_af);
+    if (!counted) {
+        return false;
     }
-    this->M_operations.push_back(m1);
-}
 
-void cpu::push_rr(const registers r1, const registers r2, const bool af) {
-    auto m1 = [=]() { this->SP--; };
-
-    auto m2 = [=]() {
-        auto r1_p = this->_get_register(r1);
-        this->_set(this->SP, *r1_p);
-        this->SP--;
-    };
-
-    auto m2_af = [=]() {
-        auto r1_p = this->_get_register(registers::A);
-        this->_set(this->SP, *r1_p);
-        this->SP--;
-    };
-
-    auto m3 = [=]() {
-        auto r2_p = this->_get_register(r2);
-        this->_set(this->SP, *r2_p);
-    };
-
-    auto m3_af = [=]() {
-        auto f = _flags_to_byte();
-        this->_set(this->SP, f);
-    };
-
-    if (af) {
-        this->M_operations.push_back(m3_af);
-        this->M_operations.push_back(m2_af);
-    } else {
-        this->M_operations.push_back(m3);
-        this->M_operations.push_back(m2);
+    // jr nz or jp nz back to the start
+    const block_cache::decoded_instruction &branch = code.back();
+    if ((branch.opcode != 0x20 && branch.opcode != 0xc2) ||
+        this->_branch_target(branch) != code.front().pc) {
+        return false;
     }
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ret(conditions condition, bool ime_condition) {
-
-    auto fill = [=]() {};
-
-    auto m1 = [=]() {
-        this->Z = _get(this->SP);
-        this->SP++;
-    };
-
-    auto m2 = [=]() {
-        this->W = _get(this->SP);
-        this->SP++;
-    };
 
-    auto m3 = [=]() {
-        if (ime_condition) {
-            this->gb_interrupt->ime = true;
-        }
-        this->PC = this->_combine_2_8bits(W, Z);
-    };
-
-    switch (condition) {
-    case conditions::NA: {
-        this->M_operations.push_back(m3);
-        this->M_operations.push_back(m2);
-        this->M_operations.push_back(m1);
-        break;
+    // the counter's pair is no pointer, and only the pointers move, by a byte
+    // at most
+    if (source == counter_pair || destination == counter_pair) {
+        return false;
     }
-    case conditions::Z: {
-        this->M_operations.push_back(fill);
-        if (this->Zf) {
-            this->M_operations.push_back(m3);
-            this->M_operations.push_back(m2);
-            this->M_operations.push_back(m1);
+    for (int pair = 0; pair < 3; ++pair) {
+        const bool pointer = pair == source || pair == destination;
+        if (pointer ? steps[pair] < -1 || steps[pair] > 1 : steps[pair]) {
+            return false;
         }
-        break;
     }
-    case conditions::NZ: {
-        this->M_operations.push_back(fill);
-        if (!this->Zf) {
-            this->M_operations.push_back(m3);
-            this->M_operations.push_back(m2);
-            this->M_operations.push_back(m1);
-        }
-        break;
-    }
-    case conditions::C: {
-        this->M_operations.push_back(fill);
-        if (this->Cf) {
-            this->M_operations.push_back(m3);
-            this->M_operations.push_back(m2);
-            this->M_operations.push_back(m1);
-        }
-        break;
-    }
-    case conditions::NC: {
-        this->M_operations.push_back(fill);
-        if (!this->Cf) {
-            this->M_operations.push_back(m3);
-            this->M_operations.push_back(m2);
-            this->M_operations.push_back(m1);
-        }
-        break;
-    }
-    }
-}
 
-void cpu::sla_r(const registers r, const bool hl) {
-    auto m1 = [=]() {
-        uint8_t *rp = this->_get_register(r); // r falls out of scope for some
-                                              // reason uint8_t* rp = &this->B;
-
-        uint8_t msbit = (*rp >> 7) & 1; // save the "carry" bit
-        *rp <<= 1;                      // left shift A by 1 bit
-                                        // bit 0 is reset to 0
-
-        this->Zf = *rp == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = msbit == 1;
-    };
-
-    auto m1_hl = [=]() {
-        // does nothing, get opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t msbit = (this->Z >> 7) & 1; // save the "carry" bit
-        this->Z <<= 1;                      // left shift A by 1 bit
-                                            // bit 0 is reset to 0
-
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = msbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
+    idiom.source = source >= 0 ? pairs[source] : nullptr;
+    idiom.source_step = source >= 0 ? static_cast<int8_t>(steps[source]) : 0;
+    idiom.destination = pairs[destination];
+    idiom.destination_step = static_cast<int8_t>(steps[destination]);
+    return true;
+}
+
+uint8_t
+cpu::_bulk_loop_cycles(const block_cache::decoded_block &block) const {
+    bulk_idiom idiom{};
+    if (!this->_bulk_idiom(block, idiom)) {
+        return 0;
+    }
+
+    unsigned int cycles{0};
+    for (const block_cache::decoded_instruction &decoded : block.instructions) {
+        cycles += decoded.m_cycles;
+    }
+    return static_cast<uint8_t>(cycles);
+}
+
+uint32_t cpu::_bulk_reach(const uint16_t address, const int8_t step,
+                          const bool write) const {
+    // memory the timer, ppu and dma don't see: rom (writes are mbc
+    // registers), cartridge ram and wram, hram, and vram and oam while the lcd
+    // is off
+    const bool lcd_off = this->gb_mmu->gb_ppu->idle();
+    uint16_t first{0};
+    uint16_t last{0};
+    if (address <= 0x7fff && !write) {
+        last = 0x7fff;
+    } else if (address >= 0x8000 && address <= 0x9fff && lcd_off) {
+        first = 0x8000;
+        last = 0x9fff;
+    } else if (address >= 0xa000 && address <= 0xdfff) {
+        first = 0xa000;
+        last = 0xdfff;
+    } else if (address >= 0xfe00 && address <= 0xfe9f && lcd_off) {
+        first = 0xfe00;
+        last = 0xfe9f;
+    } else if (address >= 0xff80 && address <= 0xfffe) {
+        first = 0xff80;
+        last = 0xfffe;
     } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
-    }
-}
-
-void cpu::rl_r(const registers r, const bool hl, const bool z_flag,
-               const bool one_cycle) {
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-        uint8_t msbit = (*rp >> 7) & 1;  // save the "carry" bit
-        uint8_t carry_flag = this->Cf;   // take current carry flag
-        *rp = *rp << 1;                  // left shift A by 1 bit
-        *rp = (*rp & 0xfe) | carry_flag; // put carry_flag into bit 0
-                                         // set flags
-        if (!z_flag) {
-            this->Zf = false;
-        } else {
-            this->Zf = *rp == 0;
-        }
-        this->Nf = false;
-        this->Hf = false;
-
-        this->Cf = msbit == 1;
-    };
-
-    if (one_cycle) {
-        assert(r == registers::A &&
-               "You are running RLA but the register is not A!");
-        m1();
-        return;
+        return 0;
     }
 
-    auto m1_hl = [=]() {
-        // does nothign, get opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t msbit = (this->Z >> 7) & 1;      // save the "carry" bit
-        uint8_t carry_flag = this->Cf;           // take current carry flag
-        this->Z = this->Z << 1;                  // left shift A by 1 bit
-        this->Z = (this->Z & 0xfe) | carry_flag; // put carry_flag into bit 0
-                                                 // set flags
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-
-        this->Cf = msbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    if (step == 0) {
+        return UINT32_MAX;
     }
+    return step > 0 ? last - address + 1 : address - first + 1;
 }
 
-void cpu::rlc_r(const registers r, const bool hl, const bool z_flag,
-                const bool one_cycle) {
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-        uint8_t msbit = (*rp >> 7) & 1; // save the "carry" bit
-        *rp = *rp << 1;
-        *rp = (*rp & 0xfe) | msbit; // put carry_flag into bit 0
-                                    // set flags
-        if (!z_flag) {
-            this->Zf = false;
-        } else {
-            this->Zf = *rp == 0;
-        }
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = msbit == 1;
-    };
-
-    if (one_cycle) {
-        assert(r == registers::A &&
-               "You are running RLCA but the register is not A!");
-        m1();
-        return;
+const block_cache::decoded_block *cpu::bulk_loop() const {
+    // on an instruction boundary at the start, come around from the branch
+    const block_cache::block *block = this->cached_block;
+    if (!block || !block->decoded->bulk_cycles ||
+        this->cached_index != block->decoded->instructions.size() ||
+        this->PC != block->decoded->instructions[0].pc || !this->fetch_opcode ||
+        this->halt || !this->M_operations.empty() ||
+        !this->I_operations.empty() || this->gb_interrupt->ei_delay ||
+        !can_run_ahead()) {
+        return nullptr;
     }
-
-    auto m1_hl = [=]() {
-        // does nothing, get opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t msbit = (this->Z >> 7) & 1; // save the "carry" bit
-        this->Z = this->Z << 1;
-        this->Z = (this->Z & 0xfe) | msbit; // put carry_flag into bit 0
-                                            // set flags
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = msbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
-    }
-}
-
-void cpu::rr_r(const registers r, const bool hl, const bool z_flag,
-               const bool one_cycle) {
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-        uint8_t lsbit = *rp & 1;                // save the "carry" bit
-        uint8_t carry_flag = this->Cf;          // take current carry flag
-        *rp = *rp >> 1;                         // left shift A by 1 bit
-        *rp = (*rp & 0x7f) | (carry_flag << 7); // put carry_flag into bit 0
-                                                // set flags
-        if (!z_flag) {
-            this->Zf = false;
-        } else {
-            this->Zf = *rp == 0;
-        }
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    if (one_cycle) {
-        assert(r == registers::A &&
-               "You are running RRA but the register is not A!");
-        m1();
-        return;
+#ifdef RICEBOY_NATIVE
+    if (this->native_cycles) {
+        return nullptr;
     }
+#endif
 
-    auto m1_hl = [=]() {
-        // does nothing, get opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t lsbit = this->Z & 1;   // save the "carry" bit
-        uint8_t carry_flag = this->Cf; // take current carry flag
-        this->Z = this->Z >> 1;        // left shift A by 1 bit
-        this->Z = (this->Z & 0x7f) | (carry_flag << 7); // put carry_flag into
-                                                        // bit 0 set flags
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    // still the code in memory
+    if (block->version != this->gb_mmu->page_versions[this->PC >> 8] ||
+        this->cached_bank_switches != this->gb_mmu->bank_switches) {
+        return nullptr;
     }
+    return block->decoded;
 }
 
-void cpu::rrc_r(const registers r, const bool hl, const bool z_flag,
-                const bool one_cycle) {
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-        uint8_t lsbit = *rp & 1;           // save the "carry" bit
-        *rp = *rp >> 1;                    // left shift A by 1 bit
-        *rp = (*rp & 0x7f) | (lsbit << 7); // put carry_flag into bit 0
-                                           // set flags
-        if (!z_flag) {
-            this->Zf = false;
-        } else {
-            this->Zf = *rp == 0;
-        }
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    if (one_cycle) {
-        assert(r == registers::A &&
-               "You are running RRCA but the register is not A!");
-        m1();
-        return;
-    }
+uint32_t cpu::bulk_iterations() const {
+    bulk_idiom idiom{};
+    const bool bulk = this->_bulk_idiom(*this->cached_block->decoded, idiom);
+    assert(bulk && "not at a copy or fill loop!");
+    (void)bulk;
 
-    auto m1_hl = [=]() {
-        // does nothing, get opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t lsbit = this->Z & 1; // save the "carry" bit
-        this->Z = this->Z >> 1;
-        this->Z = (this->Z & 0x7f) | (lsbit << 7); // put carry_flag into bit 0
-                                                   // set flags
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    // watched accesses want the clock and PC of every iteration
+    if (this->gb_mmu->watching()) {
+        return 0;
     }
-}
 
-void cpu::sra_r(const registers r, const bool hl) {
-    auto m1 = [=]() {
-        uint8_t *rp = this->_get_register(r); // r falls out of scope for some
-                                              // reason uint8_t* rp = &this->B;
-
-        uint8_t msbit_retain = *rp & 0x80;
-
-        uint8_t lsbit = *rp & 1;
-        *rp = (*rp >> 1) | msbit_retain;
-
-        this->Zf = *rp == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    auto m1_hl = [=]() {
-        // does nothing, gets opcode fater cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = this->_combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t msbit_retain = this->Z & 0x80;
-        uint8_t lsbit = this->Z & 1;
-        this->Z = (this->Z >> 1) | msbit_retain;
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    // the branch is taken until the counter reaches 0, counting from 0 wraps
+    uint32_t left = idiom.counter ? this->*idiom.counter : this->BC;
+    if (left == 0) {
+        left = idiom.counter ? 0x100 : 0x10000;
     }
-}
-
-void cpu::swap_r(const registers r, const bool hl) {
-    auto m1 = [=]() {
-        uint8_t *rp = this->_get_register(r); // r falls out of scope for some
-                                              // reason uint8_t* rp = &this->B;
-
-        uint8_t lsb = *rp & 0x0f;
-        *rp >>= 4;
-        *rp = *rp | (lsb << 4);
-
-        // 0010 1011 == 1011 0010
-
-        this->Zf = *rp == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = false;
-    };
-
-    auto m1_hl = [=]() {
-        // does nothing, gets opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t lsb = this->Z & 0x0f;
-        this->Z >>= 4;
-        this->Z = this->Z | (lsb << 4);
-
-        // 0010 1011 == 1011 0010
+    uint32_t iterations = left - 1;
 
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = false;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    const uint16_t destination = this->*idiom.destination;
+    iterations = std::min(iterations, this->_bulk_reach(
+                                          destination,
+                                          idiom.destination_step, true));
+    if (idiom.source) {
+        iterations = std::min(iterations,
+                              this->_bulk_reach(this->*idiom.source,
+                                                idiom.source_step, false));
     }
-}
-
-void cpu::srl_r(const registers r, const bool hl) {
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-        uint8_t lsbit = *rp & 1;       // save the "carry" bit
-        uint8_t carry_flag = this->Cf; // take current carry flag
-        *rp = *rp >> 1;                // left shift A by 1 bit
-                                       // bit 7 reset to 0
-
-        // set flags
-        this->Zf = *rp == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    auto m1_hl = [=]() {
-        // does nothing, get opcode after cb prefix
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        uint8_t lsbit = this->Z & 1;   // save the "carry" bit
-        uint8_t carry_flag = this->Cf; // take current carry flag
-        this->Z = this->Z >> 1;        // left shift A by 1 bit
-                                       // bit 7 reset to 0
-
-        this->Zf = this->Z == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = lsbit == 1;
-    };
-
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    if (!iterations) {
+        return 0;
     }
-}
-
-void cpu::cpl() {
-    this->A = ~this->A;
-    this->Nf = true;
-    this->Hf = true;
-}
 
-void cpu::scf() {
-    this->Nf = false;
-    this->Hf = false;
-    this->Cf = true;
+    // the loop must not write over its own code (wram or hram)
+    const std::vector<block_cache::decoded_instruction> &code =
+        this->cached_block->decoded->instructions;
+    const uint16_t code_first = code.front().pc;
+    const uint16_t code_last = code.back().pc + code.back().length - 1;
+    const uint16_t end = static_cast<uint16_t>(
+        destination + idiom.destination_step * (iterations - 1));
+    const uint16_t low = std::min(destination, end);
+    const uint16_t high = std::max(destination, end);
+    if (code_first >= 0x8000 && low <= code_last && high >= code_first) {
+        return 0;
+    }
+    return iterations;
 }
 
-void cpu::ccf() {
-    this->Nf = false;
-    this->Hf = false;
-    this->Cf = !this->Cf;
-}
+void cpu::run_bulk(const uint32_t iterations) {
+    assert(iterations && "no iterations to run!");
+    bulk_idiom idiom{};
+    this->_bulk_idiom(*this->cached_block->decoded, idiom);
 
-void cpu::adc_or_sbc(const registers r1, const bool hl, const bool add) {
-    if (!hl) {
-        uint8_t *r1p = _get_register(r1);
-        uint8_t result{};
-        if (add) {
-            auto [result, z, n, h, c] = _addition_8bit(this->A, *r1p, this->Cf);
-            this->A = result;
-            this->Zf = z;
-            this->Nf = n;
-            this->Hf = h;
-            this->Cf = c;
-        } else {
-            auto [result, z, n, h, c] =
-                _subtraction_8bit(this->A, *r1p, this->Cf);
-            this->A = result;
-            this->Zf = z;
-            this->Nf = n;
-            this->Hf = h;
-            this->Cf = c;
-        }
-    } else {
-        auto m1_adc = [=]() {
-            uint16_t address = _combine_2_8bits(this->H, this->L);
-            this->Z = _get(address);
-            auto [result, z, n, h, c] =
-                _addition_8bit(this->A, this->Z, this->Cf);
-            this->A = result;
-            this->Zf = z;
-            this->Nf = n;
-            this->Hf = h;
-            this->Cf = c;
-        };
-        auto m1_sbc = [=]() {
-            uint16_t address = _combine_2_8bits(this->H, this->L);
-            this->Z = _get(address);
-            auto [result, z, n, h, c] =
-                _subtraction_8bit(this->A, this->Z, this->Cf);
-            this->A = result;
-            this->Zf = z;
-            this->Nf = n;
-            this->Hf = h;
-            this->Cf = c;
-        };
-        if (add) {
-            this->M_operations.push_back(m1_adc);
-        } else {
-            this->M_operations.push_back(m1_sbc);
+    // the same reads and writes in the same order, the loop ran them one
+    // instruction at a time
+    uint16_t &destination = this->*idiom.destination;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        if (idiom.source) {
+            uint16_t &source = this->*idiom.source;
+            this->A = this->_get(source);
+            source += idiom.source_step;
         }
+        this->_set(destination, this->A);
+        destination += idiom.destination_step;
     }
-}
 
-void cpu::add_sp_s8() {
-    // TODO: check logic
-    auto m1 = [=]() {
-        this->Z = this->_get(this->PC);
-        this->PC++;
-    };
-
-    auto m2 = [=]() {
-        auto [result, z, n, h, c] =
-            this->_addition_16bit(this->SP, this->Z, true);
-        this->SP = result;
-        this->Zf = false;
-        this->Nf = false;
-        this->Hf = h;
-        this->Cf = c;
-    };
-
-    auto fill = [=]() {};
-    this->M_operations.push_back(fill);
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
-}
-
-void cpu::and_r(const registers r, const bool hl) {
-    if (!hl) {
-        uint8_t *r1p = _get_register(r);
-        uint8_t result = this->A & *r1p;
-        this->A = result;
-        this->Zf = result == 0;
-        this->Nf = false;
-        this->Hf = true;
-        this->Cf = false;
+    // the counter and the flags its last dec (or the or) left
+    if (idiom.counter) {
+        uint8_t &counter = this->*idiom.counter;
+        counter -= static_cast<uint8_t>(iterations);
+        this->_lazy_flags(flag_op::dec, static_cast<uint8_t>(counter + 1), 0,
+                          this->_carry());
     } else {
-        auto m1 = [=]() {
-            uint16_t address = _combine_2_8bits(this->H, this->L);
-            this->Z = _get(address);
-            uint8_t result = this->A & this->Z;
-            this->A = result;
-            this->Zf = result == 0;
-            this->Nf = false;
-            this->Hf = true;
-            this->Cf = false;
-        };
-        this->M_operations.push_back(m1);
+        this->BC -= static_cast<uint16_t>(iterations);
+        this->A = this->B | this->C;
+        this->_lazy_flags(flag_op::zc, this->A, 0, 0);
     }
 }
 
-void cpu::sub(const registers r, const bool hl) {
-    if (!hl) {
-        auto p = this->_get_register(r);
-        auto [result, z, n, h, c] = this->_subtraction_8bit(this->A, *p);
-        this->A = result;
-
-        // set flags
-        this->Zf = z;
-        this->Nf = n;
-        this->Hf = h;
-        this->Cf = c;
-    } else {
-        auto m1 = [=]() {
-            uint16_t address = _combine_2_8bits(this->H, this->L);
-            this->Z = _get(address);
-            auto [result, z, n, h, c] =
-                this->_subtraction_8bit(this->A, this->Z);
-            this->A = result;
-
-            // set flags
-            this->Zf = z;
-            this->Nf = n;
-            this->Hf = h;
-            this->Cf = c;
-        };
-        this->M_operations.push_back(m1);
+const block_cache::decoded_block *cpu::steady_polling_loop() {
+    // on an instruction boundary right after the read
+    const block_cache::block *block = this->cached_block;
+    if (!block || !block->decoded->poll_cycles || this->cached_index != 1 ||
+        this->PC != block->decoded->instructions[1].pc ||
+        !this->fetch_opcode || this->halt || !this->M_operations.empty() ||
+        !this->I_operations.empty() || this->gb_interrupt->ei_delay ||
+        !can_run_ahead()) {
+        return nullptr;
     }
-}
-
-void cpu::xor_r(const registers r, const bool hl) {
-    if (!hl) {
-        auto p = this->_get_register(r);
-        uint8_t result = this->A ^ *p;
-        this->A = result;
-        // set flags
-        this->Zf = result == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = false;
-    } else {
-        auto m1 = [=]() {
-            uint16_t address = _combine_2_8bits(this->H, this->L);
-            this->Z = _get(address);
-            uint8_t result = this->A ^ this->Z;
-            this->A = result;
-            // set flags
-            this->Zf = result == 0;
-            this->Nf = false;
-            this->Hf = false;
-            this->Cf = false;
-        };
-        this->M_operations.push_back(m1);
+#ifdef RICEBOY_NATIVE
+    if (this->native_cycles) {
+        return nullptr;
     }
-}
+#endif
 
-void cpu::or_r(const registers r, const bool hl) {
-    if (!hl) {
-        auto p = this->_get_register(r);
-        uint8_t result = this->A | *p;
-        this->A = result;
-        // set flags
-        this->Zf = result == 0;
-        this->Nf = false;
-        this->Hf = false;
-        this->Cf = false;
-    } else {
-        auto m1 = [=]() {
-            uint16_t address = _combine_2_8bits(this->H, this->L);
-            this->Z = _get(address);
-            uint8_t result = this->A | this->Z;
-            this->A = result;
-            // set flags
-            this->Zf = result == 0;
-            this->Nf = false;
-            this->Hf = false;
-            this->Cf = false;
-        };
-        this->M_operations.push_back(m1);
+    // between two checks the loop only ran its own instructions, which only
+    // change A and the flags. unchanged means the read returned the same
+    if (this->poll_checked != this->poll_iterations) {
+        this->sync_flags();
+        const uint16_t state = this->AF;
+        this->poll_steady = this->poll_checked != UINT32_MAX &&
+                            this->poll_checked + 1 == this->poll_iterations &&
+                            this->poll_state == state;
+        this->poll_state = state;
+        this->poll_checked = this->poll_iterations;
     }
-}
 
-void cpu::ld_c_a(const bool to_a) {
-    auto m1 = [=]() {
-        const uint16_t address = this->C | 0xff00;
-        if (to_a) {
-            this->A = this->_get(address);
-        } else {
-            this->_set(address, this->A);
-        }
-    };
-
-    this->M_operations.push_back(m1);
-}
-
-void cpu::ld_imm8_a(const bool to_a) {
-    // read imm8
-    auto m1 = [=]() {
-        this->Z = _get(this->PC);
-        this->PC++;
-    };
-
-    auto m2 = [=]() {
-        const uint16_t address = this->Z | 0xff00;
-        if (to_a) {
-            this->A = _get(address);
-            std::cout << "";
-        } else {
-            this->_set(address, this->A);
-            std::cout << "";
-        }
-    };
-
-    this->M_operations.push_back(m2);
-    this->M_operations.push_back(m1);
+    // watched reads want the clock and PC of every poll
+    return this->poll_steady && !this->gb_mmu->watching() ? block->decoded
+                                                          : nullptr;
 }
 
-void cpu::ld_a_rr(const registers r1, const registers r2, const bool to_a) {
-    // read imm8
-    auto m1 = [=]() {
-        uint8_t *r1_p = _get_register(r1);
-        uint8_t *r2_p = _get_register(r2);
-        uint16_t address = this->_combine_2_8bits(*r1_p, *r2_p);
-        this->A = _get(address);
-    };
-
-    auto m2 = [=]() {
-        uint8_t *r1_p = _get_register(r1);
-        uint8_t *r2_p = _get_register(r2);
-        uint16_t address = this->_combine_2_8bits(*r1_p, *r2_p);
-        this->_set(address, this->A);
-    };
-
-    if (to_a) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m2);
+uint16_t cpu::poll_address() const {
+    const block_cache::decoded_instruction &read =
+        this->cached_block->decoded->instructions.front();
+    switch (read.opcode) {
+    case 0xf0: return 0xff00 | this->gb_mmu->read_memory(read.pc + 1);
+    case 0xfa:
+        return (this->gb_mmu->read_memory(read.pc + 2) << 8) |
+               this->gb_mmu->read_memory(read.pc + 1);
+    case 0xf2: return 0xff00 | this->C;
+    case 0x7e: return this->HL;
+    case 0x0a: return this->BC;
+    default: return this->DE;
     }
 }
 
-void cpu::res_or_set(const uint8_t bit, const registers r, const bool set,
-                     const bool hl) {
-
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-
-        // res
-        // 1111 1110
-        // 0 = 1, 1 = 2, 2 = 4, 3 = 8, 4 = 16, 5 = 32, 6 = 64, 7 = 128
-        // 0000 0001, 0000 0010, 0000 0011, 0000 0100, 0000 0101, 00000
-        if (!set) {
-            uint8_t mask = ~(1 << bit);
-            *rp = *rp & mask;
-        } else {
-            // 0100 1010 , set 2
-            uint8_t mask = 1 << bit;
-            *rp = *rp | mask;
-        }
-    };
-
-    auto m1_hl = [=]() {
-        // does nothing, get opcode after cb
-    };
-
-    auto m2_hl = [=]() {
-        // res
-        // 1111 1110
-        // 0 = 1, 1 = 2, 2 = 4, 3 = 8, 4 = 16, 5 = 32, 6 = 64, 7 = 128
-        // 0000 0001, 0000 0010, 0000 0011, 0000 0100, 0000 0101, 00000
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-
-        if (!set) {
-            uint8_t mask = ~(1 << bit);
-            this->Z = this->Z & mask;
-        } else {
-            // 0100 1010 , set 2
-            uint8_t mask = 1 << bit;
-            this->Z = this->Z | mask;
-        }
-    };
+void cpu::_execute_decoded(const block_cache::decoded_instruction &decoded) {
+    // same as identify_opcode, with the opcode (and cb opcode) already read
+#ifdef RICEBOY_PROFILER
+    this->_profile_instruction(decoded.pc, decoded.index);
+#endif
+    this->cached_index++;
+    this->PC += decoded.index >= 256 ? 2 : 1;
 
-    auto m3_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        _set(address, this->Z);
-    };
+    const instruction &i = instructions[decoded.index];
+    this->M_operations.load(i.program);
 
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m3_hl);
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
+    if (i.fetch) {
+        (this->*(i.fetch))();
     }
-}
 
-void cpu::bit(const uint8_t bit, const registers r, const bool hl) {
-
-    auto m1 = [=]() {
-        uint8_t *rp = _get_register(r);
-
-        this->Zf = !((*rp >> bit) & 1);
-        this->Nf = false;
-        this->Hf = true;
-    };
-
-    auto m1_hl = [=]() {
-        // does nothing, get prefix after cb opcode
-    };
-
-    auto m2_hl = [=]() {
-        uint16_t address = _combine_2_8bits(this->H, this->L);
-        this->Z = _get(address);
-        this->Zf = !((this->Z >> bit) & 1);
-        this->Nf = false;
-        this->Hf = true;
-    };
-
-    if (!hl) {
-        this->M_operations.push_back(m1);
-    } else {
-        this->M_operations.push_back(m2_hl);
-        this->M_operations.push_back(m1_hl);
-    }
-}
-
-void cpu::daa() {
-    if (!this->Nf) {
-        if (this->Cf || this->A > 0x99) {
-            this->A += 0x60;
-            this->Cf = true;
-        }
-        if (this->Hf || (this->A & 0x0f) > 0x09) {
-            this->A += 0x6;
-        }
-    } else {
-        if (this->Cf) {
-            this->A -= 0x60;
-        }
-        if (this->Hf) {
-            this->A -= 0x6;
-        }
+    if (!this->M_operations.empty()) {
+        this->fetch_opcode = false;
     }
-    this->Zf = (this->A == 0);
-    this->Hf = false;
 }
 
-void cpu::ei_or_di(const bool ei) {
-    if (ei) {
-        // this->ime = true;
-        this->gb_interrupt->ei_delay = true;
-
-    } else {
-        this->gb_interrupt->ime = false;
+#ifdef RICEBOY_NATIVE
+bool cpu::_run_native(const block_cache::decoded_instruction &decoded) {
+    // only whole blocks of rom code are compiled, entered at their start
+    block_cache::block *block = this->cached_block;
+    if (this->PC > 0x7fff || this->cached_index != 0 ||
+        &block->decoded->instructions[0] != &decoded) {
+        return false;
     }
-}
 
-uint8_t cpu::identify_opcode(const uint8_t opcode) {
-    if (!this->halt_bug) {
-        this->PC++; // increment program counter, fails to increment if halt bug
-                    // is active
-    } else if (this->halt_bug) {
-        this->halt_bug = false; // reset halt bug
-    }
-
-    handle_opcode(opcode); // handle the opcode
-    if (!this->M_operations.empty()) {
-        this->fetch_opcode = false; // going past fetch opcode,
+#ifdef RICEBOY_JIT
+    if (block->runs == jit::hot_runs) {
+        if (!this->native.compile(*this, *block,
+                                  this->gb_mmu->rom_bank(this->PC))) {
+            // code buffer is full, start over. only the host code goes, the
+            // decoded block (and decoded, in it) stay for the interpreter
+            this->native.flush();
+            this->code_cache.drop_native();
+            return false;
+        }
     }
-    return opcode;
-}
+#endif
+
+    if (!block->native ||
+        block->native_m_cycles > this->_uninterrupted_m_cycles()) {
+        return false;
+    }
+
+    // host code works on F directly
+    this->sync_flags();
+#ifdef RICEBOY_PROFILER
+    this->_profile_instruction(decoded.pc, decoded.index);
+#endif
+
+#ifdef RICEBOY_JIT
+    const jit::block_function function =
+        reinterpret_cast<jit::block_function>(block->native);
+    const uint8_t cycles = function(this);
+#else
+    // plugins work on a copy of the registers
+    aot::registers registers{};
+    registers.AF = this->AF;
+    registers.BC = this->BC;
+    registers.DE = this->DE;
+    registers.HL = this->HL;
+    registers.SP = this->SP;
+    registers.PC = this->PC;
+    const uint8_t cycles =
+        reinterpret_cast<aot::block_function>(block->native)(&registers);
+    this->AF = registers.AF;
+    this->BC = registers.BC;
+    this->DE = registers.DE;
+    this->HL = registers.HL;
+    this->SP = registers.SP;
+    this->PC = registers.PC;
+#endif
+
+    // continue with the first instruction that was not compiled, if the block
+    // fell through to it
+    this->cached_index = block->native_length;
+    this->native_cycles = cycles - 1;
+    return true;
+}
+
+uint32_t cpu::_uninterrupted_m_cycles() const {
+    if (!this->gb_interrupt->ime) {
+        return UINT32_MAX;
+    }
+    if (this->gb_interrupt->interrupt_enable_flag &
+        this->gb_interrupt->interrupt_flags & 0x1f) {
+        return 0;
+    }
+    // counted from where the timer and ppu are
+    const uint32_t m_cycles = m_cycles_until_interrupt();
+    return m_cycles > this->m_cycles_behind
+               ? m_cycles - this->m_cycles_behind
+               : 0;
+}
+#endif
+
+#ifdef RICEBOY_PROFILER
+void cpu::_profile_instruction(const uint16_t pc, const uint16_t index) {
+    this->profile->instruction(pc <= 0x7fff ? this->gb_mmu->rom_bank(pc) : 0,
+                               pc, index, this->SP);
+}
+#endif
 
 void cpu::execute_M_operations() {
     // execute any further instructions
     if (!this->M_operations.empty()) {
         this->fetch_opcode = false;
-        std::function<void()> operation = this->M_operations.back();
-        this->M_operations.pop_back();
-        // TODO: check if this reference is valid
-        operation();
+        const micro_op operation = this->M_operations.pop();
+        (this->*operation)();
     }
     if (this->M_operations.empty()) {
         this->fetch_opcode = true;
@@ -1850,10 +764,8 @@ void cpu::execute_I_operations() {
     // execute any further instructions
     if (!this->I_operations.empty()) {
         this->fetch_opcode = false;
-        std::function<void()> operation = this->I_operations.back();
-        this->I_operations.pop_back();
-        // TODO: check if this reference is valid
-        operation();
+        const micro_op operation = this->I_operations.pop();
+        (this->*operation)();
     }
     if (this->I_operations.empty()) {
         this->fetch_opcode = true;
@@ -1912,6 +824,17 @@ void cpu::prepare_rom(std::string path) {
 }
 
 void cpu::load_rom() {
+    // rom contents change, drop anything decoded from the boot rom
+    this->code_cache.clear();
+    this->cached_block = nullptr;
+    this->loaded_code.reset();
+#ifdef RICEBOY_JIT
+    this->native.flush();
+#endif
+#ifdef RICEBOY_AOT
+    this->plugin.unload();
+#endif
+
     std::ifstream file(
         this->rom,
         std::ios::binary |
@@ -1926,14 +849,12 @@ void cpu::load_rom() {
         file.seekg(0, std::ios::beg); // move cursor to beginning of file
         file.read(buffer.data(), size);
 
-        // cartridge type defined in 147
-        this->gb_mmu->set_cartridge_type(buffer[0x0147]);
-        // this->gb_mmu->set_cartridge_type(0);
+#ifdef RICEBOY_AOT
+        this->plugin.load(this->rom, buffer.data(), buffer.size());
+#endif
 
-        for (long i = 0; i < size; ++i) {
-            // TODO: make sure rom doesnt take up more space than it should
-            this->_set(i, buffer[i]);
-        }
+        this->gb_mmu->load_cartridge(buffer.data(), buffer.size());
+        this->loaded_code = shared_code::of(this->gb_mmu->rom_image());
         // this->PC = 0; // initialize program counter
     }
 }
@@ -1949,21 +870,14 @@ cpu::cpu(mmu &mmu, timer &timer, interrupt &interrupt) {
 
 void cpu::initialize_skip_bootrom_values() {
     // initialize values if skipping bootrom
-    A = 0x01;
-    B = 0x00;
-    C = 0x13;
-    D = 0x00;
-    E = 0xd8;
-    Zf = true;
-    Nf = false;
-    Hf = true;
-    Cf = true;
-    H = 0x01;
-    L = 0x4d;
+    AF = 0x01b0; // z, h and c set
+    lazy_op = flag_op::none;
+    BC = 0x0013;
+    DE = 0x00d8;
+    HL = 0x014d;
     SP = 0xfffe;
     PC = 0x0100;
-    W = 0x00;
-    Z = 0x50;
+    WZ = 0x0050;
     halt = false;
     halt_bug = false;
     interrupt_ticks = 3;
@@ -1980,6 +894,12 @@ void cpu::tick() {
 
     this->ticks = 0; // reset ticks
 
+    this->begin_m_cycle();
+    this->execute_m_cycle();
+    this->end_m_cycle();
+}
+
+void cpu::begin_m_cycle() {
     // tick the timer
     // this->gb_timer->tick(); // increment internal div before cpu writes
 
@@ -2009,13 +929,34 @@ void cpu::tick() {
     else if (this->gb_mmu->gb_ppu->dma_mode) {
         this->gb_mmu->dma_transfer();
     }
+}
+
+void cpu::execute_m_cycle() {
+#ifdef RICEBOY_PROFILER
+    this->profile->cycle();
+#endif
+
+#ifdef RICEBOY_NATIVE
+    // the cpu is ahead after running a block natively, it only ran one no
+    // interrupt could come in during
+    if (this->native_cycles) {
+        this->native_cycles--;
+        return;
+    }
+#endif
 
     if (M_operations.empty()) {
         handle_interrupts();
     }
 
-    // set IME before executing instructions
-    const uint8_t opcode = this->_get(this->PC); // get current opcode
+    // the opcode is only needed to fetch or for a pending ei, decoded blocks
+    // skip the bus read
+    const block_cache::decoded_instruction *decoded{nullptr};
+    uint8_t opcode{0};
+    if ((this->fetch_opcode && !this->halt) || this->gb_interrupt->ei_delay) {
+        decoded = this->_cached_instruction();
+        opcode = decoded ? decoded->opcode : this->_fetch(this->PC);
+    }
 
     // ime should be set before execution of next opcode
     if (this->gb_interrupt->ei_delay && opcode != 0xfb) {
@@ -2027,7 +968,14 @@ void cpu::tick() {
         // fetch opcode, then execute what you can this M-cycle
 
         if (this->fetch_opcode) {
-            identify_opcode(opcode);
+            if (decoded) {
+#ifdef RICEBOY_NATIVE
+                if (!this->_run_native(*decoded))
+#endif
+                    this->_execute_decoded(*decoded);
+            } else {
+                identify_opcode(opcode);
+            }
         }
 
         else if (!M_operations.empty()) {
@@ -2044,50 +992,63 @@ void cpu::tick() {
 
         // TODO: are interrupts affected by HALT?
     }
+}
 
+void cpu::end_m_cycle() {
     if (this->gb_timer->tima_overflow) {
         this->gb_timer->tima_overflow_standby = true;
     }
 }
 
-void cpu::push_interrupts() {
-    auto m1 = [=]() {};              // NOP
-    auto m2 = [=]() { this->SP--; }; // pre-decrement SP
-
-    auto m3 = [=]() {
-        // write pc high to stack (upper byte push)
-        this->_set(this->SP, this->PC >> 8);
-        this->SP--;
-    };
-
-    auto m4 = [=]() {
-        // write pc low to stack (lower byte push)
-
-        // NOTE: if IE was pushed this cycle, it's too late. the reason is
-        // because this whole function (handle interrupts) occurs BEFORE cpu
-        // execution, so we are always looking at the IE value BEFORE the
-        // current M-cycle
-
-        this->_set(this->SP, this->PC & 0xff);
-
-        this->PC = static_cast<uint16_t>(this->gb_interrupt->current_interrupt);
+bool cpu::can_run_ahead() const {
+    // dma reads and writes memory every M-cycle, and the boot rom check
+    // reads 0xff50 every M-cycle
+    return this->ticks == 0 && this->boot_rom_complete &&
+           !this->gb_mmu->gb_ppu->dma_delay && !this->gb_mmu->gb_ppu->dma_mode;
+}
 
-        this->gb_interrupt->interrupt_flags &=
-            static_cast<uint8_t>(this->gb_interrupt->current_if_mask);
-    };
+bool cpu::reads_interrupt_flags() const {
+    // handle_interrupts runs when no instruction is in flight, with IE clear
+    // or nothing able to act on IF (no ime, no halt, no dispatch) the result
+    // does not depend on the timer or ppu
+    if (!this->M_operations.empty()) {
+        return false;
+    }
+    if (!this->I_operations.empty()) {
+        return true;
+    }
+    return (this->gb_interrupt->interrupt_enable_flag & 0x1f) &&
+           (this->gb_interrupt->ime || this->gb_interrupt->ei_delay ||
+            this->halt);
+}
 
-    auto m5 = [=]() {
-        this->gb_interrupt->ime = false;
-        this->gb_interrupt->current_interrupt = interrupt::interrupts::none;
-        this->gb_interrupt->current_if_mask = interrupt::if_mask::none;
-    };
+uint32_t cpu::m_cycles_until_interrupt() const {
+    const uint8_t enabled = this->gb_interrupt->interrupt_enable_flag & 0x1f;
+    uint32_t m_cycles{UINT32_MAX};
+    if (enabled & 4) {
+        // IF is set an M-cycle after the one overflowing tima
+        m_cycles = this->gb_timer->m_cycles_until_overflow();
+    }
+    const uint32_t dots =
+        this->gb_mmu->gb_ppu->dots_until_interrupt(enabled);
+    if (dots != UINT32_MAX) {
+        m_cycles = std::min(m_cycles, dots / 4);
+    }
+    return m_cycles;
+}
 
-    this->I_operations.push_back(m5);
-    this->I_operations.push_back(m4);
-    this->I_operations.push_back(m3);
-    this->I_operations.push_back(m2);
-    this->I_operations.push_back(m1);
+bool cpu::can_skip_halt() const {
+#ifdef RICEBOY_NATIVE
+    if (this->native_cycles) {
+        return false;
+    }
+#endif
+    return this->halt && can_run_ahead() && !this->gb_interrupt->ei_delay &&
+           this->M_operations.empty() && this->I_operations.empty();
+}
 
+void cpu::push_interrupts() {
+    this->I_operations.load(interrupt_program);
     this->fetch_opcode = false;
 }
 
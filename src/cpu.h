@@ -1,52 +1,142 @@
 #pragma once
 
+#include "block_cache.h"
 #include "mmu.h"
 #include "ppu.h"
 #include <array>
 #include <cstdint>
-#include <functional>
 #include <iomanip>
 #include <iostream>
-#include <tuple>
+#include <memory>
 #include <vector>
 #include "timer.h"
 #include "interrupt.h"
-
-class cpu {
+#ifdef RICEBOY_JIT
+#include "jit.h"
+#endif
+#ifdef RICEBOY_AOT
+#include "aot.h"
+#endif
+#if defined(RICEBOY_JIT) || defined(RICEBOY_AOT)
+// blocks can run as host code, from the jit or an aot plugin
+#define RICEBOY_NATIVE
+#endif
+#ifdef RICEBOY_PROFILER
+#include "profiler.h"
+#endif
+
+// the registers and the state every M-cycle touches come first and stay
+// together, the rom path, code cache and profiler come after them
+class alignas(64) cpu {
     // TODO: make private
 
   public:
+    enum class conditions { NA, Z, NZ, C, NC };
+
+    // a single M-cycle of an instruction
+    using micro_op = void (cpu::*)();
+
+    // the M-cycles an instruction runs after its opcode fetch, in order
+    struct micro_program {
+        std::array<micro_op, 5> steps{};
+        uint8_t length{0};
+    };
+
+    // a decoded opcode. handlers are templates on the opcode's fields
+    // (registers, conditions, bit index, alu op), so every opcode gets its own
+    // straight-line handlers and nothing is decoded while it runs
+    struct instruction {
+        micro_op fetch{nullptr};   // work done during the opcode fetch M-cycle
+        micro_program program{};   // M-cycles after the fetch
+        uint8_t length{1}; // bytes, including operands
+        bool ends_block{false}; // may leave straight-line code (jumps, halt)
+    };
+
+    // alu[y] and the cb rotates and shifts rot[y]
+    enum class alu_op : uint8_t {
+        add,
+        adc,
+        sub,
+        sbc,
+        logic_and,
+        logic_xor,
+        logic_or,
+        cp
+    };
+    enum class rot_op : uint8_t { rlc, rrc, rl, rr, sla, sra, swap, srl };
+
+    // steps through the micro program of the current instruction, one micro
+    // op per M-cycle
+    class micro_op_queue {
+      public:
+        void load(const micro_program &program) {
+            this->program = program.length ? &program : nullptr;
+            this->step = 0;
+        }
+
+        micro_op pop() {
+            const micro_op operation = this->program->steps[this->step++];
+            if (this->step == this->program->length) {
+                this->program = nullptr;
+            }
+            return operation;
+        }
+
+        // ends the program early (conditional instructions not taken)
+        void clear() { this->program = nullptr; }
+
+        bool empty() const { return this->program == nullptr; }
+
+      private:
+        const micro_program *program{nullptr};
+        uint8_t step{0};
+    };
+
     // pointer to mmu
     cpu(mmu &mmu, timer &timer, interrupt &interrupt); // pass by reference
     mmu *gb_mmu{}; // the central mmu
     timer *gb_timer{};
     interrupt *gb_interrupt{};
 
-    // main 8-bit registers
-    uint8_t A{1};
-    uint8_t B{0};
-    uint8_t C{0};
-    uint8_t D{0};
-    uint8_t E{0};
-
-    // flags register, 4 MSBs: Z(ero) N(subtract) H(half-carry) C(carry), 4 LSB
-    // 0 0 0 0 unused
-    // uint8_t F{};
-    bool Zf{false}; // zero flag
-    bool Nf{false}; // subtract flag
-    bool Hf{false}; // half-carry flag
-    bool Cf{false}; // carry-flag
-
-    uint8_t H{0};
-    uint8_t L{0};
+    // register file, each pair is a native 16-bit register overlaid on its
+    // two 8-bit halves (msb first in the pair's name), laid out for the
+    // host's byte order so both views alias. this relies on two things iso
+    // c++ leaves out but gcc, clang and msvc all give: anonymous structs in a
+    // union (-Wpedantic, msvc C4201), and reading the member that wasn't
+    // written last as the bytes of the one that was (union type punning).
+    // cpu.cpp checks the layout
+    // F holds the flags in its 4 MSBs: Z(ero) N(subtract) H(half-carry)
+    // C(carry), the 4 LSBs are always 0
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    union { uint16_t AF{0x0100}; struct { uint8_t A, F; }; };
+    union { uint16_t BC{0}; struct { uint8_t B, C; }; };
+    union { uint16_t DE{0}; struct { uint8_t D, E; }; };
+    union { uint16_t HL{0}; struct { uint8_t H, L; }; };
+    // temporary registers for complex operations
+    union { uint16_t WZ{0}; struct { uint8_t W, Z; }; };
+#else
+    union { uint16_t AF{0x0100}; struct { uint8_t F, A; }; };
+    union { uint16_t BC{0}; struct { uint8_t C, B; }; };
+    union { uint16_t DE{0}; struct { uint8_t E, D; }; };
+    union { uint16_t HL{0}; struct { uint8_t L, H; }; };
+    // temporary registers for complex operations
+    union { uint16_t WZ{0}; struct { uint8_t Z, W; }; };
+#endif
 
     // 16-bit registers - stack pointer, program counter
     uint16_t SP{0};
     uint16_t PC{0};
 
-    // temporary registers for complex operations
-    uint8_t W{0};
-    uint8_t Z{0};
+    // flag bits of F
+    static constexpr uint8_t flag_z{0x80};
+    static constexpr uint8_t flag_n{0x40};
+    static constexpr uint8_t flag_h{0x20};
+    static constexpr uint8_t flag_c{0x10};
+
+    // flags are evaluated lazily, F (and AF) is only current after
+    // sync_flags(). call it before reading or writing them from outside the
+    // cpu
+    void sync_flags();
 
     // interrupts, ime is either 0 or 1
     //bool ei_delay{false};
@@ -58,8 +148,8 @@ class cpu {
                           // should fail to increment after the next instruction
                           // (or you can just decrement it directly)
 
-    std::vector<std::function<void()>> M_operations{};
-    std::vector<std::function<void()>> I_operations{};
+    micro_op_queue M_operations{};
+    micro_op_queue I_operations{};
 
     // execute instructions
     // int is status (0 = success, 1 = error)
@@ -74,8 +164,50 @@ class cpu {
     uint8_t identify_opcode(
         const uint8_t opcode); // get the next opcode and increment the PC
 
+    // bytes the base opcode takes, including operands
+    static uint8_t instruction_length(const uint8_t opcode);
+
     void tick();           // single cpu background_tick
 
+    // the M-cycle of tick() in 3 parts so the fast core can run the cpu's own
+    // work ahead of the timer and ppu: timer and dma side, the cpu, then the
+    // end of the cycle
+    void begin_m_cycle();
+    void execute_m_cycle();
+    void end_m_cycle();
+
+    // the next M-cycle can run ahead (on an M-cycle boundary, no dma)
+    bool can_run_ahead() const;
+    // the next M-cycle checks interrupts against IF, so the timer and ppu
+    // must have caught up first
+    bool reads_interrupt_flags() const;
+    // M-cycles from this one on whose IF, as the cpu sees it, can't have a
+    // bit IE enables newly set by the timer or ppu. UINT32_MAX if it never
+    // can
+    uint32_t m_cycles_until_interrupt() const;
+    // fast mode: M-cycles the timer and ppu are behind this one, set before
+    // each execute_m_cycle()
+    uint32_t m_cycles_behind{0};
+    // halted with nothing in flight, the cpu's part of an M-cycle does nothing
+    // until IE & IF, so the timer and ppu can be stepped without it
+    bool can_skip_halt() const;
+    // the polling loop the cpu is in, right after its read, if it came around
+    // the loop with the same read value as last time round. until the read
+    // returns something else every iteration is the same. nullptr otherwise
+    const block_cache::decoded_block *steady_polling_loop();
+    // address the polling loop reads
+    uint16_t poll_address() const;
+    // the copy or fill loop the cpu is at the start of, come around from its
+    // own branch and still what is in memory. nullptr otherwise
+    const block_cache::decoded_block *bulk_loop() const;
+    // iterations of it that can run at once: all but the last one the counter
+    // allows, as far as its pointers stay in memory only the cpu sees. 0 if
+    // none
+    uint32_t bulk_iterations() const;
+    // run iterations of it at once, the cpu ends up at its start as if it had
+    // stepped through them
+    void run_bulk(const uint32_t iterations);
+
     void handle_interrupts(); // handle interrupts
     void push_interrupts();
 
@@ -86,33 +218,54 @@ class cpu {
     // load
     void prepare_rom(std::string path);
     void load_rom();
-    std::string rom;
 
     // read write memory
-    uint8_t _get(const uint16_t address);
-    void _set(const uint16_t address, const uint8_t value);
-
-    // registers
-    enum class registers {
-        A,
-        B,
-        C,
-        D,
-        E,
-        H,
-        L,
-        NA // NA means null (if register is SP
-    };
-
-    enum class conditions { NA, Z, NZ, C, NC };
-
-    enum class bitops { AND, XOR, OR };
-
+    uint8_t _get(const uint16_t address) {
+        return this->gb_mmu->bus_read_memory(address);
+    }
+    void _set(const uint16_t address, const uint8_t value) {
+        this->gb_mmu->bus_write_memory(address, value);
+    }
+    // opcode and operand reads at PC, straight from host memory while PC
+    // stays in the code span it last looked up
+    uint8_t _fetch(const uint16_t address) {
+        const uint16_t offset = address - this->fetch_span.first;
+        if (offset < this->fetch_span.size &&
+            this->fetch_version == this->gb_mmu->code_map_version) {
+            return this->fetch_span.data[offset];
+        }
+        return this->_fetch_span(address);
+    }
 
     // skip bootrom
     void initialize_skip_bootrom_values();
 
   private:
+    // the last flag producing op and its operands, F is worked out from them
+    // when something reads it (conditions only look at the flag they need)
+    enum class flag_op : uint8_t {
+        none,      // F is current
+        add,       // x + y + c
+        sub,       // x - y - c
+        inc,       // x + 1, c is the kept carry
+        dec,       // x - 1, c is the kept carry
+        logic_and, // z from x, h set
+        zc,        // z from x, carry c
+        c          // carry c only
+    };
+    flag_op lazy_op{flag_op::none};
+    uint8_t lazy_x{0};
+    uint8_t lazy_y{0};
+    uint8_t lazy_c{0};
+
+    void _lazy_flags(const flag_op op, const uint8_t x, const uint8_t y,
+                     const uint8_t c) {
+        this->lazy_op = op;
+        this->lazy_x = x;
+        this->lazy_y = y;
+        this->lazy_c = c;
+    }
+    bool _zero() const;
 
     // background_tick counter
     uint16_t ticks{0};
@@ -121,130 +274,223 @@ class cpu {
     // state of action, fetch opcode = true or execute further instructions
     bool fetch_opcode{true};
 
-    // TODO: convert all arguments to pass by reference and make them const
-    // micro operations
-    // NOTE: d16 = address
-    void add_a_hl(); // add content from address HL to A
-    void add_hl_rr(const registers r1, const registers r2,
-                   const bool sp);     // add content from address HL to A
-    void add_a_r8(const registers r8); // add content from register r8 to A
-    void add_sp_s8();
-    void call(const conditions condition);
-    void cp_a_imm8(); // compare immediate next byte with A no effect on A
-    void cp_a_r(const registers r,
-                const bool hl); // compare memory[hl] with A no effect on A
-    void inc_or_dec_r8(const registers r8,
-                       const bool inc); // decrement register
-    void inc_or_dec_hl(const bool inc); // decrement register
-    void
-    inc_or_dec_r16(const registers r1, const registers r2, const bool inc,
-                   const bool sp); // inc or dec r16 register, either SP (stack
-                                   // pointer) or 2 individual registers
-    void jp_imm16(const conditions condition); // absolute jump, check z flag
+    // 256 base opcodes followed by 256 cb opcodes, built at compile time
+    // along with the handlers they use (opcodes.cpp)
+    static const std::array<instruction, 512> instructions;
+    static const micro_program interrupt_program;
+
+    static constexpr std::array<instruction, 512> _build_instructions();
+
+    // the block being run out of code_cache and the next instruction in it
+    block_cache::block *cached_block{nullptr};
+    std::size_t cached_index{0};
+    uint32_t cached_bank_switches{0};
+
+    // code span _fetch() reads from, and the mmu's code_map_version when it
+    // was looked up
+    mmu::code_span fetch_span{};
+    uint32_t fetch_version{0};
+    uint8_t _fetch_span(const uint16_t address); // look up the span for address
+
+    // decoded instruction at PC, nullptr when the opcode has to come over the
+    // bus
+    const block_cache::decoded_instruction *_cached_instruction();
+    // set the block up for the code at pc, rom code comes from shared_code
+    void _decode_block(block_cache::block &block, const uint16_t pc);
+    void _decode(block_cache::decoded_block &decoded, uint16_t pc) const;
+    uint8_t
+    _polling_loop_cycles(const block_cache::decoded_block &block) const;
+    // where a jr or jp goes
+    uint16_t
+    _branch_target(const block_cache::decoded_instruction &branch) const;
+
+    // a copy or fill loop: the pointer read (nullptr for a fill, A is
+    // stored) and the one written with their steps per iteration, and the
+    // dec r8 counter (nullptr for dec bc; ld a,b; or c)
+    struct bulk_idiom {
+        uint16_t cpu::*source{nullptr};
+        int8_t source_step{0};
+        uint16_t cpu::*destination{nullptr};
+        int8_t destination_step{0};
+        uint8_t cpu::*counter{nullptr};
+    };
+    bool _bulk_idiom(const block_cache::decoded_block &block,
+                     bulk_idiom &idiom) const;
+    uint8_t _bulk_loop_cycles(const block_cache::decoded_block &block) const;
+    // iterations a pointer stepping from address stays in memory only the cpu
+    // sees, 0 if it isn't in it
+    uint32_t _bulk_reach(const uint16_t address, const int8_t step,
+                         const bool write) const;
+
+    // times the polling loop in cached_block came around from its own branch,
+    // and A and the flags when steady_polling_loop() last looked
+    uint32_t poll_iterations{0};
+    uint32_t poll_checked{UINT32_MAX};
+    uint16_t poll_state{0};
+    bool poll_steady{false};
+    void _execute_decoded(const block_cache::decoded_instruction &decoded);
+
+    // decoded rom, wram and hram code
+    block_cache code_cache{};
+    // the loaded rom's decoded code, none before load_rom()
+    std::shared_ptr<shared_code> loaded_code{};
+
+#ifdef RICEBOY_JIT
+    // host code for hot blocks
+    jit native{};
+#endif
+#ifdef RICEBOY_AOT
+    // host code for rom blocks, compiled ahead of time
+    aot plugin{};
+#endif
+#ifdef RICEBOY_NATIVE
+    // the M-cycles left of the block last run as host code (the rest of the
+    // system catches up before the next fetch)
+    uint8_t native_cycles{0};
+
+    bool _run_native(const block_cache::decoded_instruction &decoded);
+    // M-cycles from this one on in which no interrupt the cpu would take can
+    // come in. a block taking longer runs in the interpreter, which takes
+    // it at the next instruction instead of after the whole block
+    uint32_t _uninterrupted_m_cycles() const;
+#endif
+
+#ifdef RICEBOY_PROFILER
+    void _profile_instruction(const uint16_t pc, const uint16_t index);
+#endif
+
+    // fetch cycle operations
+    template <alu_op op, uint8_t cpu::*r> void alu_r8(); // A = A op r8
+    template <uint8_t cpu::*r> void inc_r8();
+    template <uint8_t cpu::*r> void dec_r8();
     void jp_hl();
-    void jr_s8(conditions condition); // relative jump, check z flag, nz means
-                                      // check if z flag is not 0
-    void
-    ld_imm16_a(const bool to_a); // to a means should i load imm16 to a, or a to
-    void ld_imm16_sp();          // to a means should i load imm16 to a, or a to
-                                 // imm16, covers ld_imm16_a and ld_a_imm16
-    void ld_r_r(const registers r_to,
-                const registers
-                    r_from); // load value from 1 register to another register
-    void ld_r_imm8(const registers r);
-    void ld_hl_imm8();
-    void ld_rr_address(const registers r1, const registers r2, const bool sp);
-    void ld_hl_a(const bool increment, const bool to_a); // hl+ and hl-, and hl
-    void ld_hl_r8(const registers r, const bool to_hl);  // hl+ and hl-, and hl
-    void ld_hl_sp_s8();
-    void ld_sp_hl();
-    void pop_rr(const registers r1, const registers r2, const bool af = false);
-    void push_rr(const registers r1, const registers r2, const bool af = false);
-    void ret(conditions condition, bool ime_condition = false); // return
-
-    void rl_r(const registers r, const bool hl = false,
-              const bool z_flag = false,
-              const bool one_cycle = false); // rotate left accumulator
-    void rlc_r(const registers r, const bool hl = false,
-               const bool z_flag = false, const bool one_cycle = false);
-    void rr_r(const registers r, const bool hl = false,
-              const bool z_flag = false,
-              const bool one_cycle = false); // rotate right accumulator
-    void rrc_r(const registers r, const bool hl = false,
-               const bool z_flag = false,
-               const bool one_cycle = false); // rotate right accumulator
-
-    void sla_r(const registers r,
-               const bool hl = false); // rotate left accumulator
-    void sra_r(const registers r,
-               const bool hl = false); // rotate right accumulator
-    void swap_r(const registers r, const bool hl = false);
-    void srl_r(const registers r, const bool hl = false);
-    // TODO: combine srl and rr, try to find other combos
-    void sub(const registers r, const bool hl);
-    void xor_r(const registers r, const bool hl);
-    void ld_c_a(const bool to_a); // also known as LDH (C), A, to_a reverses LD
-    void
-    ld_imm8_a(const bool to_a); // also known as LDH (n), A, to_a reverses LD
-    void ld_a_rr(
-        const registers r1, const registers r2,
-        const bool to_a); // load memory value from register pair address to A
+    template <uint8_t cpu::*r1, uint8_t cpu::*r2>
+    void ld_r_r(); // load value from 1 register to another register
+    void rlca();
+    void rrca();
+    void rla();
+    void rra();
     void cpl();
     void scf();
     void ccf();
-    void adc_or_sbc(const registers r1, const bool hl, const bool add);
-    void and_r(const registers r, const bool hl);
-    void or_r(const registers r, const bool hl);
-
-    void add_or_sub_a_imm8(const bool add);
-    void adc_or_sbc_imm8(const bool add);
-
-    void and_xor_or_imm8(bitops op);
-
-    void rst(const uint8_t opcode);
-
-    void res_or_set(const uint8_t bit, const registers r, const bool set,
-                    const bool hl = false);
-
-    void bit(const uint8_t bit, const registers r, const bool hl = false);
-
     void daa();
+    void halt_or_halt_bug();
+    void cb_prefix(); // read the cb opcode and switch to its instruction
 
     // interrupts
-    void ei_or_di(const bool ei);
+    void ei();
+    void di();
+
+    // micro ops, one per M-cycle after the opcode fetch
+    // NOTE: d16 = address
+    void fill(); // does nothing (internal delay, or cb opcode fetch)
+    void read_imm_z();
+    void read_imm_w();
+    // read imm into Z, end program if condition fails
+    template <conditions cc> void read_imm_z_cc();
+    void decrement_sp();
+
+    template <alu_op op> void alu_hl_m1();   // A = A op memory[hl]
+    template <alu_op op> void alu_imm8_m1(); // A = A op imm8
+
+    template <uint16_t cpu::*rr> void add_hl_rr_m1();
+    void add_sp_s8_m2();
+    void call_m4();
+    void call_m5();
+    void inc_or_dec_hl_m1();
+    void inc_hl_m2();
+    void dec_hl_m2();
+    template <uint16_t cpu::*rr> void inc_rr_m1();
+    template <uint16_t cpu::*rr> void dec_rr_m1();
+    void jp_m3();
+    void jr_m2();
+    void ld_imm16_sp_m3();
+    void ld_imm16_sp_m4();
+    void ld_imm16_a_m3();
+    void ld_a_imm16_m3();
+    template <uint8_t cpu::*r> void ld_r_imm8_m1();
+    void ld_hl_imm8_m2();
+    void ld_rr_imm16_m1();
+    template <uint16_t cpu::*rr> void ld_rr_imm16_m2();
+    template <uint16_t cpu::*rr>
+    void ld_rr_a_m1(); // ld (bc), a and ld (de), a
+    template <uint16_t cpu::*rr>
+    void ld_a_rr_m1(); // ld a, (bc) and ld a, (de)
+    void ld_hli_a_m1(); // hl+
+    void ld_hld_a_m1(); // hl-
+    void ld_a_hli_m1();
+    void ld_a_hld_m1();
+    template <uint8_t cpu::*r> void ld_hl_r8_m1();
+    template <uint8_t cpu::*r> void ld_r8_hl_m1();
+    void ld_hl_sp_s8_m2();
+    void ld_sp_hl_m1();
+    void ld_c_a_m1(); // also known as LDH (C), A
+    void ld_a_c_m1();
+    void ld_imm8_a_m2(); // also known as LDH (n), A
+    void ld_a_imm8_m2();
+    void pop_m1();
+    template <uint16_t cpu::*rr> void pop_rr_m2();
+    void pop_af_m2();
+    template <uint16_t cpu::*rr> void push_rr_m2();
+    template <uint16_t cpu::*rr> void push_rr_m3();
+    void push_af_m3();
+    template <conditions cc> void ret_cc_m1();
+    void ret_m1();
+    void ret_m2();
+    void ret_m3();
+    void reti_m3();
+    void rst_m2();
+    template <uint8_t vector> void rst_m3();
+
+    // cb prefixed micro ops, (hl) variants write back in cb_hl_m3
+    template <rot_op op, uint8_t cpu::*r> void rot_r_m1();
+    template <rot_op op> void rot_hl_m2();
+    template <uint8_t bit, uint8_t cpu::*r> void bit_r_m1();
+    template <uint8_t bit> void bit_hl_m2();
+    template <uint8_t bit, uint8_t cpu::*r> void res_r_m1();
+    template <uint8_t bit, uint8_t cpu::*r> void set_r_m1();
+    template <uint8_t bit> void res_hl_m2();
+    template <uint8_t bit> void set_hl_m2();
+    void cb_hl_m3();
+
+    // interrupt dispatch
+    void interrupt_m3();
+    void interrupt_m4();
+    void interrupt_m5();
 
     // utility //
-    uint16_t
-    _combine_2_8bits(const uint8_t r1,
-                     const uint8_t r2); // get the register pairs value by
-                                        // combining them into a 16 bit uint
-    std::tuple<uint8_t, uint8_t> _split_16bit(const uint16_t r16);
-
-    // all return result, zero, subtract, half-carry, carry
-    template <typename... Args>
-    std::tuple<uint8_t, bool, bool, bool, bool> _addition_8bit(Args... args);
-
-    std::tuple<uint16_t, bool, bool, bool, bool>
-    _addition_16bit(uint16_t x, uint16_t y, bool s8 = false);
-    std::tuple<uint8_t, bool, bool, bool, bool>
-    _subtraction_8bit(uint8_t x, uint8_t y, uint8_t Cf = 0);
-
-    uint8_t _flags_to_byte()
-        const; // const after function declaration makes it a compiler error to
-               // edit class members inside the function
-
-    std::tuple<bool, bool, bool, bool> _byte_to_flags(uint8_t byte);
-
-    // TODO: make enum
-    uint8_t *_get_register(const registers r8); // get the pointer to the
-                                                // register value based on char8
-
-    // opcode lookup tables
-    std::array<registers, 8> rp_table{
-        registers::B, registers::C,  registers::D, registers::E, registers::H,
-        registers::L, registers::NA, registers::NA}; // sp or af is the last
-
-    std::array<registers, 8> r_table{
-        registers::B, registers::C, registers::D,  registers::E,
-        registers::H, registers::L, registers::NA, registers::A}; // na means HL
+    // flags byte from the individual flags
+    static constexpr uint8_t _flags(const bool z, const bool n, const bool h,
+                                    const bool c) {
+        return (z << 7) | (n << 6) | (h << 5) | (c << 4);
+    }
+    uint8_t _carry() const; // 0 or 1
+
+    // arithmetic, return the result and set flags (inc and dec keep the carry
+    // flag)
+    uint8_t _add8(const uint8_t x, const uint8_t y, const uint8_t carry = 0);
+    uint8_t _sub8(const uint8_t x, const uint8_t y, const uint8_t carry = 0);
+    uint8_t _inc8(const uint8_t x);
+    uint8_t _dec8(const uint8_t x);
+    void _add_hl(const uint16_t value);        // z flag is kept
+    uint16_t _add_sp_s8(const uint8_t offset); // z flag is reset
+
+    // alu op on A, sets flags (cp leaves A alone)
+    template <alu_op op> void _alu(const uint8_t value);
+
+    // rotates and shifts, return the result and set flags (z flag is reset by
+    // the one cycle accumulator variants)
+    template <rot_op op> uint8_t _rot(const uint8_t value);
+
+    template <conditions cc> bool _condition() const;
+
+  public:
+    // path of the rom load_rom() loads
+    std::string rom;
+
+#ifdef RICEBOY_PROFILER
+    // M-cycles per guest instruction and call stack, on the heap so the
+    // profiler's tables don't count against the instance
+    std::unique_ptr<profiler> profile{std::make_unique<profiler>()};
+#endif
 };
@@ -1,4 +1,15 @@
 #include "draw.h"
+#include <array>
+#include <cassert>
+#include <mutex>
+
+namespace {
+
+// palette, white to black
+constexpr std::array<std::array<std::uint8_t, 3>, 4> shade_colors{
+    {{181, 175, 66}, {145, 155, 58}, {93, 120, 46}, {58, 81, 34}}};
+
+} // namespace
 
 // TODO: can be constexpr
 sf::RectangleShape draw::add_pixel(sf::Vector2f position, std::uint8_t red,
@@ -31,3 +42,39 @@ sf::Vertex draw::add_vertex(sf::Vector2f position, std::uint8_t red, std::uint8_
     return vertex;
 
 }
+
+void draw::present(sf::RenderWindow &window, const std::uint8_t *shades,
+                   const unsigned int width, const unsigned int height) {
+    // presenting is once a frame, instances on other threads wait their turn
+    static std::mutex lock{};
+    static sf::Image image{};
+    static sf::Texture texture{};
+    const std::lock_guard<std::mutex> guard(lock);
+
+    // the image and texture are only (re)made when the size changes, after
+    // that a frame is presented without allocating
+    if (image.getSize().x != width || image.getSize().y != height) {
+        image = sf::Image({width, height}, sf::Color::White);
+        bool success = texture.resize({width, height});
+        assert(success && "LCD dots texture error resizing");
+        (void)success;
+    }
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            const unsigned int pixel = y * width + x;
+            const std::array<std::uint8_t, 3> &color =
+                shade_colors[(shades[pixel / 4] >> (2 * (pixel % 4))) & 3];
+            image.setPixel({x, y}, {color[0], color[1], color[2]});
+        }
+    }
+
+    texture.update(image);
+
+    sf::Sprite frame(texture);
+
+    frame.setScale({draw::SCALE, draw::SCALE});
+
+    window.clear(sf::Color::White);
+    window.draw(frame);
+    window.display();
+}
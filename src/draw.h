@@ -10,4 +10,10 @@ class draw {
 
     static sf::Vertex add_vertex(sf::Vector2f position, std::uint8_t red,
                                  std::uint8_t green, std::uint8_t blue);
+
+    // show a frame of lcd shades in the window, width * height of them row by
+    // row, 2 bits each, 4 to a byte from the low bits. every instance draws
+    // through the same image and texture
+    static void present(sf::RenderWindow &window, const std::uint8_t *shades,
+                        const unsigned int width, const unsigned int height);
 };
@@ -1,4 +1,12 @@
 #include "gameboy.h"
+#include <algorithm>
+
+gameboy::gameboy(sf::RenderWindow &window_) : window(window_) {
+    // watchpoint hits carry the cpu's PC and the clock, stopping ends run()
+    this->gb_mmu.watches.pc = &this->gb_cpu.PC;
+    this->gb_mmu.watches.clock = &this->clock;
+    this->gb_mmu.watches.stop = [this] { this->run_end = this->clock; };
+}
 
 void gameboy::tick() {
 	// tick the timer first
@@ -9,6 +17,341 @@ void gameboy::tick() {
 	this->gb_ppu.tick(); 
 }
 
+void gameboy::run(const uint32_t t_cycles) {
+    this->run_end = this->clock + t_cycles;
+    if (this->mode == execution_mode::fast) {
+        this->_run_fast();
+        return;
+    }
+
+    while (this->clock < this->run_end) {
+        const uint64_t left = this->run_end - this->clock;
+        if (left >= 4) {
+            const uint32_t skipped =
+                this->_skip_ahead(static_cast<uint32_t>(left / 4));
+            if (skipped) {
+                this->clock += 4 * skipped;
+                continue;
+            }
+        }
+        this->tick();
+        this->clock++;
+    }
+}
+
+void gameboy::_run_fast() {
+    // the access catching up can write ie or what the timer and ppu raise IF
+    // from, IF is checked again the M-cycle after it
+    this->gb_mmu.catch_up = [this] {
+        this->_catch_up();
+        this->interrupt_free = 0;
+    };
+    this->interrupt_free = 0;
+
+    while (this->clock < this->run_end) {
+        const uint64_t left = this->run_end - this->clock;
+        if (left < 4 || !this->gb_cpu.can_run_ahead()) {
+            // dma, the boot rom, or not on an M-cycle boundary
+            this->_catch_up_all();
+            this->tick();
+            this->clock++;
+            this->interrupt_free = 0;
+            continue;
+        }
+
+        const uint32_t skipped =
+            this->_skip_ahead(static_cast<uint32_t>(left / 4));
+        if (skipped) {
+            this->clock += 4 * skipped;
+            this->interrupt_free = 0;
+            continue;
+        }
+
+        // the cpu's part of this M-cycle, the timer and ppu follow later. IF
+        // only needs them once it can have changed since the last catch up
+        this->pending_m_cycles++;
+        if (this->gb_cpu.reads_interrupt_flags() &&
+            this->pending_m_cycles > this->interrupt_free) {
+            this->_catch_up();
+        }
+        this->gb_cpu.m_cycles_behind = this->pending_m_cycles;
+        this->gb_cpu.execute_m_cycle();
+        this->clock += 4;
+    }
+
+    this->_catch_up_all();
+    this->gb_mmu.catch_up = nullptr;
+}
+
+void gameboy::_m_cycle_head() {
+    // same order as tick(): the timer's 4 T-cycles and the ppu's first 3 come
+    // before the cpu's work (they don't share state with each other)
+    for (int i = 0; i < 4; ++i) {
+        this->gb_timer.tick();
+    }
+    for (int i = 0; i < 3; ++i) {
+        this->gb_ppu.tick();
+    }
+    this->gb_cpu.begin_m_cycle();
+}
+
+void gameboy::_m_cycle_tail() {
+    this->gb_cpu.end_m_cycle();
+    this->gb_ppu.tick();
+}
+
+void gameboy::_catch_up() {
+    if (this->pending_m_cycles == 0) {
+        return; // already caught up to this M-cycle
+    }
+
+    if (this->pending_tail) {
+        this->_m_cycle_tail();
+    }
+
+    // all but the current M-cycle completely, the quiet ones at once
+    uint32_t full = this->pending_m_cycles - 1;
+    while (full) {
+        const uint32_t quiet = std::min(this->_quiet_m_cycles(), full);
+        if (quiet) {
+            this->_skip_quiet(quiet);
+            full -= quiet;
+            continue;
+        }
+        this->_m_cycle_head();
+        this->_m_cycle_tail();
+        full--;
+    }
+
+    // the current one up to the cpu's work
+    this->_m_cycle_head();
+    this->pending_m_cycles = 0;
+    this->pending_tail = true;
+    this->gb_cpu.m_cycles_behind = 0;
+    this->interrupt_free = this->gb_cpu.m_cycles_until_interrupt();
+}
+
+void gameboy::_catch_up_all() {
+    this->_catch_up();
+
+    if (this->pending_tail) {
+        this->_m_cycle_tail();
+        this->pending_tail = false;
+    }
+}
+
+uint32_t gameboy::_skip_ahead(const uint32_t m_cycles) {
+    if (this->gb_cpu.can_skip_halt()) {
+        this->_catch_up_all();
+        return this->_skip_halt(m_cycles);
+    }
+
+    if (const block_cache::decoded_block *loop =
+            this->gb_cpu.steady_polling_loop()) {
+        if (loop->poll_cycles > m_cycles) {
+            return 0;
+        }
+        this->_catch_up_all();
+        return this->_skip_polling_loop(*loop, m_cycles);
+    }
+
+    if (const block_cache::decoded_block *loop = this->gb_cpu.bulk_loop()) {
+        if (loop->bulk_cycles > m_cycles) {
+            return 0;
+        }
+        this->_catch_up_all();
+        const uint32_t iterations = std::min(
+            this->gb_cpu.bulk_iterations(), m_cycles / loop->bulk_cycles);
+        return iterations ? this->_skip_bulk_loop(*loop, iterations) : 0;
+    }
+
+    return 0;
+}
+
+uint32_t gameboy::_quiet_m_cycles() const {
+    const uint32_t until = this->gb_timer.m_cycles_until_overflow();
+    const uint32_t dots = this->gb_ppu.quiet_dots();
+    return std::min(until ? until - 1 : 0,
+                    dots == UINT32_MAX ? UINT32_MAX : dots / 4);
+}
+
+void gameboy::_skip_quiet(const uint32_t m_cycles) {
+    this->gb_timer.skip(m_cycles);
+    this->gb_ppu.skip(m_cycles * 4);
+}
+
+uint32_t gameboy::_skip_halt(const uint32_t m_cycles) {
+    uint32_t m{0};
+    while (m < m_cycles) {
+        const bool wake = this->gb_interrupt.interrupt_enable_flag &
+                          this->gb_interrupt.interrupt_flags & 0x1f;
+
+        // nothing can raise IF before the timer or ppu does something, jump
+        // to the M-cycle before that
+        if (!wake) {
+            const uint32_t skip =
+                std::min(this->_quiet_m_cycles(), m_cycles - m);
+            if (skip) {
+                this->_skip_quiet(skip);
+#ifdef RICEBOY_PROFILER
+                this->gb_cpu.profile->idle(skip);
+#endif
+                m += skip;
+                continue;
+            }
+        }
+
+        // step the timer and ppu, the cpu only acts once IE & IF is set
+        this->_m_cycle_head();
+        if (this->gb_interrupt.interrupt_enable_flag &
+            this->gb_interrupt.interrupt_flags & 0x1f) {
+            this->gb_cpu.execute_m_cycle();
+            this->_m_cycle_tail();
+            return m + 1;
+        }
+        this->gb_interrupt.check_current_interrupt();
+        this->_m_cycle_tail();
+#ifdef RICEBOY_PROFILER
+        this->gb_cpu.profile->idle(1);
+#endif
+        m++;
+    }
+    return m;
+}
+
+uint32_t gameboy::_skip_polling_loop(const block_cache::decoded_block &loop,
+                                     const uint32_t m_cycles) {
+    // the cpu stays right after the read while whole iterations are skipped,
+    // the read is the last M-cycle of an iteration
+    const uint8_t cycles = loop.poll_cycles;
+    const uint16_t address = this->gb_cpu.poll_address();
+    const uint8_t value = this->gb_cpu.A;
+
+    // IF as the cpu saw it in the M-cycle before (the tail can raise it too)
+    uint8_t flags = this->gb_interrupt.interrupt_flags;
+    uint32_t m{0};
+    while (m_cycles - m >= cycles) {
+        // ly, stat, IF and the rest of memory hold over the quiet M-cycles,
+        // div and tima up to their next change. while the read returns the
+        // same and no interrupt is pending, every iteration in them runs at
+        // once
+        const bool pending = this->gb_interrupt.ime &&
+                             (this->gb_interrupt.interrupt_enable_flag &
+                              this->gb_interrupt.interrupt_flags & 0x1f);
+        if (!pending && this->gb_mmu.bus_read_memory(address) == value) {
+            const uint32_t quiet =
+                std::min({this->_quiet_m_cycles(),
+                          this->gb_timer.m_cycles_unchanged(address),
+                          m_cycles - m});
+            const uint32_t run = quiet / cycles * cycles;
+            if (run) {
+                this->_skip_quiet(run);
+#ifdef RICEBOY_PROFILER
+                this->gb_cpu.profile->idle(run);
+#endif
+                m += run;
+                continue;
+            }
+        }
+
+        for (uint8_t i = 0; i < cycles; ++i) {
+            this->_m_cycle_head();
+
+            const bool interrupt =
+                this->gb_interrupt.ime &&
+                (this->gb_interrupt.interrupt_enable_flag &
+                 this->gb_interrupt.interrupt_flags & 0x1f);
+            const bool changed =
+                i == cycles - 1 &&
+                this->gb_mmu.bus_read_memory(address) != value;
+
+            if (interrupt || changed) {
+                // the cpu's work up to here doesn't touch the timer or ppu,
+                // it catches up (seeing IF as it was) and runs this M-cycle
+                const uint8_t current_flags =
+                    this->gb_interrupt.interrupt_flags;
+                this->gb_interrupt.interrupt_flags = flags;
+                for (uint8_t j = 0; j < i; ++j) {
+                    this->gb_cpu.execute_m_cycle();
+                }
+                this->gb_interrupt.interrupt_flags = current_flags;
+
+                this->gb_cpu.execute_m_cycle();
+                this->_m_cycle_tail();
+                return m + i + 1;
+            }
+
+            flags = this->gb_interrupt.interrupt_flags;
+            this->_m_cycle_tail();
+        }
+#ifdef RICEBOY_PROFILER
+        this->gb_cpu.profile->idle(cycles);
+#endif
+        m += cycles;
+    }
+    return m;
+}
+
+uint32_t gameboy::_skip_bulk_loop(const block_cache::decoded_block &loop,
+                                  const uint32_t iterations) {
+    const uint8_t cycles = loop.bulk_cycles;
+
+    // with no interrupt pending every iteration in the quiet M-cycles runs at
+    // once
+    const bool pending = this->gb_interrupt.ime &&
+                         (this->gb_interrupt.interrupt_enable_flag &
+                          this->gb_interrupt.interrupt_flags & 0x1f);
+    if (!pending) {
+        const uint32_t run =
+            std::min(iterations, this->_quiet_m_cycles() / cycles);
+        if (run) {
+            this->_skip_quiet(run * cycles);
+            this->gb_cpu.run_bulk(run);
+#ifdef RICEBOY_PROFILER
+            this->gb_cpu.profile->idle(run * cycles);
+#endif
+            return run * cycles;
+        }
+    }
+
+    // the cpu stays at the start while the timer and ppu step through an
+    // iteration, its reads and writes follow at the end of it
+    uint8_t flags = this->gb_interrupt.interrupt_flags;
+    uint32_t m{0};
+    for (uint32_t n = 0; n < iterations; ++n) {
+        for (uint8_t i = 0; i < cycles; ++i) {
+            this->_m_cycle_head();
+
+            if (this->gb_interrupt.ime &&
+                (this->gb_interrupt.interrupt_enable_flag &
+                 this->gb_interrupt.interrupt_flags & 0x1f)) {
+                // the memory it touches is the cpu's alone, it catches up
+                // (seeing IF as it was) and runs this M-cycle
+                const uint8_t current_flags =
+                    this->gb_interrupt.interrupt_flags;
+                this->gb_interrupt.interrupt_flags = flags;
+                for (uint8_t j = 0; j < i; ++j) {
+                    this->gb_cpu.execute_m_cycle();
+                }
+                this->gb_interrupt.interrupt_flags = current_flags;
+
+                this->gb_cpu.execute_m_cycle();
+                this->_m_cycle_tail();
+                return m + i + 1;
+            }
+
+            flags = this->gb_interrupt.interrupt_flags;
+            this->_m_cycle_tail();
+        }
+        this->gb_cpu.run_bulk(1);
+#ifdef RICEBOY_PROFILER
+        this->gb_cpu.profile->idle(cycles);
+#endif
+        m += cycles;
+    }
+    return m;
+}
+
 void gameboy::skip_bootrom() { 
 	this->gb_mmu.initialize_skip_bootrom_values(); 
 	this->gb_cpu.initialize_skip_bootrom_values(); 
@@ -9,7 +9,13 @@ class gameboy {
 
   public:
     sf::RenderWindow &window; // the sfml window (need to draw)
-    gameboy(sf::RenderWindow &window_) : window(window_) {};
+    gameboy(sf::RenderWindow &window_);
+    // the components and the watchpoints point into the instance, it stays
+    // where it was made
+    gameboy(const gameboy &) = delete;
+    gameboy(gameboy &&) = delete;
+    gameboy &operator=(const gameboy &) = delete;
+    gameboy &operator=(gameboy &&) = delete;
 
     // dimensions
     static constexpr unsigned int WIDTH{160};
@@ -29,8 +35,73 @@ class gameboy {
 
     void tick();
 
+    // both give the same results. fast runs a cpu bound frame (BM_frame)
+    // about 1.5x as fast, not several times: the ppu still steps every dot of
+    // oam scan and drawing, only hblank and vblank lines go at once
+    enum class execution_mode {
+        accurate, // timer, cpu and ppu step together every T-cycle
+        fast // the cpu runs ahead, the timer and ppu catch up when it touches
+             // them, when IF could have changed under an interrupt it can
+             // take, and at the end of run()
+    };
+    execution_mode mode{execution_mode::accurate};
+
+    // run t_cycles in the current mode, less if a watchpoint stops it
+    void run(const uint32_t t_cycles);
+
+    // T-cycles run since power on
+    uint64_t clock{0};
+
     // skip the boot rom?
     void skip_bootrom();
 
   private:
+    // where run() stops, a watchpoint pulls it in
+    uint64_t run_end{0};
+
+    // M-cycles the cpu ran ahead of the timer and ppu, the last one has its
+    // first part (up to the cpu's work) done when pending_tail is set
+    uint32_t pending_m_cycles{0};
+    bool pending_tail{false};
+    // M-cycles past the last catch up in which IF, as far as IE goes, can't
+    // change
+    uint32_t interrupt_free{0};
+
+    // up to run_end
+    void _run_fast();
+
+    // the timer and ppu side of an M-cycle, before and after the cpu's work
+    void _m_cycle_head();
+    void _m_cycle_tail();
+
+    // catch up to the cpu's current M-cycle (up to its work), or completely
+    void _catch_up();
+    void _catch_up_all();
+
+    // at most m_cycles M-cycles of a halt or a polling loop without running
+    // the cpu, or of a copy or fill loop in bulk. returns the M-cycles run (0
+    // if the cpu isn't in any of them)
+    uint32_t _skip_ahead(const uint32_t m_cycles);
+
+    // M-cycles from here in which the timer and ppu only count, up to the
+    // M-cycle before a tima overflow and the ppu's next ly, mode or stat
+    // change. _skip_quiet() runs them at once
+    uint32_t _quiet_m_cycles() const;
+    void _skip_quiet(const uint32_t m_cycles);
+
+    // halted: step up to m_cycles M-cycles without the cpu until it wakes,
+    // jumping over the quiet ones (the rest of hblank, a vblank line, or up to
+    // the tima overflow with the lcd off). returns the M-cycles run
+    uint32_t _skip_halt(const uint32_t m_cycles);
+
+    // a steady polling loop: whole iterations while the read returns the same
+    // and no interrupt is taken, all at once over the quiet M-cycles, the cpu
+    // then catches up and continues
+    uint32_t _skip_polling_loop(const block_cache::decoded_block &loop,
+                                const uint32_t m_cycles);
+
+    // iterations of a copy or fill loop, all at once over the quiet M-cycles,
+    // otherwise one by one while no interrupt is taken
+    uint32_t _skip_bulk_loop(const block_cache::decoded_block &loop,
+                             const uint32_t iterations);
 };
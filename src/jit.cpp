@@ -0,0 +1,616 @@
+#include "jit.h"
+#include "cpu.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// host code generated for guest blocks: the cpu pointer is moved into r11 and
+// every register access is a byte (or word) operand at [r11 + offset]. only
+// volatile registers of both the windows and system v abis are used (rax, rcx,
+// rdx, r10, r11) and nothing is pushed, so blocks need no stack frame
+
+namespace {
+
+constexpr std::size_t code_buffer_size{4 * 1024 * 1024};
+
+// longest run compiled into one block, keeps the cycle count in a byte and
+// bounds how late an interrupt can be taken
+constexpr uint8_t max_block_instructions{64};
+
+// x86 register numbers
+constexpr uint8_t eax{0};
+constexpr uint8_t ecx{1};
+constexpr uint8_t edx{2};
+
+class emitter {
+  public:
+    explicit emitter(std::vector<uint8_t> &out) : out(out) {}
+
+    void byte(const uint8_t value) { this->out.push_back(value); }
+
+    void bytes(std::initializer_list<uint8_t> values) {
+        this->out.insert(this->out.end(), values);
+    }
+
+    void imm16(const uint16_t value) {
+        this->byte(value & 0xff);
+        this->byte(value >> 8);
+    }
+
+    void imm32(const uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            this->byte((value >> (i * 8)) & 0xff);
+        }
+    }
+
+    // [r11 + disp32] with reg in the modrm reg field
+    void mem(const uint8_t reg, const int32_t disp) {
+        this->byte(0x80 | (reg << 3) | 0x03);
+        this->imm32(static_cast<uint32_t>(disp));
+    }
+
+    // movzx reg, byte [r11 + disp]
+    void load8(const uint8_t reg, const int32_t disp) {
+        this->bytes({0x41, 0x0f, 0xb6});
+        this->mem(reg, disp);
+    }
+
+    // movzx reg, word [r11 + disp]
+    void load16(const uint8_t reg, const int32_t disp) {
+        this->bytes({0x41, 0x0f, 0xb7});
+        this->mem(reg, disp);
+    }
+
+    // mov byte [r11 + disp], reg8
+    void store8(const uint8_t reg, const int32_t disp) {
+        this->bytes({0x41, 0x88});
+        this->mem(reg, disp);
+    }
+
+    // mov word [r11 + disp], reg16
+    void store16(const uint8_t reg, const int32_t disp) {
+        this->bytes({0x66, 0x41, 0x89});
+        this->mem(reg, disp);
+    }
+
+    // mov byte [r11 + disp], imm8
+    void store8_imm(const int32_t disp, const uint8_t value) {
+        this->bytes({0x41, 0xc6});
+        this->mem(0, disp);
+        this->byte(value);
+    }
+
+    // mov word [r11 + disp], imm16
+    void store16_imm(const int32_t disp, const uint16_t value) {
+        this->bytes({0x66, 0x41, 0xc7});
+        this->mem(0, disp);
+        this->imm16(value);
+    }
+
+    // and / or / xor byte [r11 + disp], imm8
+    void and8_imm(const int32_t disp, const uint8_t value) {
+        this->op8_imm(4, disp, value);
+    }
+    void or8_imm(const int32_t disp, const uint8_t value) {
+        this->op8_imm(1, disp, value);
+    }
+    void xor8_imm(const int32_t disp, const uint8_t value) {
+        this->op8_imm(6, disp, value);
+    }
+
+    // test byte [r11 + disp], mask
+    void test_flag(const int32_t disp, const uint8_t mask) {
+        this->bytes({0x41, 0xf6});
+        this->mem(0, disp);
+        this->byte(mask);
+    }
+
+    // x86 carry flag = guest carry flag (bit 4 of F)
+    void load_carry(const int32_t disp) {
+        this->load8(edx, disp);
+        this->bytes({0x0f, 0xba, 0xe2, 0x04}); // bt edx, 4
+    }
+
+    // guest F from the x86 flags of the last op: z, h and c are taken from
+    // ZF, AF and CF where asked for, the bits in keep from the old F, then the
+    // bits in set are set. lahf puts ZF, AF and CF in bits 6, 4 and 0 of ah,
+    // eax keeps its low byte
+    void store_flags(const int32_t disp, const bool z, const bool h,
+                     const bool c, const uint8_t keep, const uint8_t set) {
+        this->bytes({0x9f, 0x0f, 0xb6, 0xd4}); // lahf, movzx edx, ah
+        if (z || h) {
+            // bits 6 and 4 to 7 and 5
+            this->bytes({0x89, 0xd1}); // mov ecx, edx
+            this->bytes({0x83, 0xe1, static_cast<uint8_t>((z ? 0x40 : 0) |
+                                                          (h ? 0x10 : 0))});
+            this->bytes({0xd1, 0xe1}); // shl ecx, 1
+        } else {
+            this->bytes({0x31, 0xc9}); // xor ecx, ecx
+        }
+        if (c) {
+            this->bytes({0x83, 0xe2, 0x01}); // and edx, 1
+            this->bytes({0xc1, 0xe2, 0x04}); // shl edx, 4
+            this->bytes({0x09, 0xd1});       // or ecx, edx
+        }
+        this->merge_flags(disp, keep, set);
+    }
+
+    // F = ecx | (F & keep) | set
+    void merge_flags(const int32_t disp, const uint8_t keep,
+                     const uint8_t set) {
+        if (keep) {
+            this->load8(edx, disp);
+            this->bytes({0x83, 0xe2, keep}); // and edx, keep
+            this->bytes({0x09, 0xd1});       // or ecx, edx
+        }
+        if (set) {
+            this->bytes({0x83, 0xc9, set}); // or ecx, set
+        }
+        this->store8(ecx, disp);
+    }
+
+    // mov eax, cycles; ret
+    void exit(const uint8_t cycles) {
+        this->byte(0xb8);
+        this->imm32(cycles);
+        this->byte(0xc3);
+    }
+
+    // jcc rel32 with the offset patched later, returns the patch position
+    std::size_t jcc(const uint8_t cc) {
+        this->bytes({0x0f, cc});
+        const std::size_t patch = this->out.size();
+        this->imm32(0);
+        return patch;
+    }
+
+    void patch_here(const std::size_t patch) {
+        const int32_t rel = static_cast<int32_t>(this->out.size() - (patch + 4));
+        std::memcpy(&this->out[patch], &rel, 4);
+    }
+
+  private:
+    std::vector<uint8_t> &out;
+
+    // group 1 op (/ext) byte [r11 + disp], imm8
+    void op8_imm(const uint8_t ext, const int32_t disp, const uint8_t value) {
+        this->bytes({0x41, 0x80});
+        this->mem(ext, disp);
+        this->byte(value);
+    }
+};
+
+// x86 condition codes for setcc (0x0f 0x9x) and jcc (0x0f 0x8x)
+constexpr uint8_t setc{0x92};
+constexpr uint8_t jz{0x84};
+constexpr uint8_t jnz{0x85};
+
+int32_t offset_of(const cpu &cpu, const void *member) {
+    return static_cast<int32_t>(static_cast<const uint8_t *>(member) -
+                                reinterpret_cast<const uint8_t *>(&cpu));
+}
+
+// name a compiled block in /tmp/perf-<pid>.map so perf can name guest blocks.
+// one map per process, shared by every instance's jit: opened for appending
+// when the first block is compiled, written under a lock
+void perf_map_block(const uint8_t *function, const std::size_t size,
+                    const uint16_t bank, const uint16_t pc) {
+#ifdef _WIN32
+    (void)function;
+    (void)size;
+    (void)bank;
+    (void)pc;
+#else
+    static std::mutex lock{};
+    static std::FILE *map = [] {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/tmp/perf-%d.map",
+                      static_cast<int>(getpid()));
+        return std::fopen(path, "a");
+    }();
+    if (!map) {
+        return;
+    }
+
+    const std::lock_guard<std::mutex> guard(lock);
+    std::fprintf(map, "%llx %zx riceboy_%02x_%04x\n",
+                 static_cast<unsigned long long>(
+                     reinterpret_cast<uintptr_t>(function)),
+                 size, bank, pc);
+    std::fflush(map);
+#endif
+}
+
+} // namespace
+
+bool jit::_map() {
+#ifdef _WIN32
+    this->code = static_cast<uint8_t *>(VirtualAlloc(
+        nullptr, code_buffer_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+    void *memory = mmap(nullptr, code_buffer_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    this->code =
+        memory == MAP_FAILED ? nullptr : static_cast<uint8_t *>(memory);
+#endif
+    this->code_size = this->code ? code_buffer_size : 0;
+    return this->code != nullptr;
+}
+
+bool jit::_protect(uint8_t *first, const std::size_t size,
+                   const bool writable) {
+    // whole pages around the bytes
+#ifdef _WIN32
+    SYSTEM_INFO system{};
+    GetSystemInfo(&system);
+    const uintptr_t page = system.dwPageSize;
+#else
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+#endif
+    const uintptr_t start = reinterpret_cast<uintptr_t>(first) & ~(page - 1);
+    const uintptr_t end =
+        (reinterpret_cast<uintptr_t>(first) + size + page - 1) & ~(page - 1);
+
+#ifdef _WIN32
+    DWORD previous{};
+    return VirtualProtect(reinterpret_cast<void *>(start), end - start,
+                          writable ? PAGE_READWRITE : PAGE_EXECUTE_READ,
+                          &previous) != 0;
+#else
+    return mprotect(reinterpret_cast<void *>(start), end - start,
+                    writable ? PROT_READ | PROT_WRITE
+                             : PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+jit::~jit() {
+#ifdef _WIN32
+    if (this->code) {
+        VirtualFree(this->code, 0, MEM_RELEASE);
+    }
+#else
+    if (this->code) {
+        munmap(this->code, this->code_size);
+    }
+#endif
+}
+
+void jit::flush() { this->code_used = 0; }
+
+bool jit::compile(cpu &cpu, block_cache::block &block, const uint16_t bank) {
+    assert(!block.decoded->instructions.empty() && "compiling an empty block!");
+
+    this->registers.r8[0] = offset_of(cpu, &cpu.B);
+    this->registers.r8[1] = offset_of(cpu, &cpu.C);
+    this->registers.r8[2] = offset_of(cpu, &cpu.D);
+    this->registers.r8[3] = offset_of(cpu, &cpu.E);
+    this->registers.r8[4] = offset_of(cpu, &cpu.H);
+    this->registers.r8[5] = offset_of(cpu, &cpu.L);
+    this->registers.r8[7] = offset_of(cpu, &cpu.A);
+    this->registers.rp[0] = offset_of(cpu, &cpu.BC);
+    this->registers.rp[1] = offset_of(cpu, &cpu.DE);
+    this->registers.rp[2] = offset_of(cpu, &cpu.HL);
+    this->registers.rp[3] = offset_of(cpu, &cpu.SP);
+    this->registers.F = offset_of(cpu, &cpu.F);
+    this->registers.PC = offset_of(cpu, &cpu.PC);
+
+    std::vector<uint8_t> out{};
+    emitter emit(out);
+
+    // cpu pointer (first argument) into r11
+#ifdef _WIN32
+    emit.bytes({0x49, 0x89, 0xcb}); // mov r11, rcx
+#else
+    emit.bytes({0x49, 0x89, 0xfb}); // mov r11, rdi
+#endif
+
+    const std::size_t prologue = out.size();
+    uint8_t cycles{0};
+    uint8_t length{0};
+    bool exited{false};
+
+    for (const block_cache::decoded_instruction &decoded :
+         block.decoded->instructions) {
+        if (length == max_block_instructions) {
+            break;
+        }
+
+        const std::size_t mark = out.size();
+        const uint8_t before = cycles;
+        if (!this->_compile_instruction(out, cpu, decoded, cycles)) {
+            out.resize(mark);
+            cycles = before;
+            break;
+        }
+        length++;
+
+        // branches emit their own exits
+        if (decoded.opcode == 0x18 || decoded.opcode == 0xc3 ||
+            (decoded.opcode & 0xe7) == 0x20 || (decoded.opcode & 0xe7) == 0xc2) {
+            exited = true;
+            break;
+        }
+    }
+
+    block.native_length = length;
+    if (out.size() == prologue) {
+        // nothing compilable, leave it to the interpreter
+        block.native = nullptr;
+        block.native_length = 0;
+        return true;
+    }
+
+    if (!exited) {
+        const block_cache::decoded_instruction &last =
+            block.decoded->instructions[length - 1];
+        emit.store16_imm(this->registers.PC, last.pc + last.length);
+        emit.exit(cycles);
+    }
+
+    if (!this->code && !this->_map()) {
+        // no buffer, the interpreter runs it
+        block.native = nullptr;
+        block.native_length = 0;
+        return true;
+    }
+    if (this->code_used + out.size() > this->code_size) {
+        return false;
+    }
+
+    // pages already holding blocks stop being executable while this one is
+    // written, nothing runs during compile()
+    uint8_t *function = this->code + this->code_used;
+    if (!this->_protect(function, out.size(), true)) {
+        block.native = nullptr;
+        block.native_length = 0;
+        return true;
+    }
+    std::memcpy(function, out.data(), out.size());
+    if (!this->_protect(function, out.size(), false)) {
+        block.native = nullptr;
+        block.native_length = 0;
+        return true;
+    }
+    this->code_used += out.size();
+    block.native = function;
+    block.native_m_cycles = block.decoded->m_cycles(length);
+
+    perf_map_block(function, out.size(), bank,
+                   block.decoded->instructions[0].pc);
+    return true;
+}
+
+bool jit::_compile_instruction(std::vector<uint8_t> &out, cpu &cpu,
+                               const block_cache::decoded_instruction &decoded,
+                               uint8_t &cycles) {
+    emitter emit(out);
+    const offsets &r = this->registers;
+
+    const uint8_t opcode = decoded.opcode;
+    const uint8_t x = (opcode >> 6) & 3;
+    const uint8_t y = (opcode >> 3) & 7;
+    const uint8_t z = opcode & 7;
+    const uint8_t p = y >> 1;
+    const uint8_t q = y % 2;
+
+    // immediates come from rom, the block is keyed by its bank so they must
+    // not reach into the next bank
+    if ((decoded.pc >> 14) != ((decoded.pc + decoded.length - 1) >> 14)) {
+        return false;
+    }
+    const uint8_t n = cpu.gb_mmu->read_memory(decoded.pc + 1);
+    const uint16_t nn =
+        n | (cpu.gb_mmu->read_memory(decoded.pc + 2) << 8);
+    const uint16_t next = decoded.pc + decoded.length;
+
+    // alu A, cl - sets the guest flags from the x86 ones
+    auto alu = [&](const uint8_t op) {
+        emit.load8(eax, r.r8[7]);
+        switch (op) {
+        case 0: emit.bytes({0x00, 0xc8}); break; // add al, cl
+        case 1:
+            emit.load_carry(r.F);
+            emit.bytes({0x10, 0xc8}); // adc al, cl
+            break;
+        case 2: emit.bytes({0x28, 0xc8}); break; // sub al, cl
+        case 3:
+            emit.load_carry(r.F);
+            emit.bytes({0x18, 0xc8}); // sbb al, cl
+            break;
+        case 4: emit.bytes({0x20, 0xc8}); break; // and al, cl
+        case 5: emit.bytes({0x30, 0xc8}); break; // xor al, cl
+        case 6: emit.bytes({0x08, 0xc8}); break; // or al, cl
+        case 7: emit.bytes({0x38, 0xc8}); break; // cmp al, cl
+        }
+        switch (op) {
+        case 4:
+            emit.store_flags(r.F, true, false, false, 0, cpu::flag_h);
+            break;
+        case 5:
+        case 6: emit.store_flags(r.F, true, false, false, 0, 0); break;
+        default:
+            emit.store_flags(r.F, true, true, true, 0,
+                             op == 2 || op == 3 || op == 7 ? cpu::flag_n : 0);
+            break;
+        }
+        if (op != 7) {
+            emit.store8(eax, r.r8[7]);
+        }
+    };
+
+    // conditional exit, Z/NZ/C/NC from y & 3
+    auto branch = [&](const uint8_t cc, const uint16_t target,
+                      const uint8_t taken, const uint8_t not_taken) {
+        emit.test_flag(r.F, cc < 2 ? cpu::flag_z : cpu::flag_c);
+        // NZ/NC are taken on a clear flag
+        const std::size_t patch = emit.jcc(cc % 2 == 0 ? jnz : jz);
+        emit.store16_imm(r.PC, target);
+        emit.exit(cycles + taken);
+        emit.patch_here(patch);
+        emit.store16_imm(r.PC, next);
+        emit.exit(cycles + not_taken);
+    };
+
+    switch (x) {
+    case 0:
+        switch (z) {
+        case 0:
+            if (y == 0) {
+                break; // NOP
+            }
+            if (y == 3) {
+                emit.store16_imm(r.PC, next + static_cast<int8_t>(n));
+                emit.exit(cycles + 3);
+                return true;
+            }
+            if (y >= 4) {
+                branch(y - 4, next + static_cast<int8_t>(n), 3, 2);
+                return true;
+            }
+            return false;
+
+        case 1:
+            if (q == 0) {
+                // ld rr, d16
+                emit.store16_imm(r.rp[p], nn);
+                break;
+            }
+            // add hl, rr - the half-carry is bit 12 of the 12 bit sum
+            emit.load16(eax, r.rp[2]);
+            emit.load16(ecx, r.rp[p]);
+            emit.bytes({0x89, 0xc2});                         // mov edx, eax
+            emit.bytes({0x81, 0xe2, 0xff, 0x0f, 0x00, 0x00}); // and edx, 0xfff
+            emit.bytes({0x41, 0x89, 0xca});                   // mov r10d, ecx
+            emit.bytes({0x41, 0x81, 0xe2, 0xff, 0x0f, 0x00, 0x00}); // and r10d
+            emit.bytes({0x44, 0x01, 0xd2}); // add edx, r10d
+            emit.bytes({0xc1, 0xea, 0x07}); // shr edx, 7
+            emit.bytes({0x83, 0xe2, cpu::flag_h}); // and edx, flag_h
+            emit.bytes({0x66, 0x01, 0xc8}); // add ax, cx
+            emit.bytes({0x0f, setc, 0xc1}); // setc cl
+            emit.bytes({0x0f, 0xb6, 0xc9}); // movzx ecx, cl
+            emit.bytes({0xc1, 0xe1, 0x04}); // shl ecx, 4
+            emit.bytes({0x09, 0xd1});       // or ecx, edx
+            emit.merge_flags(r.F, cpu::flag_z, 0);
+            emit.store16(eax, r.rp[2]);
+            break;
+
+        case 3:
+            // inc rr, dec rr (no flags)
+            emit.bytes({0x66, 0x41, 0xff});
+            emit.mem(q, r.rp[p]); // inc / dec word [rr]
+            break;
+
+        case 4:
+        case 5:
+            // inc r8, dec r8 (carry unchanged)
+            if (y == 6) {
+                return false;
+            }
+            emit.load8(eax, r.r8[y]);
+            emit.bytes({0xfe, static_cast<uint8_t>(z == 4 ? 0xc0 : 0xc8)});
+            emit.store_flags(r.F, true, true, false, cpu::flag_c,
+                             z == 5 ? cpu::flag_n : 0);
+            emit.store8(eax, r.r8[y]);
+            break;
+
+        case 6:
+            // ld r8, d8
+            if (y == 6) {
+                return false;
+            }
+            emit.store8_imm(r.r8[y], n);
+            break;
+
+        case 7:
+            switch (y) {
+            case 0:
+            case 1:
+            case 2:
+            case 3:
+                // rlca, rrca, rla, rra
+                emit.load8(eax, r.r8[7]);
+                if (y >= 2) {
+                    emit.load_carry(r.F);
+                }
+                emit.bytes({0xd0, static_cast<uint8_t>(
+                                      y == 0   ? 0xc0   // rol al, 1
+                                      : y == 1 ? 0xc8   // ror al, 1
+                                      : y == 2 ? 0xd0   // rcl al, 1
+                                               : 0xd8)}); // rcr al, 1
+                emit.store_flags(r.F, false, false, true, 0, 0);
+                emit.store8(eax, r.r8[7]);
+                break;
+            case 5:
+                // cpl
+                emit.load8(eax, r.r8[7]);
+                emit.bytes({0xf6, 0xd0}); // not al
+                emit.store8(eax, r.r8[7]);
+                emit.or8_imm(r.F, cpu::flag_n | cpu::flag_h);
+                break;
+            case 6:
+                // scf
+                emit.and8_imm(r.F, cpu::flag_z);
+                emit.or8_imm(r.F, cpu::flag_c);
+                break;
+            case 7:
+                // ccf
+                emit.and8_imm(r.F, cpu::flag_z | cpu::flag_c);
+                emit.xor8_imm(r.F, cpu::flag_c);
+                break;
+            default: return false; // daa
+            }
+            break;
+
+        default: return false;
+        }
+        break;
+
+    case 1:
+        // ld r8, r8
+        if (y == 6 || z == 6) {
+            return false;
+        }
+        emit.load8(eax, r.r8[z]);
+        emit.store8(eax, r.r8[y]);
+        break;
+
+    case 2:
+        // alu A, r8
+        if (z == 6) {
+            return false;
+        }
+        emit.load8(ecx, r.r8[z]);
+        alu(y);
+        break;
+
+    case 3:
+        if (z == 6) {
+            // alu A, d8
+            emit.byte(0xb9);
+            emit.imm32(n); // mov ecx, n
+            alu(y);
+            break;
+        }
+        if (opcode == 0xc3) {
+            emit.store16_imm(r.PC, nn);
+            emit.exit(cycles + 4);
+            return true;
+        }
+        if (z == 2 && y < 4) {
+            branch(y, nn, 4, 3);
+            return true;
+        }
+        return false;
+    }
+
+    cycles += decoded.m_cycles;
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "block_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class cpu; // forward declaration for cpu class
+
+// x86-64 dynamic recompiler (RICEBOY_JIT builds only). translates the register
+// only prefix of hot rom blocks into host code. anything touching memory or
+// i/o is left to the interpreter so bus accesses keep their M-cycle timing,
+// the timer and ppu catch up to the cpu at block boundaries
+class jit {
+  public:
+    // host code for a block, runs the instructions and sets PC, returns the
+    // M-cycles they took
+    using block_function = uint8_t (*)(cpu *);
+
+    jit() = default;
+    ~jit();
+    jit(const jit &) = delete;
+    jit &operator=(const jit &) = delete;
+
+    // compile the block at pc in bank, sets block.native and
+    // block.native_length. returns false if the code buffer is full (flush and
+    // retry), a block without a compilable prefix gets native_length 0
+    bool compile(cpu &cpu, block_cache::block &block, const uint16_t bank);
+
+    // drop all host code, blocks pointing into it must drop it too
+    // (block_cache::drop_native())
+    void flush();
+
+    // blocks entered this many times get compiled
+    static constexpr uint16_t hot_runs{8};
+
+  private:
+    // register offsets into the cpu object
+    struct offsets {
+        int32_t r8[8]{}; // B, C, D, E, H, L, (hl) unused, A
+        int32_t rp[4]{}; // BC, DE, HL, SP
+        int32_t F{0};
+        int32_t PC{0};
+    };
+    offsets registers{};
+
+    // code buffer, mapped by the first compile so a cpu that never gets a
+    // hot block doesn't hold one. pages are read/execute and only made
+    // writable (not executable) while a block is copied in
+    uint8_t *code{nullptr};
+    std::size_t code_size{0};
+    std::size_t code_used{0};
+
+    bool _map();
+    // bytes from first on: read/write if writable, read/execute otherwise
+    bool _protect(uint8_t *first, const std::size_t size, const bool writable);
+
+    bool _compile_instruction(std::vector<uint8_t> &out, cpu &cpu,
+                              const block_cache::decoded_instruction &decoded,
+                              uint8_t &cycles);
+};
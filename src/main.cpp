@@ -3,8 +3,9 @@
 #include "handleinput.h"
 #include "tinyfiledialogs.h"
 #include <SFML/Graphics.hpp>
+#include <string>
 
-int main() {
+int main(int argc, char *argv[]) {
     // TODO: gb
 
     // open file dialog to load ROM
@@ -99,6 +100,14 @@ int main() {
     // at load rom complete
     riceboy->skip_bootrom();
 
+    // --fast: run the cpu ahead of the timer and ppu (games that don't rely on
+    // sub-instruction timing)
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--fast") {
+            riceboy->mode = gameboy::execution_mode::fast;
+        }
+    }
+
     // frame clock (avoiding setFrameRateLimit imprecision)
     sf::Clock frame_clock{};
     double accumulator{0};
@@ -139,14 +148,17 @@ int main() {
 
         // 70224 ipf - clock speed 4194304Hz
         while (accumulator >= target_frame_time) {
-            for (unsigned int i = 0; i < 70224; ++i) {
-                riceboy->tick();
-            }
+            riceboy->run(70224);
             accumulator -= target_frame_time;
         }
 
         // 70224
     }
 
+#ifdef RICEBOY_PROFILER
+    // <rom>.folded and <rom>.opcodes.txt
+    riceboy->gb_cpu.profile->dump(riceboy->gb_cpu.rom);
+#endif
+
     return 0;
 }
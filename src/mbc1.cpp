@@ -4,55 +4,68 @@
 
 // TODO: implement MBCM1 (multicart)
 
-uint16_t mbc1::read_memory(uint16_t address) {
+mbc1::mbc1(shared_rom::image rom) : rom(std::move(rom)) {}
+
+uint16_t mbc1::rom_bank(uint16_t address) const {
     if (address <= 0x3fff) {
         // mode 0 - only access to normal address range
         // mode 1 - can access banks 1, 20, 40, 60 (stored in *0x4000) depending
         // on size of rom
-        if (!this->banking_mode) {
-            return this->rom[address];
-        } else {
-            uint8_t zero_bank_number{0};
-
-            if (this->rom_size < 0x05) {
-                // less than 1 MiB
-                // offset = 0
-            } else if (this->rom_size == 0x05) {
-                zero_bank_number = ((this->ram_bank_number & 1) << 5);
-            } else if (this->rom_size > 0x05) {
-                // rom size > 0x05
-                zero_bank_number = ((this->ram_bank_number) << 5);
-            }
-            return this->rom[0x4000 * zero_bank_number + address];
+        if (!this->banking_mode || this->rom_size < 0x05) {
+            // less than 1 MiB, offset = 0
+            return 0;
+        } else if (this->rom_size == 0x05) {
+            return ((this->ram_bank_number & 1) << 5);
         }
+        // rom size > 0x05
+        return ((this->ram_bank_number) << 5);
     }
 
     // Switchable ROM Bank - $4000 - $7FFF
-    else if (address >= 0x4000 && address <= 0x7fff) {
+    if (this->rom_size < 0x05) { // less than 1MiB
+        return this->rom_bank_number;
 
-        uint16_t high_bank_number{0};
-
-        if (this->rom_size < 0x05) { // less than 1MiB
-            high_bank_number = this->rom_bank_number;
-
-        } else if (this->rom_size == 0x05) { // = 1MiB
-            high_bank_number =
-                this->rom_bank_number + ((this->ram_bank_number & 1) << 5);
-            // lowest bit of ram bank number should take bit 5
-            // place of the rom bank number (use | instead?)
-        } else if (this->rom_size > 0x05) { // > 1MiB
-            high_bank_number =
-                this->rom_bank_number +
-                (this->ram_bank_number
-                 << 5); // both bits of ram bank number takes bit 5 and 6
-                        // of the rom bank number (use | instead?)
-        }
+    } else if (this->rom_size == 0x05) { // = 1MiB
+        return this->rom_bank_number + ((this->ram_bank_number & 1) << 5);
+        // lowest bit of ram bank number should take bit 5
+        // place of the rom bank number (use | instead?)
+    }
+    // > 1MiB
+    return this->rom_bank_number +
+           (this->ram_bank_number
+            << 5); // both bits of ram bank number takes bit 5 and 6
+                   // of the rom bank number (use | instead?)
+}
+
+const uint8_t *mbc1::rom_page(uint16_t address) const {
+    // same mapping as read_memory, the switchable bank wraps
+    if (this->rom->empty()) {
+        return nullptr;
+    }
+    uint32_t final_address = address & 0xff00;
+    if (address <= 0x3fff) {
+        final_address += 0x4000 * this->rom_bank(address);
+    } else {
+        final_address += 0x4000 * this->rom_bank(address) - 0x4000;
+        final_address %= this->rom->size();
+    }
+    if (final_address + 0x100 > this->rom->size()) {
+        return nullptr;
+    }
+    return &(*this->rom)[final_address];
+}
 
-        // std::cout << final_address << '\n';
+uint16_t mbc1::read_memory(uint16_t address) {
+    if (address <= 0x3fff) {
+        return (*this->rom)[0x4000 * this->rom_bank(address) + address];
+    }
 
-        uint32_t final_address = 0x4000 * high_bank_number + (address - 0x4000);
-        final_address %= this->rom.size(); // wrap # of banks
-        uint8_t result = this->rom.at(final_address);
+    // Switchable ROM Bank - $4000 - $7FFF
+    else if (address >= 0x4000 && address <= 0x7fff) {
+        uint32_t final_address =
+            0x4000 * this->rom_bank(address) + (address - 0x4000);
+        final_address %= this->rom->size(); // wrap # of banks
+        uint8_t result = this->rom->at(final_address);
         return result;
 
     }
@@ -91,7 +104,7 @@ uint16_t mbc1::read_memory(uint16_t address) {
 void mbc1::write_memory(uint16_t address, uint8_t value) {
 
     if (!this->load_rom_complete) {
-        this->rom.push_back(value);
+        return; // the rom came with the constructor
     }
 
     else {
@@ -182,8 +195,8 @@ void mbc1::set_load_rom_complete() {
     this->load_rom_complete = true;
 
     // set rom size
-    this->rom_size = this->rom.at(0x148);
-    this->ram_size = this->rom.at(0x149);
+    this->rom_size = this->rom->at(0x148);
+    this->ram_size = this->rom->at(0x149);
 
     switch (ram_size) {
     case 1: this->ram.resize(2048); break;
@@ -1,5 +1,6 @@
 #include "mmu.h"
 #include "ppu.h"
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <iostream>
@@ -17,6 +18,203 @@ mmu::mmu(timer &timer, interrupt &interrupt, ppu &ppu, joypad &joypad) {
     this->gb_interrupt = &interrupt;
     this->gb_ppu = &ppu;
     this->gb_joypad = &joypad;
+    this->_map_io();
+    this->_map_pages();
+    this->gb_ppu->oam_dma_catch_up = [this] { this->_flush_oam_dma(); };
+}
+
+void mmu::map_io(const uint16_t address, const io_read read,
+                 const io_write write, const uint8_t unused) {
+    assert(address >= 0xff00 && address <= 0xff7f && "not an i/o register!");
+    io_register &io = this->io_registers[address - 0xff00];
+    io.read = read;
+    io.write = write;
+    io.unused = unused;
+    if (io.read == nullptr) {
+        io.read = [](const mmu &gb_mmu, const uint16_t address) -> uint8_t {
+            return gb_mmu.hardware_registers[address - 0xff00];
+        };
+    }
+    if (io.write == nullptr) {
+        io.write = [](mmu &gb_mmu, const uint16_t address,
+                      const uint8_t value) {
+            gb_mmu.hardware_registers[address - 0xff00] = value;
+        };
+    }
+}
+
+void mmu::_map_io() {
+    // plain bytes until claimed (serial, apu, wave ram), the unused ones read
+    // 0xff
+    for (uint16_t address = 0xff00; address <= 0xff7f; ++address) {
+        const bool unused = address == 0xff03 ||
+                            (address >= 0xff08 && address <= 0xff0e) ||
+                            address == 0xff15 || address == 0xff1f ||
+                            (address >= 0xff27 && address <= 0xff2f) ||
+                            (address >= 0xff4d && address != 0xff50);
+        this->map_io(address, nullptr, nullptr, unused ? 0xff : 0);
+    }
+
+    // joypad
+    this->map_io(
+        0xff00,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_joypad->ff00_joyp;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_joypad->handle_write(value);
+        });
+
+    // timer
+    this->map_io(
+        0xff04,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return (gb_mmu.gb_timer->sysclock & 0xff00) >> 8;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t) {
+            gb_mmu.handle_div_write();
+        });
+    this->map_io(
+        0xff05,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_timer->tima_ff05;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.handle_tima_write(value);
+        });
+    this->map_io(
+        0xff06,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_timer->tma_ff06;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.handle_tma_write(value);
+        });
+    this->map_io(
+        0xff07,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_timer->tac_ff07;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.handle_tac_write(value);
+        });
+
+    // interrupt flags, the top 3 bits are unused
+    this->map_io(
+        0xff0f,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_interrupt->interrupt_flags;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_interrupt->interrupt_flags = value;
+        },
+        0xe0);
+
+    // ppu
+    this->map_io(
+        0xff40,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->lcdc_ff40;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.handle_lcdc_write(value);
+        });
+    this->map_io(
+        0xff41,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->stat_ff41;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.handle_stat_write(value);
+        });
+    this->map_io(
+        0xff42,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->scy_ff42;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->scy_ff42 = value;
+        });
+    this->map_io(
+        0xff43,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->scx_ff43;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->scx_ff43 = value;
+        });
+    this->map_io(
+        0xff44,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->ly_ff44;
+        },
+        [](mmu &, const uint16_t, const uint8_t) {
+            // ly not writeable
+        });
+    this->map_io(
+        0xff45,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->lyc_ff45;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->lyc_ff45 = value;
+        });
+    this->map_io(
+        0xff47,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->bgp_ff47;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->bgp_ff47 = value;
+        });
+    this->map_io(
+        0xff48,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->obp0_ff48;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->obp0_ff48 = value;
+        });
+    this->map_io(
+        0xff49,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->obp1_ff49;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->obp1_ff49 = value;
+        });
+    this->map_io(
+        0xff4a,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->wy_ff4a;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->wy_ff4a = value;
+        });
+    this->map_io(
+        0xff4b,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->wx_ff4b;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.gb_ppu->wx_ff4b = value;
+        });
+
+    // oam dma
+    this->map_io(
+        0xff46,
+        [](const mmu &gb_mmu, const uint16_t) -> uint8_t {
+            return gb_mmu.gb_ppu->dma_ff46;
+        },
+        [](mmu &gb_mmu, const uint16_t, const uint8_t value) {
+            gb_mmu.handle_dma_write(value);
+        });
+
+    // boot rom disable, sticks once written
+    this->map_io(0xff50, nullptr,
+                 [](mmu &gb_mmu, const uint16_t, const uint8_t) {
+                     gb_mmu.hardware_registers[0x50] = 0xff;
+                 });
 }
 
 void mmu::initialize_skip_bootrom_values() {
@@ -142,12 +340,10 @@ void mmu::handle_dma_write(uint8_t value) {
         this->dma_source_transfer_address =
             value >= 0xe0 ? (value - 0x20) << 8 : value << 8;
 
-        this->dma_bus_source = (locate_section(dma_source_transfer_address) ==
-                                    section::character_ram ||
-                                locate_section(dma_source_transfer_address) ==
-                                    section::bg_map_data_1 ||
-                                locate_section(dma_source_transfer_address) ==
-                                    section::bg_map_data_2)
+        const section source = locate_section(dma_source_transfer_address);
+        this->dma_bus_source = (source == section::character_ram ||
+                                source == section::bg_map_data_1 ||
+                                source == section::bg_map_data_2)
                                    ? bus::vram
                                    : bus::main;
         this->gb_ppu->dma_delay = true;
@@ -159,27 +355,85 @@ void mmu::set_oam_dma() {
     // this->dma_write = false; // reset dma write, all writes are ignored at
     // this point anyway
     this->gb_ppu->dma_mode = true;
+    this->dma_copied = 0;
+    this->dma_due = 0;
+    this->code_map_version++;
+    this->_lock_dma_pages();
+    this->_map_oam();
+}
+
+void mmu::_lock_dma_pages() {
+    // oam is always held, and the bus the source is on. while bytes wait for
+    // the bulk copy every page is, the first access the cpu makes outside
+    // ff00 - ffff copies them
+    if (this->dma_copied != this->dma_due) {
+        this->locked_pages = page_main_bus | page_vram | page_oam | page_echo;
+        return;
+    }
+    this->locked_pages =
+        page_oam | (this->dma_bus_source == bus::vram ? page_vram
+                                                       : page_main_bus);
 }
 
 void mmu::dma_transfer() {
     assert(this->gb_ppu->dma_mode && "not in dma mode now!");
-    uint16_t dest_address = 0xfe00 | (dma_source_transfer_address & 0x00ff);
-    this->write_memory(dest_address,
-                       this->read_memory(dma_source_transfer_address));
+    // the byte is due now, it's written to oam later together with the ones
+    // before it (the cpu running from hram copies all 160 at the end)
+    this->dma_due = (dma_source_transfer_address & 0xff) + 1;
 
     if ((dma_source_transfer_address & 0xff) == 0x9f) {
+        this->_flush_oam_dma();
         this->gb_ppu->dma_mode = false;
+        this->locked_pages = 0;
+        this->_map_oam();
     }
 
     else {
         dma_source_transfer_address++;
+        this->_lock_dma_pages();
     }
 
     assert(((dma_source_transfer_address & 0x00ff) <= 0x9f) &&
            "dma transfer passed oam memory!");
 }
 
+void mmu::_flush_oam_dma() {
+    if (this->dma_copied == this->dma_due) {
+        return;
+    }
+    const uint16_t source = this->dma_source_transfer_address & 0xff00;
+    const memory_page &page = this->pages[source >> 8];
+    if (page.read != nullptr) {
+        std::copy(page.read + this->dma_copied, page.read + this->dma_due,
+                  &this->gb_ppu->oam_ram[this->dma_copied]);
+    } else {
+        for (unsigned int i = this->dma_copied; i < this->dma_due; ++i) {
+            this->gb_ppu->oam_ram[i] = this->read_memory(source + i);
+        }
+    }
+    this->dma_copied = this->dma_due;
+    if (this->gb_ppu->dma_mode) {
+        this->_lock_dma_pages();
+    }
+}
+
+void mmu::_map_oam() {
+    // during oam dma oam goes through the handlers, they see the bytes still
+    // waiting for the bulk copy
+    if (this->flat_memory) {
+        return;
+    }
+    memory_page &oam = this->pages[0xfe];
+    oam.write = this->load_rom_complete && !this->gb_ppu->dma_mode
+                    ? this->gb_ppu->oam_ram
+                    : nullptr;
+    oam.read = oam.write;
+}
+
 void mmu::set_load_rom_complete() {
+    if (!this->rom) {
+        this->rom = shared_rom::load(nullptr, 0); // no cartridge, all 0xff
+    }
 
     if (IS_MBC1) {
         assert(this->cartridge.get() != nullptr &&
@@ -187,6 +441,189 @@ void mmu::set_load_rom_complete() {
         this->cartridge->set_load_rom_complete();
     }
     this->load_rom_complete = true;
+    this->code_map_version++;
+    this->_map_pages();
+}
+
+uint16_t mmu::rom_bank(const uint16_t address) const {
+    if (IS_MBC1) {
+        return this->cartridge->rom_bank(address);
+    }
+    return address >> 14; // rom only, bank 0 and bank 1
+}
+
+mmu::code_span mmu::code_span_at(const uint16_t address) const {
+    if (this->flat_memory) {
+        const memory_page &page = this->pages[address >> 8];
+        if (page.read == nullptr) {
+            return {};
+        }
+        return code_span{page.read, static_cast<uint16_t>(address & 0xff00),
+                         0x100};
+    }
+
+    // the rom is only in place once it's loaded
+    if (!this->load_rom_complete) {
+        return {};
+    }
+
+    if (address >= 0xff80 && address <= 0xfffe) {
+        return code_span{this->zero_page, 0xff80, 0xfffe - 0xff80 + 1};
+    }
+
+    // rom and wram pages mapped straight to host memory, unless oam dma from
+    // the main bus answers their reads itself
+    const uint8_t index = address >> 8;
+    const memory_page &page = this->pages[index];
+    if ((index >= 0x80 && index <= 0xbf) || index >= 0xe0 ||
+        page.read == nullptr || (page.flags & this->locked_pages)) {
+        return {};
+    }
+    return code_span{page.read, static_cast<uint16_t>(address & 0xff00),
+                     0x100};
+}
+
+void mmu::map_flat(const uint16_t first, const std::size_t size,
+                   const uint8_t *read, uint8_t *write) {
+    assert((first & 0xff) == 0 && (size & 0xff) == 0 &&
+           first + size <= 0x10000 && "flat memory must be whole pages!");
+    if (!this->flat_memory) {
+        this->pages.fill(memory_page{});
+        for (unsigned int index = 0x00; index <= 0xff; ++index) {
+            this->pages[index].flags = this->watched_pages[index];
+        }
+        this->locked_pages = 0;
+        this->flat_memory = true;
+    }
+    for (std::size_t offset = 0; offset < size; offset += 0x100) {
+        memory_page &page = this->pages[(first + offset) >> 8];
+        page.read = read + offset;
+        page.write = write != nullptr ? write + offset : nullptr;
+        page.limit = 0x100;
+        page.flags = write != nullptr ? page_code : page_read_only;
+        page.flags |= this->watched_pages[(first + offset) >> 8];
+        page.code_page = static_cast<uint8_t>((first + offset) >> 8);
+    }
+    this->code_map_version++;
+}
+
+void mmu::_map_pages() {
+    if (this->flat_memory) {
+        return;
+    }
+    this->pages.fill(memory_page{});
+
+    // the bus each page is on, mapped or not, oam dma locks them. echo ram
+    // is only held until the bulk copy is done
+    for (unsigned int index = 0x00; index <= 0xdf; ++index) {
+        this->pages[index].flags =
+            index >= 0x80 && index <= 0x9f ? page_vram : page_main_bus;
+    }
+    for (unsigned int index = 0xe0; index <= 0xfd; ++index) {
+        this->pages[index].flags = page_echo;
+    }
+    memory_page &oam = this->pages[0xfe];
+    oam.limit = 0xfe9f - 0xfe00 + 1;
+    oam.flags = page_oam;
+
+    // hram, from the boot rom on. i/o and ie are per address in the handlers
+    memory_page &high = this->pages[0xff];
+    high.write = this->zero_page;
+    high.read = high.write;
+    high.first = 0x80;
+    high.limit = 0xfffe - 0xff80 + 1;
+    high.flags = page_code;
+    high.code_page = 0xff;
+
+    for (unsigned int index = 0x00; index <= 0xff; ++index) {
+        this->pages[index].flags |= this->watched_pages[index];
+    }
+
+    // the boot rom and the rom being loaded go through the handlers
+    if (!this->load_rom_complete) {
+        return;
+    }
+
+    this->_map_rom();
+
+    for (unsigned int index = 0x80; index <= 0x9f; ++index) {
+        memory_page &page = this->pages[index];
+        const uint16_t address = static_cast<uint16_t>(index << 8);
+        if (address <= 0x97ff) {
+            page.write = &this->gb_ppu->character_ram[address - 0x8000];
+        } else if (address <= 0x9bff) {
+            page.write = &this->gb_ppu->bg_map_data_1[address - 0x9800];
+        } else {
+            page.write = &this->gb_ppu->bg_map_data_2[address - 0x9c00];
+        }
+        page.read = page.write;
+    }
+
+    // an mbc decides what cartridge ram reads and writes do
+    if (!IS_MBC1) {
+        for (unsigned int index = 0xa0; index <= 0xbf; ++index) {
+            memory_page &page = this->pages[index];
+            page.write = &this->cartridge_ram[(index - 0xa0) << 8];
+            page.read = page.write;
+        }
+    }
+
+    // wram, then echo ram mirroring it up to fdff
+    for (unsigned int index = 0xc0; index <= 0xfd; ++index) {
+        memory_page &page = this->pages[index];
+        const unsigned int wram_index = index <= 0xdf ? index : index - 0x20;
+        page.write = &this->internal_ram[(wram_index - 0xc0) << 8];
+        page.read = page.write;
+        page.flags |= page_code;
+        page.code_page = static_cast<uint8_t>(wram_index);
+    }
+
+    this->_map_oam();
+}
+
+void mmu::_map_rom() {
+    if (!this->load_rom_complete || this->flat_memory) {
+        return;
+    }
+
+    // bank 0 at 0000, the switchable bank at 4000. read only, writes are mbc
+    // registers
+    for (const uint16_t first : {0x0000, 0x4000}) {
+        const uint8_t *bank{nullptr};
+        if (!IS_MBC1) {
+            bank = &(*this->rom)[first];
+        } else {
+            // banks are contiguous in the rom unless it ends early
+            const uint8_t *start = this->cartridge->rom_page(first);
+            const uint8_t *end = this->cartridge->rom_page(first + 0x3f00);
+            if (start != nullptr && end == start + 0x3f00) {
+                bank = start;
+            }
+        }
+        for (unsigned int i = 0; i < 0x40; ++i) {
+            memory_page &page = this->pages[(first >> 8) + i];
+            page.read = bank != nullptr
+                            ? bank + (i << 8)
+                            : this->cartridge->rom_page(first + (i << 8));
+            page.flags = page_main_bus | this->watched_pages[(first >> 8) + i];
+        }
+    }
+}
+
+bool mmu::_page_open(const memory_page &page, const bool write) const {
+    if (page.flags & this->locked_pages) {
+        return false;
+    }
+    // the fast core catches the ppu up before vram and oam are touched
+    if (page.flags & page_vram) {
+        return !this->catch_up && !(write ? this->gb_ppu->vram_write_block
+                                          : this->gb_ppu->vram_read_block);
+    }
+    if (page.flags & page_oam) {
+        return !this->catch_up && !(write ? this->gb_ppu->oam_write_block
+                                          : this->gb_ppu->oam_read_block);
+    }
+    return true;
 }
 
 void mmu::set_cartridge_type(uint8_t type) {
@@ -194,45 +631,70 @@ void mmu::set_cartridge_type(uint8_t type) {
     this->_cartridge_type = static_cast<mmu::cartridge_type>(type);
 
     if (IS_MBC1) {
-        this->cartridge = std::make_unique<mbc1>();
+        this->cartridge = std::make_unique<mbc1>(this->rom);
     }
+    this->code_map_version++;
+    this->_map_pages();
 }
 
+void mmu::load_cartridge(const char *bytes, const std::size_t size) {
+    this->rom = shared_rom::load(bytes, size);
+    // cartridge type defined in 147
+    this->set_cartridge_type((*this->rom)[0x0147]);
+}
+
+namespace {
+
+// the section each 256-byte page is in, for the pages that are all one
+constexpr std::array<mmu::section, 0x100> page_sections = [] {
+    std::array<mmu::section, 0x100> sections{};
+    for (unsigned int index = 0; index < sections.size(); ++index) {
+        const unsigned int address = index << 8;
+        if (address <= 0x00ff) {
+            sections[index] = mmu::section::restart_and_interrupt_vectors;
+        } else if (address <= 0x3fff) {
+            sections[index] = mmu::section::cartridge_rom_bank_0;
+        } else if (address <= 0x7fff) {
+            sections[index] = mmu::section::cartridge_rom_switchable_banks;
+        } else if (address <= 0x97ff) {
+            sections[index] = mmu::section::character_ram;
+        } else if (address <= 0x9bff) {
+            sections[index] = mmu::section::bg_map_data_1;
+        } else if (address <= 0x9fff) {
+            sections[index] = mmu::section::bg_map_data_2;
+        } else if (address <= 0xbfff) {
+            sections[index] = mmu::section::cartridge_ram;
+        } else if (address <= 0xcfff) {
+            sections[index] = mmu::section::internal_ram_bank_0;
+        } else if (address <= 0xdfff) {
+            sections[index] = mmu::section::internal_ram_bank_1_to_7;
+        } else {
+            sections[index] = mmu::section::echo_ram;
+        }
+    }
+    return sections;
+}();
+
+} // namespace
+
 mmu::section mmu::locate_section(const uint16_t address) {
-    if (address <= 0x00ff) {
-        return mmu::section::restart_and_interrupt_vectors;
-    } else if (address >= 0x0100 && address <= 0x014f) {
-        return mmu::section::cartridge_header_area;
-    } else if (address >= 0x0150 && address <= 0x3fff) {
-        return mmu::section::cartridge_rom_bank_0;
-    } else if (address >= 0x4000 && address <= 0x7fff) {
-        return mmu::section::cartridge_rom_switchable_banks;
-    } else if (address >= 0x8000 && address <= 0x97ff) {
-        return mmu::section::character_ram;
-    } else if (address >= 0x9800 && address <= 0x9bff) {
-        return mmu::section::bg_map_data_1;
-    } else if (address >= 0x9c00 && address <= 0x9fff) {
-        return mmu::section::bg_map_data_2;
-    } else if (address >= 0xa000 && address <= 0xbfff) {
-        return mmu::section::cartridge_ram;
-    } else if (address >= 0xc000 && address <= 0xcfff) {
-        return mmu::section::internal_ram_bank_0;
-    } else if (address >= 0xd000 && address <= 0xdfff) {
-        return mmu::section::internal_ram_bank_1_to_7;
-    } else if (address >= 0xe000 && address <= 0xfdff) {
-        return mmu::section::echo_ram;
-    } else if (address >= 0xfe00 && address <= 0xfe9f) {
-        return mmu::section::oam_ram;
-    } else if (address >= 0xfea0 && address <= 0xfeff) {
-        return mmu::section::unusuable_memory;
-    } else if (address >= 0xff00 && address <= 0xff7f) {
-        return mmu::section::hardware_registers;
-    } else if (address >= 0xff80 && address <= 0xfffe) {
-        return mmu::section::zero_page;
-    } else if (address == 0xffff) {
-        return mmu::section::interrupt_enable_flag;
-    }
-    return mmu::section::unknown;
+    // only the header's page, oam's and the i/o page are split
+    const uint8_t low = address & 0xff;
+    switch (address >> 8) {
+    case 0x01:
+        return low <= 0x4f ? mmu::section::cartridge_header_area
+                           : mmu::section::cartridge_rom_bank_0;
+    case 0xfe:
+        return low <= 0x9f ? mmu::section::oam_ram
+                           : mmu::section::unusuable_memory;
+    case 0xff:
+        if (low <= 0x7f) {
+            return mmu::section::hardware_registers;
+        }
+        return low <= 0xfe ? mmu::section::zero_page
+                           : mmu::section::interrupt_enable_flag;
+    default: return page_sections[address >> 8];
+    }
 }
 
 void mmu::oam_bug_read(uint16_t address) {
@@ -304,46 +766,98 @@ void mmu::oam_bug_read_inc(uint16_t address) {
     }
 }
 
-uint8_t mmu::bus_read_memory(uint16_t address) {
-    if (this->gb_ppu->dma_mode) {
+bool mmu::shared_with_timer_or_ppu(const uint16_t address) {
+    // vram, oam (and the unusable area behind it), i/o registers and ie
+    return (address >= 0x8000 && address <= 0x9fff) ||
+           (address >= 0xfe00 && address <= 0xff7f) || address == 0xffff;
+}
 
-        if (locate_section(address) == section::oam_ram) {
-            // oam is locked
-            return read_memory(dma_source_transfer_address);
-        }
+void mmu::add_watchpoint(const watchpoints::watchpoint &watch) {
+    assert(watch.first <= watch.last && watch.access != 0 &&
+           "empty watchpoint!");
+    this->watches.list.push_back(watch);
+    this->_flag_watched_pages();
+}
 
-        else if (dma_bus_source == bus::vram) {
-            // vram is locked if the dma source is in vram
-            if (locate_section(address) == section::character_ram ||
-                locate_section(address) == section::bg_map_data_1 ||
-                locate_section(address) == section::bg_map_data_2) {
-                return read_memory(dma_source_transfer_address);
+void mmu::clear_watchpoints() {
+    this->watches.list.clear();
+    this->_flag_watched_pages();
+}
+
+void mmu::_flag_watched_pages() {
+    std::array<uint8_t, 0x100> flags{};
+    for (const watchpoints::watchpoint &watch : this->watches.list) {
+        for (unsigned int index = watch.first >> 8; index <= watch.last >> 8;
+             ++index) {
+            if (watch.access & (watchpoints::read | watchpoints::write)) {
+                flags[index] |= page_watched;
+            }
+            if (watch.access & watchpoints::execute) {
+                flags[index] |= page_watch_run;
             }
         }
+    }
 
-        else if (dma_bus_source == bus::main) {
-            // rom: 0 - 7fff (restart, cartridge_roms)
-            // wram - c000 - dfff (internal ram banks)
-            // sram - caertridge ram
-            if (locate_section(address) ==
-                    section::restart_and_interrupt_vectors ||
-                locate_section(address) == section::cartridge_header_area ||
-                locate_section(address) == section::cartridge_rom_bank_0 ||
-                locate_section(address) ==
-                    section::cartridge_rom_switchable_banks ||
-                locate_section(address) == section::internal_ram_bank_0 ||
-                locate_section(address) == section::internal_ram_bank_1_to_7 ||
-                locate_section(address) == section::cartridge_ram) {
-                return read_memory(dma_source_transfer_address);
-            }
+    for (unsigned int index = 0x00; index <= 0xff; ++index) {
+        // blocks on pages that start or stop being watched decode again
+        if ((flags[index] ^ this->watched_pages[index]) & page_watch_run) {
+            this->page_versions[index]++;
         }
+        this->watched_pages[index] = flags[index];
+        memory_page &page = this->pages[index];
+        page.flags = (page.flags & ~(page_watched | page_watch_run)) |
+                     flags[index];
+    }
+}
+
+void mmu::_watch(const uint16_t address, const uint8_t value,
+                 const uint8_t access) {
+    const uint16_t bank = address <= 0x7fff ? this->rom_bank(address) : 0;
+    this->watches.check(address, bank, value, access);
+}
+
+uint8_t mmu::_bus_read_handler(uint16_t address) {
+    const uint8_t value = this->_bus_read(address);
+    if (this->pages[address >> 8].flags & page_watched) {
+        this->_watch(address, value, watchpoints::read);
+    }
+    return value;
+}
+
+void mmu::_bus_write_handler(uint16_t address, uint8_t value) {
+    this->_bus_write(address, value);
+    if (this->pages[address >> 8].flags & page_watched) {
+        this->_watch(address, value, watchpoints::write);
+    }
+}
+
+uint8_t mmu::_bus_read(uint16_t address) {
+    // oam dma's bulk copy can't wait past the cpu touching anything but i/o
+    // and hram
+    if (this->dma_copied != this->dma_due && address < 0xff00) {
+        this->_flush_oam_dma();
+    }
+
+    // vram and oam pages, when the ppu, the fast core and oam dma allow it
+    const memory_page &page = this->pages[address >> 8];
+    const unsigned int offset = (address & 0xff) - page.first;
+    const bool in_page = offset < page.limit;
+    if (page.read != nullptr && in_page && this->_page_open(page, false)) {
+        return page.read[offset];
+    }
+
+    if (this->catch_up && shared_with_timer_or_ppu(address)) {
+        this->catch_up();
+    }
+
+    // oam dma holds oam and the bus it copies from (rom, cartridge ram and
+    // wram, or vram), they read the byte being copied
+    if ((page.flags & this->locked_pages) && in_page) {
+        return read_memory(dma_source_transfer_address);
     }
 
     // lock vram if ppu is in mode 3, check ppu mode
-    if (load_rom_complete &&
-        (locate_section(address) == section::character_ram ||
-         locate_section(address) == section::bg_map_data_1 ||
-         locate_section(address) == section::bg_map_data_2) &&
+    if (load_rom_complete && (page.flags & page_vram) &&
         this->gb_ppu->vram_read_block) {
         return 0xff;
     }
@@ -352,8 +866,7 @@ uint8_t mmu::bus_read_memory(uint16_t address) {
     // seems tricky
     // uint8_t stat_mode = hardware_registers[0x41] & 2;
 
-    if (locate_section(address) == section::oam_ram &&
-        (this->gb_ppu->oam_read_block)) {
+    if ((page.flags & page_oam) && in_page && this->gb_ppu->oam_read_block) {
 
         return 0xff; // bug returns 0xff i think?
     }
@@ -379,54 +892,29 @@ uint8_t mmu::bus_read_memory(uint16_t address) {
 }
 
 // TODO: make more elegant by segregating each address space
-uint8_t mmu::read_memory(uint16_t address) const {
+uint8_t mmu::_read_handler(uint16_t address) const {
+    // page ff: hram is mapped, i/o and ie are looked up per address
+    if (address >= 0xff00 && address <= 0xff7f) {
+        const io_register &io = this->io_registers[address - 0xff00];
+        return io.read(*this, address) | io.unused;
+    }
+    if (address == 0xffff) {
+        // the top 3 bits are unused
+        return this->gb_interrupt->interrupt_enable_flag & 0x1f;
+    }
+
     uint16_t base_address = static_cast<uint16_t>(locate_section(address));
 
     if (IS_MBC1) {
         assert(this->cartridge.get() != nullptr &&
                "Cartridge is NULL! Can't read!");
 
-        switch (address) {
-        // joypad
-        case 0xff00: return this->gb_joypad->ff00_joyp;
-
-        // timer registers
-        case 0xff04: return (this->gb_timer->sysclock & 0x0ff00) >> 8;
-        case 0xff05: return this->gb_timer->tima_ff05;
-        case 0xff06: return this->gb_timer->tma_ff06;
-        case 0xff07: return this->gb_timer->tac_ff07;
-
-        // interrupt
-        case 0xff0f:
-            return this->gb_interrupt->interrupt_flags |
-                   0xe0; // mask top 3 bits for IF to 1 (unused)
-        case 0xffff:
-            return this->gb_interrupt->interrupt_enable_flag &
-                   0x1f; // mask top 3 bits for IE to 0 (unused)
-
-        // ppu
-        case 0xff40: return this->gb_ppu->lcdc_ff40;
-        case 0xff41: return this->gb_ppu->stat_ff41;
-        case 0xff42: return this->gb_ppu->scy_ff42;
-        case 0xff43: return this->gb_ppu->scx_ff43;
-        case 0xff44: return this->gb_ppu->ly_ff44;
-        case 0xff45: return this->gb_ppu->lyc_ff45;
-        case 0xff46: return this->gb_ppu->dma_ff46;
-        case 0xff47: return this->gb_ppu->bgp_ff47;
-        case 0xff48: return this->gb_ppu->obp0_ff48;
-        case 0xff49: return this->gb_ppu->obp1_ff49;
-        case 0xff4a: return this->gb_ppu->wy_ff4a;
-        case 0xff4b: return this->gb_ppu->wx_ff4b;
-
-        default    : {
-            // Attempt to read from cartridge
-            uint16_t result = this->cartridge->read_memory(address);
-
-            // Make sure result fits in 8 bits
-            if (result <= 0xff) {
-                return result;
-            }
-        }
+        // Attempt to read from cartridge
+        uint16_t result = this->cartridge->read_memory(address);
+
+        // Make sure result fits in 8 bits
+        if (result <= 0xff) {
+            return result;
         }
     }
 
@@ -435,16 +923,14 @@ uint8_t mmu::read_memory(uint16_t address) const {
 
     switch (locate_section(address)) {
     case mmu::section::restart_and_interrupt_vectors:
-        return this->restart_and_interrupt_vectors[address - base_address];
-
     case mmu::section::cartridge_header_area:
-        return this->cartridge_header_area[address - base_address];
-
     case mmu::section::cartridge_rom_bank_0:
-        return this->cartridge_rom_bank_0[address - base_address];
-
     case mmu::section::cartridge_rom_switchable_banks:
-        return this->cartridge_rom_switchable_banks[address - base_address];
+        if (!this->load_rom_complete) {
+            return address < sizeof(this->boot_area) ? this->boot_area[address]
+                                                     : 0;
+        }
+        return (*this->rom)[address];
 
     case mmu::section::character_ram:
         return this->gb_ppu->character_ram[address - base_address];
@@ -459,70 +945,25 @@ uint8_t mmu::read_memory(uint16_t address) const {
         return this->cartridge_ram[address - base_address];
 
     case mmu::section::internal_ram_bank_0:
-        return this->internal_ram_bank_0[address - base_address];
-
     case mmu::section::internal_ram_bank_1_to_7:
-        return this->internal_ram_bank_1_to_7[address - base_address];
+        return this->internal_ram[address - 0xc000];
 
-    case mmu::section::echo_ram: return this->echo_ram[address - base_address];
+    case mmu::section::echo_ram: return this->internal_ram[address - 0xe000];
 
     case mmu::section::oam_ram:
+        // bytes oam dma has copied that are still waiting for the bulk copy
+        if (address - base_address >= this->dma_copied &&
+            address - base_address < this->dma_due) {
+            return read_memory((this->dma_source_transfer_address & 0xff00) +
+                               (address - base_address));
+        }
         return this->gb_ppu->oam_ram[address - base_address];
 
     case mmu::section::unusuable_memory: return 0; // DMG returns 0x00;
 
-    case mmu::section::hardware_registers:
-        switch (address) {
-        // joypad
-        case 0xff00: return this->gb_joypad->ff00_joyp;
-
-        // timer
-        case 0xff04: return (this->gb_timer->sysclock & 0xff00) >> 8;
-        case 0xff05: return this->gb_timer->tima_ff05;
-        case 0xff06: return this->gb_timer->tma_ff06;
-        case 0xff07: return this->gb_timer->tac_ff07;
-
-        // interrupt
-        case 0xff0f: return this->gb_interrupt->interrupt_flags | 0xe0;
-
-        // ppu
-        case 0xff40: return this->gb_ppu->lcdc_ff40;
-        case 0xff41: return this->gb_ppu->stat_ff41;
-        case 0xff42: return this->gb_ppu->scy_ff42;
-        case 0xff43: return this->gb_ppu->scx_ff43;
-        case 0xff44: return this->gb_ppu->ly_ff44;
-        case 0xff45: return this->gb_ppu->lyc_ff45;
-        case 0xff46: return this->gb_ppu->dma_ff46;
-        case 0xff47: return this->gb_ppu->bgp_ff47;
-        case 0xff48: return this->gb_ppu->obp0_ff48;
-        case 0xff49: return this->gb_ppu->obp1_ff49;
-        case 0xff4a: return this->gb_ppu->wy_ff4a;
-        case 0xff4b: return this->gb_ppu->wx_ff4b;
-
-        // unused
-        case 0xff03:
-        case 0xff15:
-        case 0xff1f:
-        case 0xff4d:
-        case 0xff4e:
-        case 0xff4f: return 0xff;
-
-        default:
-            // Check ranges for other unused registers
-            if ((address > 0xff07 && address < 0xff0f) ||
-                (address > 0xff26 && address < 0xff30) || (address >= 0xff51)) {
-                return 0xff;
-            }
-            return this->hardware_registers[address - base_address];
-        }
-
     case mmu::section::zero_page:
         return this->zero_page[address - base_address];
 
-    case mmu::section::interrupt_enable_flag:
-        return this->gb_interrupt->interrupt_enable_flag & 0x1f;
-        // mask top 3 bits with 1s for IE (they are unused)
-
     default:
         std::cout << "(read) memory not implemented: "
                   << "hex: 0x" << std::hex << static_cast<unsigned int>(address)
@@ -561,50 +1002,44 @@ void mmu::oam_bug_write(uint16_t address) {
            &this->gb_ppu->oam_ram[this->gb_ppu->current_oam_row - 6], 6);
 }
 
-void mmu::bus_write_memory(uint16_t address, uint8_t value) {
-    // TODO: stopping LCD operation (LCDC bit 7 1->0) happens in vblank only,
-    // otherwise crash
-    if (this->gb_ppu->dma_mode) {
-        if (locate_section(address) == section::oam_ram) {
-            // oam is locked
-            write_memory(dma_source_transfer_address, value);
-            return;
-        }
+void mmu::_bus_write(uint16_t address, uint8_t value) {
+    // oam dma's bulk copy can't wait past the cpu touching anything but i/o
+    // and hram
+    if (this->dma_copied != this->dma_due && address < 0xff00) {
+        this->_flush_oam_dma();
+    }
 
-        else if (dma_bus_source == bus::vram) {
-            // vram is locked if the dma source is in vram
-            if (locate_section(address) == section::character_ram ||
-                locate_section(address) == section::bg_map_data_1 ||
-                locate_section(address) == section::bg_map_data_2) {
-                write_memory(dma_source_transfer_address, value);
-                return;
-            }
+    // vram and oam pages, when the ppu, the fast core and oam dma allow it
+    const memory_page &page = this->pages[address >> 8];
+    if (page.flags & page_read_only) {
+        return;
+    }
+    const unsigned int offset = (address & 0xff) - page.first;
+    const bool in_page = offset < page.limit;
+    if (page.write != nullptr && in_page && this->_page_open(page, true)) {
+        page.write[offset] = value;
+        if (page.flags & page_code) {
+            this->page_versions[page.code_page]++;
         }
+        return;
+    }
 
-        else if (dma_bus_source == bus::main) {
-            // rom: 0 - 7fff (restart, cartridge_roms)
-            // wram - c000 - dfff (internal ram banks)
-            // sram - caertridge ram
-            if (locate_section(address) ==
-                    section::restart_and_interrupt_vectors ||
-                locate_section(address) == section::cartridge_header_area ||
-                locate_section(address) == section::cartridge_rom_bank_0 ||
-                locate_section(address) ==
-                    section::cartridge_rom_switchable_banks ||
-                locate_section(address) == section::internal_ram_bank_0 ||
-                locate_section(address) == section::internal_ram_bank_1_to_7 ||
-                locate_section(address) == section::cartridge_ram) {
-                write_memory(dma_source_transfer_address, value);
-                return;
-            }
-        }
+    if (this->catch_up && shared_with_timer_or_ppu(address)) {
+        this->catch_up();
+    }
+
+    // TODO: stopping LCD operation (LCDC bit 7 1->0) happens in vblank only,
+    // otherwise crash
+
+    // oam dma holds oam and the bus it copies from (rom, cartridge ram and
+    // wram, or vram), they write the byte being copied
+    if ((page.flags & this->locked_pages) && in_page) {
+        write_memory(dma_source_transfer_address, value);
+        return;
     }
 
     // lock vram if ppu is in mode 3, check ppu mode
-    if (load_rom_complete &&
-        (locate_section(address) == section::character_ram ||
-         locate_section(address) == section::bg_map_data_1 ||
-         locate_section(address) == section::bg_map_data_2) &&
+    if (load_rom_complete && (page.flags & page_vram) &&
         this->gb_ppu->vram_write_block) {
         return;
     }
@@ -622,7 +1057,7 @@ void mmu::bus_write_memory(uint16_t address, uint8_t value) {
         return; // block oam access during mode 2 and 3
     }*/
 
-    else if (locate_section(address) == section::oam_ram && load_rom_complete &&
+    else if ((page.flags & page_oam) && in_page && load_rom_complete &&
              this->gb_ppu->oam_write_block) {
         return;
         // return; // block oam access during mode 2 and 3
@@ -633,7 +1068,10 @@ void mmu::bus_write_memory(uint16_t address, uint8_t value) {
     }
 }
 
-void mmu::write_memory(uint16_t address, uint8_t value) {
+void mmu::_write_handler(uint16_t address, uint8_t value) {
+    if (this->pages[address >> 8].flags & page_read_only) {
+        return;
+    }
 
     if (!this->load_rom_complete && (IS_MBC1)) { // TODO: not rom_only
 
@@ -644,135 +1082,38 @@ void mmu::write_memory(uint16_t address, uint8_t value) {
         return;
     }
 
-    else if (IS_MBC1) {
+    if (address >= 0xff00 && address <= 0xff7f) {
+        this->io_registers[address - 0xff00].write(*this, address, value);
+        return;
+    }
+    if (address == 0xffff) {
+        this->gb_interrupt->interrupt_enable_flag = value;
+        return;
+    }
+
+    if (IS_MBC1) {
         assert(this->cartridge.get() != nullptr &&
                "Cartridge is NULL! Can't write!");
 
-        if (address == 0xff00) {
-            this->gb_joypad->handle_write(value);
-        }
-
-        if (address == 0xff04) {
-            handle_div_write();
-            return;
-        }
-
-        if (address == 0xff05) {
-            handle_tima_write(value);
-            return;
-        }
-
-        if (address == 0xff06) {
-            handle_tma_write(value);
-            return;
-        }
-
-        if (address == 0xff07) {
-            handle_tac_write(value);
-            return;
-        }
-
-        // lcdc
-        if (address == 0xff40) {
-            handle_lcdc_write(value);
-            return;
-        }
-
-        // stat (mask top bit)
-        if (address == 0xff41) {
-            handle_stat_write(value);
-            return;
-        }
-
-        if (address == 0xff42) {
-            this->gb_ppu->scy_ff42 = value;
-            return;
-        }
-
-        if (address == 0xff43) {
-            this->gb_ppu->scx_ff43 = value;
-            return;
-        }
-
-        if (address == 0xff44) {
-            // ly not writeable
-            return;
-        }
-
-        if (address == 0xff45) {
-            this->gb_ppu->lyc_ff45 = value;
-            return;
-        }
-
-        // dma
-        if (address == 0xff46) {
-            handle_dma_write(value);
-            return;
-        }
-
-        if (address == 0xff47) {
-            this->gb_ppu->bgp_ff47 = value;
-            return;
-        }
-
-        if (address == 0xff48) {
-            this->gb_ppu->obp0_ff48 = value;
-            return;
-        }
-
-        if (address == 0xff49) {
-            this->gb_ppu->obp1_ff49 = value;
-            return;
-        }
-
-        if (address == 0xff4a) {
-            this->gb_ppu->wy_ff4a = value;
-            return;
-        }
-
-        if (address == 0xff4b) {
-            this->gb_ppu->wx_ff4b = value;
-            return;
-        }
-
-        if (address == 0xff0f) {
-            this->gb_interrupt->interrupt_flags = value;
-            return;
-        }
+        this->cartridge->write_memory(address, value);
 
-        if (address == 0xff50) {
-            hardware_registers[0x50] = 0xff;
-            return;
+        // mbc register writes can switch the banks mapped into rom
+        if (address <= 0x7fff) {
+            this->bank_switches++;
+            this->code_map_version++;
+            this->_map_rom();
         }
-
-        this->cartridge->write_memory(address, value);
     }
 
     uint16_t base_address = static_cast<uint16_t>(locate_section(address));
 
     switch (locate_section(address)) {
     case mmu::section::restart_and_interrupt_vectors:
-        if (!this->load_rom_complete) {
-            this->restart_and_interrupt_vectors[address] = value;
-        }
-        break;
-
     case mmu::section::cartridge_header_area:
-        if (!this->load_rom_complete) {
-            this->cartridge_header_area[address - base_address] = value;
-        }
-        break;
-
     case mmu::section::cartridge_rom_bank_0:
-        if (!this->load_rom_complete) {
-            this->cartridge_rom_bank_0[address - base_address] = value;
-        }
-        break;
-
     case mmu::section::cartridge_rom_switchable_banks:
-        if (!this->load_rom_complete) {
-            this->cartridge_rom_switchable_banks[address - base_address] =
-                value;
+        if (!this->load_rom_complete && address < sizeof(this->boot_area)) {
+            this->boot_area[address] = value;
         }
         break;
 
@@ -793,17 +1134,14 @@ void mmu::write_memory(uint16_t address, uint8_t value) {
         break;
 
     case mmu::section::internal_ram_bank_0:
-        this->internal_ram_bank_0[address - base_address] = value;
-        break;
-
     case mmu::section::internal_ram_bank_1_to_7:
-        this->internal_ram_bank_1_to_7[address - base_address] = value;
+        this->internal_ram[address - 0xc000] = value;
+        this->page_versions[address >> 8]++;
         break;
 
     case mmu::section::echo_ram:
-        if (!load_rom_complete) {
-            this->echo_ram[address - base_address] = value;
-        }
+        this->internal_ram[address - 0xe000] = value;
+        this->page_versions[(address - 0x2000) >> 8]++;
         break;
 
     case mmu::section::unusuable_memory:
@@ -813,101 +1151,13 @@ void mmu::write_memory(uint16_t address, uint8_t value) {
         break;
 
     case mmu::section::oam_ram:
+        this->_flush_oam_dma();
         this->gb_ppu->oam_ram[address - base_address] = value;
         break;
 
-    case mmu::section::hardware_registers:
-        if (address == 0xff00) {
-            this->gb_joypad->handle_write(value);
-        }
-
-        else if (address == 0xff04) {
-            handle_div_write();
-        }
-
-        else if (address == 0xff05) { // tima_ff05
-            handle_tima_write(value);
-        }
-
-        else if (address == 0xff06) {
-            handle_tma_write(value);
-        }
-
-        else if (address == 0xff07) {
-            handle_tac_write(value);
-        }
-
-        // lcdc
-        else if (address == 0xff40) {
-            handle_lcdc_write(value);
-        }
-
-        // stat (mask top bit)
-        else if (address == 0xff41) {
-            handle_stat_write(value);
-        }
-
-        else if (address == 0xff42) {
-            this->gb_ppu->scy_ff42 = value;
-        }
-
-        else if (address == 0xff43) {
-            this->gb_ppu->scx_ff43 = value;
-        }
-
-        else if (address == 0xff44) {
-            // ly not writeable
-        }
-
-        else if (address == 0xff45) {
-            this->gb_ppu->lyc_ff45 = value;
-        }
-
-        // dma
-        else if (address == 0xff46) {
-            handle_dma_write(value);
-        }
-
-        else if (address == 0xff47) {
-            this->gb_ppu->bgp_ff47 = value;
-        }
-
-        else if (address == 0xff48) {
-            this->gb_ppu->obp0_ff48 = value;
-        }
-
-        else if (address == 0xff49) {
-            this->gb_ppu->obp1_ff49 = value;
-        }
-
-        else if (address == 0xff4a) {
-            this->gb_ppu->wy_ff4a = value;
-        }
-
-        else if (address == 0xff4b) {
-            this->gb_ppu->wx_ff4b = value;
-        }
-
-        else if (address == 0xff50) {
-            hardware_registers[0x50] = 0xff;
-        }
-
-        else if (address == 0xff0f) {
-            this->gb_interrupt->interrupt_flags = value;
-        }
-
-        else {
-            this->hardware_registers[address - base_address] = value;
-            std::cout << "";
-        }
-        break;
-
     case mmu::section::zero_page:
         this->zero_page[address - base_address] = value;
-        break;
-
-    case mmu::section::interrupt_enable_flag:
-        this->gb_interrupt->interrupt_enable_flag = value;
+        this->page_versions[address >> 8]++;
         break;
 
     default:
@@ -5,7 +5,11 @@
 #include "timer.h"
 #include "interrupt.h"
 #include "joypad.h"
+#include "watchpoints.h"
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 // TODO: restrict access to ROM, VRAM, and OAM
@@ -21,12 +25,90 @@ class mmu {
     ppu *gb_ppu{};
     joypad *gb_joypad{};
 
-    virtual uint8_t read_memory(uint16_t address) const;
-    virtual uint8_t bus_read_memory(
-        uint16_t address); // corruption bug could modify memory (not const)
-
-    virtual void write_memory(uint16_t address, uint8_t value);
-    virtual void bus_write_memory(uint16_t address, uint8_t value);
+    // pages mapped to host memory are read and written inline, the bus ones
+    // only when nothing can lock them (vram, oam, oam dma) and no watchpoint
+    // covers them. everything else goes through the handlers
+    uint8_t read_memory(uint16_t address) const {
+        const memory_page &page = this->pages[address >> 8];
+        const unsigned int offset = (address & 0xff) - page.first;
+        if (page.read != nullptr && offset < page.limit) {
+            return page.read[offset];
+        }
+        return this->_read_handler(address);
+    }
+    uint8_t bus_read_memory(
+        uint16_t address) { // corruption bug could modify memory (not const)
+        const memory_page &page = this->pages[address >> 8];
+        const unsigned int offset = (address & 0xff) - page.first;
+        if (page.read != nullptr && offset < page.limit &&
+            !(page.flags &
+              (page_vram | page_oam | page_watched | this->locked_pages))) {
+            return page.read[offset];
+        }
+        return this->_bus_read_handler(address);
+    }
+
+    void write_memory(uint16_t address, uint8_t value) {
+        const memory_page &page = this->pages[address >> 8];
+        const unsigned int offset = (address & 0xff) - page.first;
+        if (page.write != nullptr && offset < page.limit) {
+            page.write[offset] = value;
+            if (page.flags & page_code) {
+                this->page_versions[page.code_page]++;
+            }
+            return;
+        }
+        this->_write_handler(address, value);
+    }
+    void bus_write_memory(uint16_t address, uint8_t value) {
+        const memory_page &page = this->pages[address >> 8];
+        const unsigned int offset = (address & 0xff) - page.first;
+        if (page.write != nullptr && offset < page.limit &&
+            !(page.flags &
+              (page_vram | page_oam | page_watched | this->locked_pages))) {
+            page.write[offset] = value;
+            if (page.flags & page_code) {
+                this->page_versions[page.code_page]++;
+            }
+            return;
+        }
+        this->_bus_write_handler(address, value);
+    }
+
+    // maps size bytes from first (both multiples of 0x100) straight to host
+    // memory, with no i/o, banking or locks, for running the cpu alone (the
+    // sst tests, the benchmarks, batch lanes). pages without write memory
+    // drop writes, pages never mapped keep their handlers
+    void map_flat(const uint16_t first, const std::size_t size,
+                  const uint8_t *read, uint8_t *write);
+
+    // an i/o register's handlers (ff00 - ff7f), every access is one call
+    // through the register's entry
+    using io_read = uint8_t (*)(const mmu &gb_mmu, const uint16_t address);
+    using io_write = void (*)(mmu &gb_mmu, const uint16_t address,
+                              const uint8_t value);
+    // claim an i/o register (the apu and serial port would hook in here).
+    // unused are the bits that always read 1, a nullptr handler keeps the
+    // register as a plain byte
+    void map_io(const uint16_t address, const io_read read,
+                const io_write write, const uint8_t unused = 0);
+
+    // debugger watchpoints on the cpu's bus reads and writes and on the
+    // instructions it runs. only the pages they cover leave the fast paths
+    void add_watchpoint(const watchpoints::watchpoint &watch);
+    void clear_watchpoints();
+    bool watching() const { return !this->watches.list.empty(); }
+    // the list, the hits and how they are recorded
+    watchpoints watches{};
+
+    // watched code is never decoded into blocks, the cpu checks every
+    // instruction it fetches there
+    bool watching_code(const uint16_t address) const {
+        return this->pages[address >> 8].flags & page_watch_run;
+    }
+    void watch_execute(const uint16_t address, const uint8_t opcode) {
+        this->_watch(address, opcode, watchpoints::execute);
+    }
 
     enum class section : uint16_t {
         restart_and_interrupt_vectors = 0,       // 0x00ff
@@ -93,6 +175,9 @@ class mmu {
 
     void set_load_rom_complete();
     void set_cartridge_type(uint8_t type);
+    // the rom file, kept in shared_rom with the other instances running it
+    void load_cartridge(const char *bytes, const std::size_t size);
+    const shared_rom::image &rom_image() const { return this->rom; }
 
     void handle_tima_overflow();
     void handle_div_write();
@@ -127,6 +212,37 @@ class mmu {
     // initialize mmu values if skip boot rom
     void initialize_skip_bootrom_values();
 
+    // rom bank mapped at a rom address (0x0000 - 0x7fff)
+    uint16_t rom_bank(const uint16_t address) const;
+
+    // bumped on every write to a wram/hram page, decoded code compares it to
+    // notice it was overwritten
+    std::array<uint32_t, 0x100> page_versions{};
+
+    // bumped on every mbc register write (possible bank switch)
+    uint32_t bank_switches{0};
+
+    // host memory the cpu can fetch code from without going through the bus.
+    // data[0] is the byte at first, size bytes follow
+    struct code_span {
+        const uint8_t *data{nullptr};
+        uint16_t first{0};
+        uint16_t size{0};
+    };
+    // the rom, wram or hram bytes around address, within its 256-byte page,
+    // if bus reads there would just read them. empty for anything else (i/o,
+    // vram, oam, cartridge ram) and for rom and wram while oam dma holds the
+    // main bus. any mapped page of flat memory
+    code_span code_span_at(const uint16_t address) const;
+    // bumped whenever a code span can stop matching the bus (bank switch, oam
+    // dma start, rom load)
+    uint32_t code_map_version{0};
+
+    // set by the fast core while the cpu runs ahead of the timer and ppu,
+    // called before the cpu touches their registers, vram or oam
+    std::function<void()> catch_up{};
+    static bool shared_with_timer_or_ppu(const uint16_t address);
+
   private:
     // zero page - ff80 - fffe, High RAM (127 bytes)
     uint8_t zero_page[(0xfffe - 0xff80) + 1]{};
@@ -139,31 +255,94 @@ class mmu {
     // ununsable memory - 0xfea0 - 0xfeff
     uint8_t unusable_memory[(0xfeff - 0xfea0) + 1]{};
 
-    // echo ram - reserved, do not use 0xe000 - 0xfdff
-    uint8_t echo_ram[(0xfdff - 0xe000) + 1]{};
-
-    // internal ram bank 1 - 7 (switchable CGB only) - 0xd000 - 0xdfff
-    uint8_t internal_ram_bank_1_to_7[(0xdfff - 0xd000) + 1]{};
-
-    // internal ram bank 0 - 0xc000 - 0xcfff
-    uint8_t internal_ram_bank_0[(0xcfff - 0xc000) + 1]{};
+    // internal ram - 0xc000 - 0xdfff (bank 0, then bank 1 - 7 switchable CGB
+    // only), echo ram (0xe000 - 0xfdff) mirrors it
+    uint8_t internal_ram[(0xdfff - 0xc000) + 1]{};
 
     // cartridge ram - 0xa000 - 0xbfff
     uint8_t cartridge_ram[(0xbfff - 0xa000) + 1]{}; // e-ram
 
-    // cartridge rom - switchable banks 1-xx - 0x4000 - 0x7FFF
-    uint8_t cartridge_rom_switchable_banks[(0x7fff - 0x4000) + 1]{};
-
-    // cartridge rom - bank 0 (fixed) - 0x0150 - 0x3FFF
-    uint8_t cartridge_rom_bank_0[(0x3fff - 0x0150) + 1]{};
-
-    // cartridge header area - 0x0100 - 0x014F
-    uint8_t cartridge_header_area[(0x014f - 0x0100) + 1]{};
+    // the boot rom (0x0000 - 0x00ff) and the cartridge header it checks
+    // (0x0100 - 0x014f) until the rom is loaded
+    uint8_t boot_area[0x014f + 1]{};
 
-    // restart and interrupt vectors - 0x0000 - 0x00FF
-    uint8_t restart_and_interrupt_vectors[0x00ff + 1]{};
+    // the rom file, shared between instances. without an mbc 0x0000 - 0x7fff
+    // (restart and interrupt vectors, header, bank 0 and bank 1)
+    shared_rom::image rom{};
 
     std::unique_ptr<cartridge> cartridge{};
 
     bool load_rom_complete{false};
+
+    // what the bus needs to check before touching a page directly
+    static constexpr uint8_t page_main_bus{1};   // oam dma from rom/wram
+    static constexpr uint8_t page_vram{2};       // vram blocks, dma from vram
+    static constexpr uint8_t page_oam{4};        // oam blocks and any oam dma
+    static constexpr uint8_t page_code{8};       // writes bump a page version
+    static constexpr uint8_t page_read_only{16}; // flat memory, drop writes
+    static constexpr uint8_t page_watched{32};   // read or write watchpoints
+    static constexpr uint8_t page_watch_run{64}; // execute watchpoints
+    static constexpr uint8_t page_echo{128};     // held by a pending dma copy
+
+    // a 256-byte page of the address space. read and write are the host
+    // bytes behind it, nullptr where read_memory/write_memory's handlers
+    // decide (i/o, mbc registers and cartridge ram behind an mbc, the unusable
+    // area, anything before the rom is loaded). only the limit bytes from
+    // first are direct (oam ends at fe9f, hram starts at ff80), read and
+    // write are the host bytes of first
+    struct memory_page {
+        const uint8_t *read{nullptr};
+        uint8_t *write{nullptr};
+        uint16_t limit{0x100};
+        uint8_t first{0};
+        uint8_t flags{0};
+        uint8_t code_page{0}; // page_versions entry writes bump
+    };
+    std::array<memory_page, 0x100> pages{};
+    // page_main_bus, page_vram and page_oam while oam dma holds them
+    uint8_t locked_pages{0};
+    // oam dma has written oam up to dma_copied, the bytes up to dma_due are
+    // copied later in one go
+    uint8_t dma_copied{0};
+    uint8_t dma_due{0};
+    // page_watched and page_watch_run of each page, the page table keeps
+    // them through every remap
+    std::array<uint8_t, 0x100> watched_pages{};
+    // map_flat() was called, the page table is left alone
+    bool flat_memory{false};
+
+    // ff00 - ff7f, indexed by address - 0xff00
+    struct io_register {
+        io_read read{nullptr};
+        io_write write{nullptr};
+        uint8_t unused{0};
+    };
+    std::array<io_register, 0x80> io_registers{};
+    // the joypad's, timer's, interrupt's, ppu's and oam dma's registers
+    void _map_io();
+
+    // the accesses pages can't answer directly
+    uint8_t _read_handler(uint16_t address) const;
+    uint8_t _bus_read_handler(uint16_t address);
+    void _write_handler(uint16_t address, uint8_t value);
+    void _bus_write_handler(uint16_t address, uint8_t value);
+    // the bus accesses without the watchpoints
+    uint8_t _bus_read(uint16_t address);
+    void _bus_write(uint16_t address, uint8_t value);
+    // an access to a watched page
+    void _watch(const uint16_t address, const uint8_t value,
+                const uint8_t access);
+    // flag the pages the watchpoints cover
+    void _flag_watched_pages();
+
+    // rebuild the page table, on rom load, bank switches and oam dma
+    void _map_pages();
+    void _map_rom();
+    void _lock_dma_pages();
+    // oam while oam dma runs goes through the handlers
+    void _map_oam();
+    // write the bytes oam dma has copied so far to oam
+    void _flush_oam_dma();
+    // whether the bus can touch the page directly right now
+    bool _page_open(const memory_page &page, const bool write) const;
 };
@@ -1,7 +1,613 @@
 #include "cpu.h"
 #include <array>
+#include <type_traits>
+#include <utility>
 
-int cpu::handle_opcode(const uint8_t opcode) {
+// what the instructions do, and the table decoding them. handlers taking
+// operands are templates on the opcode's fields, the decoder instantiates one
+// per opcode
+
+uint8_t cpu::_add8(const uint8_t x, const uint8_t y, const uint8_t carry) {
+    this->_lazy_flags(flag_op::add, x, y, carry);
+    return x + y + carry;
+}
+
+uint8_t cpu::_sub8(const uint8_t x, const uint8_t y, const uint8_t carry) {
+    this->_lazy_flags(flag_op::sub, x, y, carry);
+    return x - y - carry;
+}
+
+uint8_t cpu::_inc8(const uint8_t x) {
+    this->_lazy_flags(flag_op::inc, x, 0, this->_carry());
+    return x + 1;
+}
+
+uint8_t cpu::_dec8(const uint8_t x) {
+    this->_lazy_flags(flag_op::dec, x, 0, this->_carry());
+    return x - 1;
+}
+
+void cpu::_add_hl(const uint16_t value) {
+    this->sync_flags();
+    const uint32_t sum = this->HL + value;
+    this->F = (this->F & flag_z) |
+              _flags(false, false, (this->HL & 0xfff) + (value & 0xfff) > 0xfff,
+                     sum > 0xffff);
+    this->HL = sum & 0xffff;
+}
+
+uint16_t cpu::_add_sp_s8(const uint8_t offset) {
+    // flags come from the unsigned add of the low byte
+    this->lazy_op = flag_op::none;
+    this->F = _flags(false, false, (this->SP & 0xf) + (offset & 0xf) > 0xf,
+                     (this->SP & 0xff) + offset > 0xff);
+    return this->SP + static_cast<int8_t>(offset);
+}
+
+template <cpu::alu_op op> void cpu::_alu(const uint8_t value) {
+    if constexpr (op == alu_op::add) {
+        this->A = this->_add8(this->A, value);
+    } else if constexpr (op == alu_op::adc) {
+        this->A = this->_add8(this->A, value, this->_carry());
+    } else if constexpr (op == alu_op::sub) {
+        this->A = this->_sub8(this->A, value);
+    } else if constexpr (op == alu_op::sbc) {
+        this->A = this->_sub8(this->A, value, this->_carry());
+    } else if constexpr (op == alu_op::logic_and) {
+        this->A &= value;
+        this->_lazy_flags(flag_op::logic_and, this->A, 0, 0);
+    } else if constexpr (op == alu_op::logic_xor) {
+        this->A ^= value;
+        this->_lazy_flags(flag_op::zc, this->A, 0, 0);
+    } else if constexpr (op == alu_op::logic_or) {
+        this->A |= value;
+        this->_lazy_flags(flag_op::zc, this->A, 0, 0);
+    } else {
+        this->_sub8(this->A, value); // compare, no effect on A
+    }
+}
+
+void cpu::sync_flags() {
+    const uint8_t x = this->lazy_x;
+    const uint8_t y = this->lazy_y;
+    const uint8_t c = this->lazy_c;
+    switch (this->lazy_op) {
+    case flag_op::none: return;
+    case flag_op::add:
+        this->F = _flags(static_cast<uint8_t>(x + y + c) == 0, false,
+                         (x & 0xf) + (y & 0xf) + c > 0xf, // 4 bit sum fits?
+                         x + y + c > 0xff);
+        break;
+    case flag_op::sub:
+        this->F = _flags(static_cast<uint8_t>(x - y - c) == 0, true,
+                         (x & 0xf) < (y & 0xf) + c, x - y - c < 0);
+        break;
+    case flag_op::inc:
+        this->F = _flags(static_cast<uint8_t>(x + 1) == 0, false,
+                         (x & 0xf) == 0xf, c);
+        break;
+    case flag_op::dec:
+        this->F = _flags(x == 1, true, (x & 0xf) == 0, c);
+        break;
+    case flag_op::logic_and:
+        this->F = _flags(x == 0, false, true, false);
+        break;
+    case flag_op::zc: this->F = _flags(x == 0, false, false, c); break;
+    case flag_op::c: this->F = _flags(false, false, false, c); break;
+    }
+    this->lazy_op = flag_op::none;
+}
+
+bool cpu::_zero() const {
+    const uint8_t x = this->lazy_x;
+    switch (this->lazy_op) {
+    case flag_op::add:
+        return static_cast<uint8_t>(x + this->lazy_y + this->lazy_c) == 0;
+    case flag_op::sub:
+        return static_cast<uint8_t>(x - this->lazy_y - this->lazy_c) == 0;
+    case flag_op::inc: return x == 0xff;
+    case flag_op::dec: return x == 1;
+    case flag_op::logic_and:
+    case flag_op::zc: return x == 0;
+    case flag_op::c: return false;
+    default: return this->F & flag_z;
+    }
+}
+
+uint8_t cpu::_carry() const {
+    const uint8_t x = this->lazy_x;
+    switch (this->lazy_op) {
+    case flag_op::add: return x + this->lazy_y + this->lazy_c > 0xff;
+    case flag_op::sub: return x - this->lazy_y - this->lazy_c < 0;
+    case flag_op::logic_and: return 0;
+    case flag_op::inc:
+    case flag_op::dec:
+    case flag_op::zc:
+    case flag_op::c: return this->lazy_c;
+    default: return (this->F >> 4) & 1;
+    }
+}
+
+template <cpu::conditions cc> bool cpu::_condition() const {
+    if constexpr (cc == conditions::Z) {
+        return this->_zero();
+    } else if constexpr (cc == conditions::NZ) {
+        return !this->_zero();
+    } else if constexpr (cc == conditions::C) {
+        return this->_carry();
+    } else {
+        return !this->_carry();
+    }
+}
+
+template <cpu::rot_op op> uint8_t cpu::_rot(const uint8_t value) {
+    uint8_t result{0};
+    uint8_t carry{0}; // the bit shifted out
+    if constexpr (op == rot_op::rlc) {
+        carry = (value >> 7) & 1;
+        result = (value << 1) | carry; // put carry bit into bit 0
+    } else if constexpr (op == rot_op::rrc) {
+        carry = value & 1;
+        result = (value >> 1) | (carry << 7); // put carry bit into bit 7
+    } else if constexpr (op == rot_op::rl) {
+        carry = (value >> 7) & 1;
+        result = (value << 1) | this->_carry(); // carry flag into bit 0
+    } else if constexpr (op == rot_op::rr) {
+        carry = value & 1;
+        result = (value >> 1) | (this->_carry() << 7); // carry flag into bit 7
+    } else if constexpr (op == rot_op::sla) {
+        carry = (value >> 7) & 1;
+        result = value << 1; // bit 0 is reset to 0
+    } else if constexpr (op == rot_op::sra) {
+        carry = value & 1;
+        result = (value >> 1) | (value & 0x80); // bit 7 is kept
+    } else if constexpr (op == rot_op::swap) {
+        // 0010 1011 == 1011 0010
+        result = (value >> 4) | (value << 4);
+    } else {
+        carry = value & 1;
+        result = value >> 1; // bit 7 reset to 0
+    }
+    this->_lazy_flags(flag_op::zc, result, 0, carry);
+    return result;
+}
+
+// fetch cycle operations
+
+template <cpu::alu_op op, uint8_t cpu::*r> void cpu::alu_r8() {
+    // 1 M-cycle - A op register r8
+    this->_alu<op>(this->*r);
+}
+
+template <uint8_t cpu::*r> void cpu::inc_r8() {
+    this->*r = this->_inc8(this->*r);
+}
+
+template <uint8_t cpu::*r> void cpu::dec_r8() {
+    this->*r = this->_dec8(this->*r);
+}
+
+void cpu::jp_hl() { this->PC = this->HL; }
+
+template <uint8_t cpu::*r1, uint8_t cpu::*r2> void cpu::ld_r_r() {
+    this->*r1 = this->*r2;
+}
+
+// one cycle accumulator rotates always reset the z flag
+void cpu::rlca() {
+    this->A = this->_rot<rot_op::rlc>(this->A);
+    this->lazy_op = flag_op::c;
+}
+
+void cpu::rrca() {
+    this->A = this->_rot<rot_op::rrc>(this->A);
+    this->lazy_op = flag_op::c;
+}
+
+void cpu::rla() {
+    this->A = this->_rot<rot_op::rl>(this->A);
+    this->lazy_op = flag_op::c;
+}
+
+void cpu::rra() {
+    this->A = this->_rot<rot_op::rr>(this->A);
+    this->lazy_op = flag_op::c;
+}
+
+void cpu::cpl() {
+    this->A = ~this->A;
+    this->sync_flags();
+    this->F |= flag_n | flag_h;
+}
+
+void cpu::scf() {
+    this->sync_flags();
+    this->F = (this->F & flag_z) | flag_c;
+}
+
+void cpu::ccf() {
+    this->sync_flags();
+    this->F = (this->F & (flag_z | flag_c)) ^ flag_c;
+}
+
+void cpu::daa() {
+    this->sync_flags();
+    uint8_t carry = this->F & flag_c;
+    if (!(this->F & flag_n)) {
+        if (carry || this->A > 0x99) {
+            this->A += 0x60;
+            carry = flag_c;
+        }
+        if ((this->F & flag_h) || (this->A & 0x0f) > 0x09) {
+            this->A += 0x6;
+        }
+    } else {
+        if (carry) {
+            this->A -= 0x60;
+        }
+        if (this->F & flag_h) {
+            this->A -= 0x6;
+        }
+    }
+    // n is kept, h is reset
+    this->F = (this->F & flag_n) | carry | (this->A == 0 ? flag_z : 0);
+}
+
+void cpu::halt_or_halt_bug() {
+    if (this->gb_interrupt->ime) {
+        this->halt = true;
+        this->gb_mmu->cpu_halted = true;
+    } else {
+        // if there is no interrupt, halt is entered
+        // ie & if & 0x1f
+        if (!(_get(0xffff) & _get(0xff0f) & 0x1f)) {
+            this->halt = true;
+            this->gb_mmu->cpu_halted = true;
+        }
+
+        else {
+            // halt bug
+            this->halt_bug = true;
+        }
+    }
+}
+
+void cpu::ei() {
+    // ime is set after the next instruction
+    this->gb_interrupt->ei_delay = true;
+}
+
+void cpu::di() { this->gb_interrupt->ime = false; }
+
+void cpu::cb_prefix() {
+    const uint8_t cb_opcode = this->_fetch(this->PC);
+    this->PC++; // increment the program counter
+    this->handle_cb_opcode(cb_opcode);
+}
+
+// micro ops
+
+void cpu::fill() {}
+
+void cpu::read_imm_z() {
+    this->Z = _fetch(this->PC);
+    this->PC++;
+}
+
+void cpu::read_imm_w() {
+    this->W = _fetch(this->PC);
+    this->PC++;
+}
+
+template <cpu::conditions cc> void cpu::read_imm_z_cc() {
+    this->Z = _fetch(this->PC);
+    this->PC++;
+
+    // condition not met, skip the remaining M-cycles
+    if (!this->_condition<cc>()) {
+        this->M_operations.clear();
+    }
+}
+
+void cpu::decrement_sp() { this->SP--; }
+
+template <cpu::alu_op op> void cpu::alu_hl_m1() {
+    this->Z = _get(this->HL);
+    this->_alu<op>(this->Z);
+}
+
+template <cpu::alu_op op> void cpu::alu_imm8_m1() {
+    this->Z = _fetch(this->PC);
+    this->PC++;
+    this->_alu<op>(this->Z);
+}
+
+template <uint16_t cpu::*rr> void cpu::add_hl_rr_m1() {
+    this->_add_hl(this->*rr);
+}
+
+void cpu::add_sp_s8_m2() { this->SP = this->_add_sp_s8(this->Z); }
+
+void cpu::call_m4() {
+    // store the ms byte and ls byte of current pointer counter to stack
+    // pointer
+    uint8_t pc_msb = (this->PC >> 8) & 0x00ff;
+
+    this->_set(SP, pc_msb);
+    this->SP--;
+}
+
+void cpu::call_m5() {
+    uint8_t pc_lsb = this->PC & 0x00ff;
+    this->_set(SP, pc_lsb);
+    // set program counter to function
+    this->PC = (this->Z << 8) | this->W; // the function
+}
+
+void cpu::inc_or_dec_hl_m1() { this->Z = _get(this->HL); }
+
+void cpu::inc_hl_m2() { this->_set(this->HL, this->_inc8(this->Z)); }
+
+void cpu::dec_hl_m2() { this->_set(this->HL, this->_dec8(this->Z)); }
+
+template <uint16_t cpu::*rr> void cpu::inc_rr_m1() {
+    // oam bug oam corruption bug write on r16 == bc, or de or hl
+    // this->gb_mmu->oam_bug_write(current_value);
+    (this->*rr)++;
+}
+
+template <uint16_t cpu::*rr> void cpu::dec_rr_m1() { (this->*rr)--; }
+
+void cpu::jp_m3() {
+    this->PC = (this->Z << 8) | this->W; // the function
+}
+
+void cpu::jr_m2() {
+    // 1001 0010
+    int8_t value = this->Z;
+    this->PC += value;
+}
+
+void cpu::ld_imm16_sp_m3() { this->_set(this->WZ, this->SP & 0xff); }
+
+void cpu::ld_imm16_sp_m4() { this->_set(this->WZ + 1, this->SP >> 8); }
+
+void cpu::ld_imm16_a_m3() {
+    this->_set(this->WZ, this->A); // write A to address
+}
+
+void cpu::ld_a_imm16_m3() {
+    this->A = _get(this->WZ); // write value from address to A
+}
+
+template <uint8_t cpu::*r> void cpu::ld_r_imm8_m1() {
+    this->*r = _fetch(this->PC);
+    this->PC++;
+}
+
+void cpu::ld_hl_imm8_m2() { this->_set(this->HL, this->Z); }
+
+void cpu::ld_rr_imm16_m1() {
+    this->Z = _fetch(this->PC); // lsb
+    this->PC++;
+    this->W = _fetch(this->PC); // msb
+    this->PC++;
+}
+
+template <uint16_t cpu::*rr> void cpu::ld_rr_imm16_m2() {
+    this->*rr = this->WZ;
+}
+
+template <uint16_t cpu::*rr> void cpu::ld_rr_a_m1() {
+    this->_set(this->*rr, this->A);
+}
+
+template <uint16_t cpu::*rr> void cpu::ld_a_rr_m1() {
+    this->A = _get(this->*rr);
+}
+
+void cpu::ld_hli_a_m1() {
+    // oam bug oam corruption bug write on increment or decrement, i think
+    // its already handled by set
+    this->_set(this->HL, this->A);
+    this->HL++;
+}
+
+void cpu::ld_hld_a_m1() {
+    this->_set(this->HL, this->A);
+    this->HL--;
+}
+
+void cpu::ld_a_hli_m1() {
+    // oam bug oam corruption bug read inc (corruption happens before get
+    // address)
+    // this->gb_mmu->oam_bug_read_inc(address);
+
+    this->A = _get(this->HL);
+    this->HL++;
+}
+
+void cpu::ld_a_hld_m1() {
+    this->A = _get(this->HL);
+    this->HL--;
+}
+
+template <uint8_t cpu::*r> void cpu::ld_hl_r8_m1() {
+    this->_set(this->HL, this->*r);
+}
+
+template <uint8_t cpu::*r> void cpu::ld_r8_hl_m1() {
+    this->*r = _get(this->HL);
+}
+
+void cpu::ld_hl_sp_s8_m2() { this->HL = this->_add_sp_s8(this->Z); }
+
+void cpu::ld_sp_hl_m1() { this->SP = this->HL; }
+
+void cpu::ld_c_a_m1() {
+    const uint16_t address = this->C | 0xff00;
+    this->_set(address, this->A);
+}
+
+void cpu::ld_a_c_m1() {
+    const uint16_t address = this->C | 0xff00;
+    this->A = this->_get(address);
+}
+
+void cpu::ld_imm8_a_m2() {
+    const uint16_t address = this->Z | 0xff00;
+    this->_set(address, this->A);
+}
+
+void cpu::ld_a_imm8_m2() {
+    const uint16_t address = this->Z | 0xff00;
+    this->A = _get(address);
+}
+
+void cpu::pop_m1() {
+    this->Z = _get(this->SP); // lsb
+    this->SP++;
+}
+
+template <uint16_t cpu::*rr> void cpu::pop_rr_m2() {
+    this->W = _get(this->SP); // msb
+    this->SP++;
+
+    this->*rr = this->WZ;
+}
+
+void cpu::pop_af_m2() {
+    this->W = _get(this->SP); // msb
+    this->SP++;
+
+    // the unused flag bits always read 0
+    this->AF = this->WZ & 0xfff0;
+    this->lazy_op = flag_op::none;
+}
+
+template <uint16_t cpu::*rr> void cpu::push_rr_m2() {
+    this->_set(this->SP, (this->*rr) >> 8);
+    this->SP--;
+}
+
+template <uint16_t cpu::*rr> void cpu::push_rr_m3() {
+    this->_set(this->SP, (this->*rr) & 0xff);
+}
+
+void cpu::push_af_m3() {
+    this->sync_flags();
+    this->_set(this->SP, this->F);
+}
+
+template <cpu::conditions cc> void cpu::ret_cc_m1() {
+    // condition not met, this cycle is the internal delay only
+    if (!this->_condition<cc>()) {
+        this->M_operations.clear();
+        return;
+    }
+    this->ret_m1();
+}
+
+void cpu::ret_m1() {
+    this->Z = _get(this->SP);
+    this->SP++;
+}
+
+void cpu::ret_m2() {
+    this->W = _get(this->SP);
+    this->SP++;
+}
+
+void cpu::ret_m3() { this->PC = this->WZ; }
+
+void cpu::reti_m3() {
+    this->gb_interrupt->ime = true;
+    this->PC = this->WZ;
+}
+
+void cpu::rst_m2() {
+    this->Z = this->PC & 0xff;
+    this->_set(this->SP, this->PC >> 8);
+    this->SP--;
+}
+
+template <uint8_t vector> void cpu::rst_m3() {
+    this->_set(this->SP, this->Z);
+    this->PC = vector;
+}
+
+template <cpu::rot_op op, uint8_t cpu::*r> void cpu::rot_r_m1() {
+    this->*r = this->_rot<op>(this->*r);
+}
+
+template <cpu::rot_op op> void cpu::rot_hl_m2() {
+    this->Z = this->_rot<op>(_get(this->HL));
+}
+
+template <uint8_t bit, uint8_t cpu::*r> void cpu::bit_r_m1() {
+    const bool set = ((this->*r) >> bit) & 1;
+    this->sync_flags();
+    this->F = (this->F & flag_c) | _flags(!set, false, true, false);
+}
+
+template <uint8_t bit> void cpu::bit_hl_m2() {
+    this->Z = _get(this->HL);
+    const bool set = (this->Z >> bit) & 1;
+    this->sync_flags();
+    this->F = (this->F & flag_c) | _flags(!set, false, true, false);
+}
+
+template <uint8_t bit, uint8_t cpu::*r> void cpu::res_r_m1() {
+    // 0 = 1, 1 = 2, 2 = 4, 3 = 8, 4 = 16, 5 = 32, 6 = 64, 7 = 128
+    this->*r &= ~(1 << bit);
+}
+
+template <uint8_t bit, uint8_t cpu::*r> void cpu::set_r_m1() {
+    this->*r |= 1 << bit;
+}
+
+template <uint8_t bit> void cpu::res_hl_m2() {
+    this->Z = _get(this->HL) & ~(1 << bit);
+}
+
+template <uint8_t bit> void cpu::set_hl_m2() {
+    this->Z = _get(this->HL) | (1 << bit);
+}
+
+void cpu::cb_hl_m3() { _set(this->HL, this->Z); }
+
+// build a micro program from its M-cycles in execution order
+template <typename... Steps>
+static constexpr cpu::micro_program program(Steps... steps) {
+    return cpu::micro_program{{steps...}, sizeof...(steps)};
+}
+
+// one handler per value of an opcode field, make gets the value as a
+// std::integral_constant so it can instantiate a handler template with it
+template <typename Make, std::size_t... I>
+static constexpr std::array<cpu::micro_op, sizeof...(I)>
+handlers(Make make, std::index_sequence<I...>) {
+    return {make(std::integral_constant<std::size_t, I>{})...};
+}
+
+template <std::size_t N, typename Make>
+static constexpr std::array<cpu::micro_op, N> handlers(Make make) {
+    return handlers(make, std::make_index_sequence<N>{});
+}
+
+// operand lookup tables
+static constexpr std::array<uint8_t cpu::*, 8> r_table{
+    &cpu::B, &cpu::C, &cpu::D, &cpu::E,
+    &cpu::H, &cpu::L, nullptr, &cpu::A}; // nullptr means HL
+static constexpr std::array<uint16_t cpu::*, 4> rp{&cpu::BC, &cpu::DE,
+                                                   &cpu::HL, &cpu::SP};
+static constexpr std::array<uint16_t cpu::*, 4> rp2{&cpu::BC, &cpu::DE,
+                                                    &cpu::HL, &cpu::AF};
+static constexpr std::array<cpu::conditions, 4> cc_table{
+    cpu::conditions::NZ, cpu::conditions::Z, cpu::conditions::NC,
+    cpu::conditions::C};
+
+constexpr std::array<cpu::instruction, 512> cpu::_build_instructions() {
     /*
     x = the opcode's 1st octal digit (i.e. bits 7-6)
     y = the opcode's 2nd octal digit (i.e. bits 5-3)
@@ -9,314 +615,458 @@ int cpu::handle_opcode(const uint8_t opcode) {
     p = y rightshifted one position (i.e. bits 5-4)
     q = y modulo 2 (i.e. bit 3)
     */
-    uint8_t x = (opcode >> 6) & 3; // bits 7 - 6
-    uint8_t y = (opcode >> 3) & 7; // bits 3 - 5
-    uint8_t z = opcode & 7;      // bits 2 - 0
-
-    uint8_t p = y >> 1; // bit 5 - 4
-    uint8_t q = y % 2;  // bit 3
-
-    const registers rp_r1 = rp_table[2 * p];
-    const registers rp_r2 = rp_table[(2 * p) + 1];
-
-    switch (x) {
-    // beginning of highest switch case (x)
-    case 0:
-        // x == 0
-        switch (z) {
-        // beginning of switch case for z
-        case 0:
-            switch (y) {
-            // beginning of switch case for y
-            case 0: break; // TODO: NOP
-            case 1: ld_imm16_sp(); break;
-            case 2: break; // TODO: STOP
-            case 3: jr_s8(conditions::NA); break;
-            case 4: jr_s8(conditions::NZ); break;
-            case 5: jr_s8(conditions::Z); break;
-            case 6: jr_s8(conditions::NC); break;
-            case 7:
-                jr_s8(conditions::C);
-                break;
-                // end of switch case for y
-            }
-            break;
 
-        case 1:
-            switch (q) {
-            case 0: ld_rr_address(rp_r1, rp_r2, rp_r1 == registers::NA); break;
-            case 1: add_hl_rr(rp_r1, rp_r2, rp_r1 == registers::NA); break;
-            }
-            break;
+    // handlers indexed by y or z, and by y * 8 + z for the ones taking both
+    // (the low 6 bits of the opcode). (hl) slots of r_table stay empty
 
-        case 2:
-            switch (q) {
+    // alu[y] on a register, (hl) and imm8
+    constexpr auto alu_r8 = handlers<64>([](auto i) -> micro_op {
+        if constexpr (i % 8 == 6) {
+            return nullptr;
+        } else {
+            return &cpu::alu_r8<static_cast<alu_op>(i / 8), r_table[i % 8]>;
+        }
+    });
+    constexpr auto alu_hl = handlers<8>([](auto y) -> micro_op {
+        return &cpu::alu_hl_m1<static_cast<alu_op>(y())>;
+    });
+    constexpr auto alu_imm8 = handlers<8>([](auto y) -> micro_op {
+        return &cpu::alu_imm8_m1<static_cast<alu_op>(y())>;
+    });
+    constexpr std::array<micro_op, 8> accumulator_ops{
+        &cpu::rlca, &cpu::rrca, &cpu::rla, &cpu::rra,
+        &cpu::daa,  &cpu::cpl,  &cpu::scf, &cpu::ccf};
+
+    // 8-bit loads, inc and dec
+    constexpr auto inc_r8 = handlers<8>([](auto y) -> micro_op {
+        if constexpr (y == 6) {
+            return nullptr;
+        } else {
+            return &cpu::inc_r8<r_table[y]>;
+        }
+    });
+    constexpr auto dec_r8 = handlers<8>([](auto y) -> micro_op {
+        if constexpr (y == 6) {
+            return nullptr;
+        } else {
+            return &cpu::dec_r8<r_table[y]>;
+        }
+    });
+    constexpr auto ld_r_imm8 = handlers<8>([](auto y) -> micro_op {
+        if constexpr (y == 6) {
+            return nullptr;
+        } else {
+            return &cpu::ld_r_imm8_m1<r_table[y]>;
+        }
+    });
+    constexpr auto ld_r_r = handlers<64>([](auto i) -> micro_op {
+        if constexpr (i / 8 == 6 || i % 8 == 6) {
+            return nullptr;
+        } else {
+            return &cpu::ld_r_r<r_table[i / 8], r_table[i % 8]>;
+        }
+    });
+    constexpr auto ld_hl_r8 = handlers<8>([](auto z) -> micro_op {
+        if constexpr (z == 6) {
+            return nullptr;
+        } else {
+            return &cpu::ld_hl_r8_m1<r_table[z]>;
+        }
+    });
+    constexpr auto ld_r8_hl = handlers<8>([](auto y) -> micro_op {
+        if constexpr (y == 6) {
+            return nullptr;
+        } else {
+            return &cpu::ld_r8_hl_m1<r_table[y]>;
+        }
+    });
+
+    // register pairs rp[p], and rp2[p] for push and pop (af has its own low
+    // byte handlers)
+    constexpr auto ld_rr_imm16 = handlers<4>([](auto p) -> micro_op {
+        return &cpu::ld_rr_imm16_m2<rp[p]>;
+    });
+    constexpr auto add_hl_rr = handlers<4>([](auto p) -> micro_op {
+        return &cpu::add_hl_rr_m1<rp[p]>;
+    });
+    constexpr auto inc_rr = handlers<4>([](auto p) -> micro_op {
+        return &cpu::inc_rr_m1<rp[p]>;
+    });
+    constexpr auto dec_rr = handlers<4>([](auto p) -> micro_op {
+        return &cpu::dec_rr_m1<rp[p]>;
+    });
+    constexpr auto ld_rr_a = handlers<2>([](auto p) -> micro_op {
+        return &cpu::ld_rr_a_m1<rp[p]>;
+    });
+    constexpr auto ld_a_rr = handlers<2>([](auto p) -> micro_op {
+        return &cpu::ld_a_rr_m1<rp[p]>;
+    });
+    constexpr auto pop_rr = handlers<3>([](auto p) -> micro_op {
+        return &cpu::pop_rr_m2<rp2[p]>;
+    });
+    constexpr auto push_rr_msb = handlers<4>([](auto p) -> micro_op {
+        return &cpu::push_rr_m2<rp2[p]>;
+    });
+    constexpr auto push_rr_lsb = handlers<3>([](auto p) -> micro_op {
+        return &cpu::push_rr_m3<rp2[p]>;
+    });
+
+    // conditions cc[y & 3] and rst vectors y * 8
+    constexpr auto read_imm_z_cc = handlers<4>([](auto y) -> micro_op {
+        return &cpu::read_imm_z_cc<cc_table[y]>;
+    });
+    constexpr auto ret_cc = handlers<4>([](auto y) -> micro_op {
+        return &cpu::ret_cc_m1<cc_table[y]>;
+    });
+    constexpr auto rst = handlers<8>([](auto y) -> micro_op {
+        return &cpu::rst_m3<y * 8>;
+    });
+
+    // cb rot[y], bit, res and set y on a register and (hl)
+    constexpr auto rot_r8 = handlers<64>([](auto i) -> micro_op {
+        if constexpr (i % 8 == 6) {
+            return nullptr;
+        } else {
+            return &cpu::rot_r_m1<static_cast<rot_op>(i / 8), r_table[i % 8]>;
+        }
+    });
+    constexpr auto rot_hl = handlers<8>([](auto y) -> micro_op {
+        return &cpu::rot_hl_m2<static_cast<rot_op>(y())>;
+    });
+    constexpr auto bit_r8 = handlers<64>([](auto i) -> micro_op {
+        if constexpr (i % 8 == 6) {
+            return nullptr;
+        } else {
+            return &cpu::bit_r_m1<i / 8, r_table[i % 8]>;
+        }
+    });
+    constexpr auto bit_hl = handlers<8>([](auto y) -> micro_op {
+        return &cpu::bit_hl_m2<y>;
+    });
+    constexpr auto res_r8 = handlers<64>([](auto i) -> micro_op {
+        if constexpr (i % 8 == 6) {
+            return nullptr;
+        } else {
+            return &cpu::res_r_m1<i / 8, r_table[i % 8]>;
+        }
+    });
+    constexpr auto res_hl = handlers<8>([](auto y) -> micro_op {
+        return &cpu::res_hl_m2<y>;
+    });
+    constexpr auto set_r8 = handlers<64>([](auto i) -> micro_op {
+        if constexpr (i % 8 == 6) {
+            return nullptr;
+        } else {
+            return &cpu::set_r_m1<i / 8, r_table[i % 8]>;
+        }
+    });
+    constexpr auto set_hl = handlers<8>([](auto y) -> micro_op {
+        return &cpu::set_hl_m2<y>;
+    });
+
+    std::array<instruction, 512> instructions{};
+
+    for (unsigned int opcode = 0; opcode < 256; ++opcode) {
+        const uint8_t x = (opcode >> 6) & 3; // bits 7 - 6
+        const uint8_t y = (opcode >> 3) & 7; // bits 3 - 5
+        const uint8_t z = opcode & 7;        // bits 2 - 0
+        const uint8_t p = y >> 1;            // bit 5 - 4
+        const uint8_t q = y % 2;             // bit 3
+
+        instruction &i = instructions[opcode];
+
+        switch (x) {
+        case 0:
+            switch (z) {
             case 0:
-                switch (p) {
-                case 0: ld_a_rr(registers::B, registers::C, false); break;
-                case 1: ld_a_rr(registers::D, registers::E, false); break;
-                case 2: ld_hl_a(true, false); break;
-                case 3: ld_hl_a(false, false); break;
+                switch (y) {
+                case 0: break; // NOP
+                case 1:
+                    i.length = 3;
+                    i.program =
+                        program(&cpu::read_imm_z, &cpu::read_imm_w,
+                                &cpu::ld_imm16_sp_m3, &cpu::ld_imm16_sp_m4);
+                    break;
+                case 2: i.ends_block = true; break; // TODO: STOP
+                case 3:
+                    i.length = 2;
+                    i.ends_block = true;
+                    i.program = program(&cpu::read_imm_z, &cpu::jr_m2);
+                    break;
+                default:
+                    i.length = 2;
+                    i.ends_block = true;
+                    i.program = program(read_imm_z_cc[y - 4], &cpu::jr_m2);
+                    break;
                 }
                 break;
 
             case 1:
+                if (q == 0) {
+                    i.length = 3;
+                    i.program = program(&cpu::ld_rr_imm16_m1, ld_rr_imm16[p]);
+                } else {
+                    i.program = program(add_hl_rr[p]);
+                }
+                break;
+
+            case 2:
                 switch (p) {
-                case 0: ld_a_rr(registers::B, registers::C, true); break;
-                case 1: ld_a_rr(registers::D, registers::E, true); break;
-                case 2: ld_hl_a(true, true); break;
-                case 3: ld_hl_a(false, true); break;
+                case 2:
+                    i.program = program(q == 0 ? &cpu::ld_hli_a_m1
+                                               : &cpu::ld_a_hli_m1);
+                    break;
+                case 3:
+                    i.program = program(q == 0 ? &cpu::ld_hld_a_m1
+                                               : &cpu::ld_a_hld_m1);
+                    break;
+                default:
+                    i.program = program(q == 0 ? ld_rr_a[p] : ld_a_rr[p]);
+                    break;
                 }
                 break;
-            }
-            break;
 
-        case 3:
-            switch (q) {
-            case 0:
-                inc_or_dec_r16(rp_r1, rp_r2, true, rp_r1 == registers::NA);
+            case 3:
+                i.program = program(q == 0 ? inc_rr[p] : dec_rr[p]);
                 break;
 
-            case 1:
-                inc_or_dec_r16(rp_r1, rp_r2, false, rp_r1 == registers::NA);
+            case 4:
+            case 5:
+                if (r_table[y] == nullptr) {
+                    i.program =
+                        program(&cpu::inc_or_dec_hl_m1,
+                                z == 4 ? &cpu::inc_hl_m2 : &cpu::dec_hl_m2);
+                } else {
+                    i.fetch = z == 4 ? inc_r8[y] : dec_r8[y];
+                }
                 break;
-            }
-            break;
 
-        case 4:
-            // inc hl, or others
-            if (r_table[y] == registers::NA) {
-                inc_or_dec_hl(true);
-            } else {
-                inc_or_dec_r8(r_table[y], true);
+            case 6:
+                i.length = 2;
+                if (r_table[y] == nullptr) {
+                    i.program = program(&cpu::read_imm_z, &cpu::ld_hl_imm8_m2);
+                } else {
+                    i.program = program(ld_r_imm8[y]);
+                }
+                break;
+
+            case 7: i.fetch = accumulator_ops[y]; break;
             }
             break;
 
-        case 5:
-            // inc hl, or others
-            if (r_table[y] == registers::NA) {
-                inc_or_dec_hl(false);
+        case 1:
+            if (z == 6 && y == 6) {
+                i.fetch = &cpu::halt_or_halt_bug;
+                i.ends_block = true;
+            } else if (r_table[y] == nullptr) {
+                // ld (hl), r8
+                i.program = program(ld_hl_r8[z]);
+            } else if (r_table[z] == nullptr) {
+                // ld r8, (hl)
+                i.program = program(ld_r8_hl[y]);
             } else {
-                inc_or_dec_r8(r_table[y], false);
+                i.fetch = ld_r_r[opcode & 63];
             }
             break;
 
-        case 6:
-            if (r_table[y] == registers::NA) {
-                ld_hl_imm8();
+        case 2:
+            // alu[y], z
+            if (r_table[z] == nullptr) {
+                i.program = program(alu_hl[y]);
             } else {
-                ld_r_imm8(r_table[y]);
+                i.fetch = alu_r8[opcode & 63];
             }
             break;
 
-        case 7:
-            switch (y) {
-            case 0: rlc_r(registers::A,false,false,true); break;
-            case 1: rrc_r(registers::A,false,false,true); break;
-            case 2: rl_r(registers::A,false,false,true); break;
-            case 3: rr_r(registers::A,false,false,true); break;
-            case 4: daa(); break;
-            case 5: cpl(); break;
-            case 6: scf(); break;
-            case 7: ccf(); break;
-            }
-            break;
-            // end of switch case for z
-        }
-        break;
+        case 3:
+            switch (z) {
+            case 0:
+                i.length = y < 4 ? 1 : 2;
+                switch (y) {
+                case 4:
+                    i.program = program(&cpu::read_imm_z, &cpu::ld_imm8_a_m2);
+                    break;
+                case 5:
+                    i.program = program(&cpu::read_imm_z, &cpu::add_sp_s8_m2,
+                                        &cpu::fill);
+                    break;
+                case 6:
+                    i.program = program(&cpu::read_imm_z, &cpu::ld_a_imm8_m2);
+                    break;
+                case 7:
+                    i.program =
+                        program(&cpu::read_imm_z, &cpu::ld_hl_sp_s8_m2);
+                    break;
+                default:
+                    // ret cc, the trailing fill runs last when taken
+                    i.ends_block = true;
+                    i.program = program(ret_cc[y], &cpu::ret_m2,
+                                        &cpu::ret_m3, &cpu::fill);
+                    break;
+                }
+                break;
 
-    case 1:
-        if (z == 6 && y == 6) {
-            // HALT
-            if (this->gb_interrupt->ime) {
-                this->halt = true;
-                this->gb_mmu->cpu_halted = true;
-            } else {
-                // if there is no interrupt, halt is entered
-                // ie & if & 0x1f
-                if (!(_get(0xffff) & _get(0xff0f) & 0x1f)) {
-                    this->halt = true;
-                    this->gb_mmu->cpu_halted = true;
+            case 1:
+                if (q == 0) {
+                    i.program = program(&cpu::pop_m1, p == 3 ? &cpu::pop_af_m2
+                                                             : pop_rr[p]);
+                    break;
+                }
+                i.ends_block = p != 3;
+                switch (p) {
+                case 0:
+                    i.program =
+                        program(&cpu::ret_m1, &cpu::ret_m2, &cpu::ret_m3);
+                    break;
+                case 1:
+                    i.program =
+                        program(&cpu::ret_m1, &cpu::ret_m2, &cpu::reti_m3);
+                    break;
+                case 2: i.fetch = &cpu::jp_hl; break;
+                case 3: i.program = program(&cpu::ld_sp_hl_m1); break;
                 }
+                break;
 
-                else {
-                    // halt bug
-                    this->halt_bug = true;
+            case 2:
+                switch (y) {
+                case 4: i.program = program(&cpu::ld_c_a_m1); break;
+                case 5:
+                    i.length = 3;
+                    i.program = program(&cpu::read_imm_z, &cpu::read_imm_w,
+                                        &cpu::ld_imm16_a_m3);
+                    break;
+                case 6: i.program = program(&cpu::ld_a_c_m1); break;
+                case 7:
+                    i.length = 3;
+                    i.program = program(&cpu::read_imm_z, &cpu::read_imm_w,
+                                        &cpu::ld_a_imm16_m3);
+                    break;
+                default:
+                    i.length = 3;
+                    i.ends_block = true;
+                    i.program =
+                        program(&cpu::read_imm_w, read_imm_z_cc[y], &cpu::jp_m3);
+                    break;
                 }
-            }
+                break;
 
-        } else {
-            if (r_table[y] == registers::NA) {
-                ld_hl_r8(r_table[z], true);
-            } else if (r_table[z] == registers::NA) {
-                // LD r8 hl
-                ld_hl_r8(r_table[y], false);
-            } else {
-                ld_r_r(r_table[y], r_table[z]);
-            }
-        }
-        break;
+            case 3:
+                switch (y) {
+                case 0:
+                    i.length = 3;
+                    i.ends_block = true;
+                    i.program =
+                        program(&cpu::read_imm_w, &cpu::read_imm_z, &cpu::jp_m3);
+                    break;
+                case 1:
+                    i.length = 2;
+                    i.fetch = &cpu::cb_prefix;
+                    break;
+                case 6: i.fetch = &cpu::di; break;
+                case 7: i.fetch = &cpu::ei; break;
+                }
+                break;
 
-    case 2:
-        // alu[y], z
-        switch (y) {
-        case 0:
-            if (r_table[z] == registers::NA) {
-                add_a_hl();
-            } else {
-                add_a_r8(r_table[z]);
+            case 4:
+                // call conditions
+                if (y < 4) {
+                    i.length = 3;
+                    i.ends_block = true;
+                    i.program = program(&cpu::read_imm_w, read_imm_z_cc[y],
+                                        &cpu::decrement_sp, &cpu::call_m4,
+                                        &cpu::call_m5);
+                }
+                break;
+
+            case 5:
+                if (q == 0) {
+                    // push af pushes A then the flags byte
+                    i.program = program(&cpu::decrement_sp, push_rr_msb[p],
+                                        p == 3 ? &cpu::push_af_m3
+                                               : push_rr_lsb[p]);
+                } else if (p == 0) {
+                    i.length = 3;
+                    i.ends_block = true;
+                    i.program = program(&cpu::read_imm_w, &cpu::read_imm_z,
+                                        &cpu::decrement_sp, &cpu::call_m4,
+                                        &cpu::call_m5);
+                }
+                break;
+
+            case 6:
+                i.length = 2;
+                i.program = program(alu_imm8[y]);
+                break;
+
+            case 7:
+                i.ends_block = true;
+                i.program = program(&cpu::decrement_sp, &cpu::rst_m2, rst[y]);
+                break;
             }
             break;
-        case 1:
-            adc_or_sbc(r_table[z], r_table[z] == registers::NA, true);
-            break;
-        case 2: sub(r_table[z], r_table[z] == registers::NA); break;
-        case 3:
-            adc_or_sbc(r_table[z], r_table[z] == registers::NA, false);
-            break;
-        case 4: and_r(r_table[z], r_table[z] == registers::NA); break;
-        case 5: xor_r(r_table[z], r_table[z] == registers::NA); break;
-        case 6: or_r(r_table[z], r_table[z] == registers::NA); break;
-        case 7: cp_a_r(r_table[z], r_table[z] == registers::NA); break;
         }
-        break;
+    }
+
+    for (unsigned int cb_opcode = 0; cb_opcode < 256; ++cb_opcode) {
+        const uint8_t x = (cb_opcode >> 6) & 3; // bits 7 - 6
+        const uint8_t y = (cb_opcode >> 3) & 7; // bits 3 - 5
+        const uint8_t z = cb_opcode & 7;        // bits 2 - 0
 
-    case 3: {
-        switch (z) {
+        instruction &i = instructions[256 + cb_opcode];
+        i.length = 2; // with the prefix
+
+        // (hl) variants: the cb opcode fetch, the read and op, the write
+        const bool hl = r_table[z] == nullptr;
+        switch (x) {
         case 0:
-            switch (y) {
-            case 0: ret(conditions::NZ); break;
-            case 1: ret(conditions::Z); break;
-            case 2: ret(conditions::NC); break;
-            case 3: ret(conditions::C); break;
-            case 4: ld_imm8_a(false); break;
-            case 5: add_sp_s8(); break;
-            case 6: ld_imm8_a(true); break;
-            case 7: ld_hl_sp_s8(); break;
-            }
+            i.program = hl ? program(&cpu::fill, rot_hl[y], &cpu::cb_hl_m3)
+                           : program(rot_r8[cb_opcode & 63]);
             break;
-
         case 1:
-            switch (q) {
-            case 0: pop_rr(rp_r1, rp_r2, rp_r1 == registers::NA); break;
-            case 1:
-                switch (p) {
-                case 0: ret(conditions::NA); break;
-                case 1: ret(conditions::NA, true); break;
-                case 2: jp_hl(); break;
-                case 3: ld_sp_hl(); break;
-                }
-                break;
-            }
+            i.program = hl ? program(&cpu::fill, bit_hl[y])
+                           : program(bit_r8[cb_opcode & 63]);
             break;
-
         case 2:
-            switch (y) {
-            case 0: jp_imm16(conditions::NZ); break;
-            case 1: jp_imm16(conditions::Z); break;
-            case 2: jp_imm16(conditions::NC); break;
-            case 3: jp_imm16(conditions::C); break;
-            case 4: ld_c_a(false); break;
-            case 5: ld_imm16_a(false); break;
-            case 6: ld_c_a(true); break;
-            case 7: ld_imm16_a(true); break;
-            }
+            i.program =
+                hl ? program(&cpu::fill, res_hl[y], &cpu::cb_hl_m3)
+                   : program(res_r8[cb_opcode & 63]);
             break;
-
         case 3:
-            switch (y) {
-            case 0: jp_imm16(conditions::NA); break;
-            case 1: {
-                // TODO: cb create another CB handler
-                const uint8_t cb_opcode = this->_get(this->PC);
-                this->PC++; // increment the program counter
-                this->handle_cb_opcode(cb_opcode);
-                break;
-            }
-            case 6: ei_or_di(false); break;
-            case 7: ei_or_di(true); break;
-            }
+            i.program =
+                hl ? program(&cpu::fill, set_hl[y], &cpu::cb_hl_m3)
+                   : program(set_r8[cb_opcode & 63]);
             break;
+        }
+    }
 
-        case 4:
-            // call conditions
-            switch (y) {
-            case 0: call(conditions::NZ); break;
-            case 1: call(conditions::Z); break;
-            case 2: call(conditions::NC); break;
-            case 3: call(conditions::C); break;
-            }
-            break;
+    return instructions;
+}
 
-        case 5:
-            switch (q) {
-            case 0: push_rr(rp_r1, rp_r2, rp_r1 == registers::NA); break;
-            case 1:
-                if (p == 0) {
-                    call(conditions::NA);
-                }
-                break;
-            }
-            break;
+const std::array<cpu::instruction, 512> cpu::instructions =
+    cpu::_build_instructions();
 
-        case 6:
-            switch (y) {
-            case 0: add_or_sub_a_imm8(true); break;
-            case 1: adc_or_sbc_imm8(true); break;
-            case 2: add_or_sub_a_imm8(false); break;
-            case 3: adc_or_sbc_imm8(false); break;
-            case 4: and_xor_or_imm8(bitops::AND); break;
-            case 5: and_xor_or_imm8(bitops::XOR); break;
-            case 6: and_xor_or_imm8(bitops::OR); break;
-            case 7: cp_a_imm8(); break;
-            }
-            break;
+uint8_t cpu::instruction_length(const uint8_t opcode) {
+    return instructions[opcode].length;
+}
 
-        case 7: rst(opcode); break;
-        }
-        break;
-    }
-    // end of highest switch case (x)
-    default: {
-        // print out the opcodes we didnt' implement
-        std::cout << "not implemented: " //<< static_cast<unsigned int>(opcode)
-                  << "hex: 0x" << std::hex << static_cast<unsigned int>(opcode)
-                  << std::endl;
-        // system("pause");
-        std::cin.get();
-        return 0;
-        break;
-    }
+int cpu::handle_opcode(const uint8_t opcode) {
+    // the instruction is decoded ahead of time, further M-cycles come from its
+    // micro program and only the fetch cycle work runs here
+    const instruction &i = instructions[opcode];
+    this->M_operations.load(i.program);
+
+    if (i.fetch) {
+        (this->*(i.fetch))();
     }
 
     return 1;
 }
 
 int cpu::handle_cb_opcode(const uint8_t cb_opcode) {
-
-    uint8_t x = cb_opcode >> 6 & 3; // bits 7 - 6
-    uint8_t y = cb_opcode >> 3 & 7; // bits 3 - 5
-    uint8_t z = cb_opcode & 7;      // bits 2 - 0
-
-    switch (x) {
-    case 0:
-        switch (y) {
-        case 0: rlc_r(r_table[z], r_table[z] == registers::NA, true); break;
-        case 1: rrc_r(r_table[z], r_table[z] == registers::NA, true); break;
-        case 2: rl_r(r_table[z], r_table[z] == registers::NA, true); break;
-        case 3: rr_r(r_table[z], r_table[z] == registers::NA, true); break;
-        case 4: sla_r(r_table[z], r_table[z] == registers::NA); break;
-        case 5: sra_r(r_table[z], r_table[z] == registers::NA); break;
-        case 6: swap_r(r_table[z], r_table[z] == registers::NA); break;
-        case 7: srl_r(r_table[z], r_table[z] == registers::NA); break;
-        }
-        break;
-    case 1: bit(y, r_table[z], r_table[z] == registers::NA); break;
-    case 2:
-        res_or_set(y, r_table[z], false, r_table[z] == registers::NA);
-        break;
-    case 3: res_or_set(y, r_table[z], true, r_table[z] == registers::NA); break;
-    }
+#ifdef RICEBOY_PROFILER
+    this->profile->cb_opcode(cb_opcode);
+#endif
+    this->M_operations.load(instructions[256 + cb_opcode].program);
 
     return 1;
 }
@@ -16,7 +16,11 @@ uint8_t ppu::_get(uint16_t address) {
     uint16_t base_address = static_cast<uint16_t>(section);
 
     switch (section) {
-    case mmu::section::oam_ram: return this->oam_ram[address - base_address];
+    case mmu::section::oam_ram:
+        if (this->dma_mode && this->oam_dma_catch_up) {
+            this->oam_dma_catch_up();
+        }
+        return this->oam_ram[address - base_address];
 
     case mmu::section::bg_map_data_2:
         return this->bg_map_data_2[address - base_address];
@@ -33,13 +37,22 @@ uint8_t ppu::_get(uint16_t address) {
 
 // ppu constructor
 ppu::ppu(interrupt &gb_interrupt, sf::RenderWindow &window_)
-    : gb_interrupt(gb_interrupt), window(window_) {
+    : gb_interrupt(gb_interrupt),
+      memory(std::make_unique<video_memory>()),
+      bg_map_data_2(memory->bg_map_data_2),
+      bg_map_data_1(memory->bg_map_data_1),
+      character_ram(memory->character_ram), oam_ram(memory->oam_ram),
+      window(window_) {
 
     // TODO check logic for setting STAT to 1000 0000 (resetting STAT)
     this->stat_ff41 = 0x80;
 
-    sf::Image image({window.getSize().x, window.getSize().y}, sf::Color::White);
-    this->lcd_frame_image = image; // image with pixels to display on the screen
+    // the fifos and sprite lists never hold more than this, they are cleared
+    // and refilled in place without allocating
+    this->background_fifo.reserve(16);
+    this->sprite_fifo.reserve(8);
+    this->sprite_buffer.reserve(10);
+    this->sprites_to_fetch.reserve(10);
 };
 
 void ppu::initialize_skip_bootrom_values() {
@@ -115,26 +128,7 @@ void ppu::interrupt_line_check() {
 
     bool prev_interrupt_line = current_interrupt_line;
 
-    ppu_mode stat_mode = static_cast<ppu_mode>(this->stat_ff41 & 3);
-
-    bool oam_scan = (stat_mode == ppu_mode::OAM_Scan) &&
-                    (this->stat_ff41 & 0x20); // only trigger the delay the tick
-                                              // after the mode starts 0010 0000
-
-    bool hblank = (stat_mode == ppu_mode::HBlank) && (this->stat_ff41 & 0x08);
-    // 0000 1000
-
-    // bit 5 (& 0x20) applies to both VBlank and OAM_Scan
-    bool vblank = (stat_mode == ppu_mode::VBlank) &&
-                  ((this->stat_ff41 & 0x10) ||
-                   ((this->stat_ff41 & 0x20) && (this->ly_ff44 == 144)));
-    // 0001 0000, 0010 0000
-
-    // get the old LY to compare
-    bool ly_lyc = (this->ly_ff44 == this->lyc_ff45) && (this->stat_ff41 & 0x40);
-    // 0100 0000
-
-    current_interrupt_line = oam_scan || hblank || vblank || ly_lyc;
+    current_interrupt_line = _stat_line();
 
     //    // ly == lyc comparison delayed for 1 cycle
     if (ticks >= 452) {
@@ -159,7 +153,30 @@ void ppu::interrupt_line_check() {
     }
 }
 
-sf::Color ppu::get_pixel_color(uint8_t pixel, uint8_t palette) {
+bool ppu::_stat_line() const {
+    ppu_mode stat_mode = static_cast<ppu_mode>(this->stat_ff41 & 3);
+
+    bool oam_scan = (stat_mode == ppu_mode::OAM_Scan) &&
+                    (this->stat_ff41 & 0x20); // only trigger the delay the tick
+                                              // after the mode starts 0010 0000
+
+    bool hblank = (stat_mode == ppu_mode::HBlank) && (this->stat_ff41 & 0x08);
+    // 0000 1000
+
+    // bit 5 (& 0x20) applies to both VBlank and OAM_Scan
+    bool vblank = (stat_mode == ppu_mode::VBlank) &&
+                  ((this->stat_ff41 & 0x10) ||
+                   ((this->stat_ff41 & 0x20) && (this->ly_ff44 == 144)));
+    // 0001 0000, 0010 0000
+
+    // get the old LY to compare
+    bool ly_lyc = (this->ly_ff44 == this->lyc_ff45) && (this->stat_ff41 & 0x40);
+    // 0100 0000
+
+    return oam_scan || hblank || vblank || ly_lyc;
+}
+
+uint8_t ppu::get_pixel_shade(uint8_t pixel, uint8_t palette) {
     // Get the appropriate palette register
     uint8_t palette_value{};
 
@@ -174,16 +191,7 @@ sf::Color ppu::get_pixel_color(uint8_t pixel, uint8_t palette) {
 
     // Extract the color ID for the pixel (each pixel uses 2 bits in the
     // palette)
-    uint8_t color_id = (palette_value >> (2 * (pixel & 0x03))) & 0x03;
-
-    // Map the color ID directly to the appropriate color palette
-    const std::array<std::array<uint8_t, 3>, 4> color_map = {
-        color_palette_white, color_palette_light_gray, color_palette_dark_gray,
-        color_palette_black};
-
-    // Get the RGB values and return as sf::Color
-    const auto &color = color_map[color_id];
-    return {color[0], color[1], color[2]};
+    return (palette_value >> (2 * (pixel & 0x03))) & 0x03;
 }
 
 void ppu::reset_ticks() {
@@ -360,6 +368,97 @@ void ppu::fetch_sprites() {
     return;
 }
 
+bool ppu::idle() const { return !this->lcd_on && !this->lcd_toggle; }
+
+bool ppu::_settled() const {
+    const uint8_t coincidence =
+        (this->ticks < 452 && this->ly_ff44 == this->lyc_ff45) ? 4 : 0;
+    return this->lcd_on && !this->lcd_toggle &&
+           (this->stat_ff41 & 3) == static_cast<uint8_t>(current_mode) % 4 &&
+           (this->stat_ff41 & 4) == coincidence &&
+           current_interrupt_line == _stat_line() &&
+           (wy_condition || this->wy_ff4a != this->ly_ff44);
+}
+
+uint32_t ppu::quiet_dots() const {
+    if (idle()) {
+        return UINT32_MAX;
+    }
+    // oam scan and drawing do something every dot
+    if ((current_mode != ppu_mode::HBlank &&
+         current_mode != ppu_mode::VBlank) ||
+        vblank_start || !_settled()) {
+        return 0;
+    }
+
+    // the tick that does something next, everything before it only counts
+    uint16_t next{452}; // ly, or the coincidence flag clears
+    if (current_mode == ppu_mode::VBlank) {
+        if (ly_ff44 == 153 && ticks < 4) {
+            next = 4; // ly snaps to 0
+        } else if (ticks >= 452) {
+            next = 456; // end of the line
+        }
+    }
+    return ticks + 1u < next ? next - ticks - 1u : 0;
+}
+
+uint32_t ppu::dots_until_interrupt(const uint8_t enabled) const {
+    if (!(enabled & 3) || idle()) {
+        return UINT32_MAX;
+    }
+    if (!_settled() || current_mode == ppu_mode::LCDToggledOn) {
+        return 0;
+    }
+
+    uint32_t dots{UINT32_MAX};
+    if (enabled & 1) {
+        // vblank starts the dot after line 143 ends, a whole frame of lines
+        // away once it started
+        if (current_mode == ppu_mode::VBlank) {
+            dots = vblank_start ? 0 : 144 * 456;
+        } else {
+            // ly already counts the next line at the end of hblank
+            const uint8_t line =
+                (current_mode == ppu_mode::HBlank && ticks >= 452)
+                    ? this->ly_ff44 - 1
+                    : this->ly_ff44;
+            dots = line > 143 ? 0 : (143 - line) * 456 + 456 - ticks - 1;
+        }
+    }
+    if (enabled & 2) {
+        // the stat line only moves with the mode and ly
+        uint32_t stat{0};
+        switch (current_mode) {
+        case ppu_mode::OAM_Scan:
+            // drawing pushes at most a pixel a dot
+            stat = 80 - ticks + 168 - lcd_x - 1;
+            break;
+        case ppu_mode::Drawing:
+            stat = lcd_x < 167 ? 167 - lcd_x : 0;
+            break;
+        default:
+            stat = quiet_dots();
+            break;
+        }
+        dots = std::min(dots, stat);
+    }
+    return dots;
+}
+
+void ppu::skip(const uint32_t dots) {
+    assert(dots <= quiet_dots() && "skipping dots that do something!");
+    this->ppu_total_ticks += static_cast<uint16_t>(dots);
+    if (idle()) {
+        return;
+    }
+
+    this->ticks += static_cast<uint16_t>(dots);
+    if (current_mode == ppu_mode::HBlank) {
+        this->mode0_ticks += static_cast<uint16_t>(dots);
+    }
+}
+
 void ppu::tick() {
     ppu_total_ticks++;
     // if lcd got toggled off
@@ -506,13 +605,15 @@ void ppu::tick() {
                 sprite_buffer.clear();
             }
 
-            // stable sort sprite buffer
-            if (sprite_buffer.size() > 1) {
-                std::stable_sort(
-                    sprite_buffer.begin(), sprite_buffer.end(),
-                    [](const oam_entry &a, const oam_entry &b) -> bool {
-                        return a.x < b.x; // lower x has priority
-                    });
+            // stable sort sprite buffer, lower x has priority. insertion
+            // sort in place, std::stable_sort allocates a buffer every line
+            for (std::size_t i = 1; i < sprite_buffer.size(); ++i) {
+                const oam_entry entry = sprite_buffer[i];
+                std::size_t j = i;
+                for (; j > 0 && sprite_buffer[j - 1].x > entry.x; --j) {
+                    sprite_buffer[j] = sprite_buffer[j - 1];
+                }
+                sprite_buffer[j] = entry;
             }
 
             // NOTE: this fixed a bug where my first column of tiles was
@@ -734,9 +835,9 @@ void ppu::tick() {
             uint8_t bg_pixel = background_fifo.back();
             background_fifo.pop_back();
 
-            sf::Color final_pixel_color = this->lcdc_ff40 & 1
-                                              ? get_pixel_color(bg_pixel)
-                                              : get_pixel_color(0);
+            uint8_t final_pixel_shade = this->lcdc_ff40 & 1
+                                            ? get_pixel_shade(bg_pixel)
+                                            : get_pixel_shade(0);
 
             if (!sprite_fifo.empty()) {
                 sprite_fifo_pixel sprite_pixel = sprite_fifo.back();
@@ -744,15 +845,15 @@ void ppu::tick() {
 
                 uint8_t palette = (sprite_pixel.flags >> 4) & 1;
 
-                sf::Color sprite_pixel_color =
-                    get_pixel_color(sprite_pixel.color_id, palette);
+                uint8_t sprite_pixel_shade =
+                    get_pixel_shade(sprite_pixel.color_id, palette);
 
                 bool sprite_priority =
                     sprite_pixel.color_id && this->lcdc_ff40 & 0x02 &&
                     (!((sprite_pixel.flags >> 7) & 1) || !bg_pixel);
 
                 if (sprite_priority) {
-                    final_pixel_color = sprite_pixel_color;
+                    final_pixel_shade = sprite_pixel_shade;
                 }
             }
 
@@ -762,8 +863,10 @@ void ppu::tick() {
                 uint16_t position_x = (lcd_x - 8);
                 uint16_t position_y = (this->ly_ff44);
 
-                lcd_frame_image.setPixel({position_x, position_y},
-                                         final_pixel_color);
+                const unsigned int pixel = position_y * lcd_width + position_x;
+                uint8_t &dots = lcd_frame[pixel / 4];
+                const unsigned int shift = 2 * (pixel % 4);
+                dots = (dots & ~(3 << shift)) | (final_pixel_shade << shift);
             }
 
             lcd_x++; // increment the lcd x position
@@ -859,17 +962,8 @@ void ppu::tick() {
                 }
 
                 else {
-                    bool success = lcd_frame.loadFromImage(lcd_frame_image);
-                    assert(success &&
-                           "LCD dots texture error loading from image");
-
-                    sf::Sprite frame(lcd_frame);
-
-                    frame.setScale({draw::SCALE, draw::SCALE});
-
-                    window.clear(sf::Color::White);
-                    window.draw(frame);
-                    window.display();
+                    draw::present(window, lcd_frame.data(), lcd_width,
+                                  lcd_height);
                 }
 
                 update_ppu_mode(ppu_mode::VBlank);
@@ -4,12 +4,14 @@
 #include "mmu.h"
 #include "interrupt.h"
 #include <SFML/Graphics.hpp>
+#include <memory>
 
-class ppu {
+// the state tick() touches on most dots comes first, in its own cache lines.
+// vram and oam live out of line on the heap and the lcd frame comes after the
+// hot state, so a dot doesn't pull in cache lines that are mostly multi-KiB
+// arrays
+class alignas(64) ppu {
   public:
-    interrupt &gb_interrupt;
-    sf::RenderWindow &window;
-
     ppu(interrupt &gb_interrupt, sf::RenderWindow &window);
 
     void initialize_skip_bootrom_values();
@@ -18,19 +20,115 @@ class ppu {
 
     // dot = tick = T-cycle
     void tick();
+    void reset_ticks();
+
+    struct oam_entry {
+        uint8_t x{};       // x position
+        uint8_t y{};       // y position
+        uint8_t tile_id{}; // tile #
+        uint8_t flags{};   // sprite flags
+    };
+
+    struct sprite_fifo_pixel {
+        uint8_t x{};
+        uint8_t color_id{};
+        uint8_t flags{};
+    };
+
+    void increment_ly();
+
+    // calculate t and m cycles of current tick
+    // std::tuple<uint8_t, uint8_t> get_current_cycle();
+
+    void interrupt_line_check();
+
+    enum class ppu_mode : uint8_t {
+        OAM_Scan = 2,
+        Drawing = 3,
+        HBlank = 0,
+        VBlank = 1,
+        LCDToggledOn = 4
+    };
+
+    enum class fetcher_mode : uint8_t {
+        FetchTileNo,
+        FetchTileDataLow,
+        FetchTileDataHigh,
+        PushToFIFO
+    };
+
+    // sprite fetch tile data low function
+    void sprite_fetch_tile_data_low(oam_entry sprite);
+    // sprite push to fifo function
+    void sprite_push_to_fifo(oam_entry sprite);
+
+    // fetch sprite method so i can control the precise timing, returns total
+    // stall
+    void fetch_sprites();
+
+    // update ppu mode
+    void update_ppu_mode(ppu_mode mode);
+
+    // keep track of each scanline
+    void reset_scanline();
+
+    // lcd off and settled, a dot only counts ppu_total_ticks
+    bool idle() const;
+    // dots from here that only count ticks: the rest of hblank or of a
+    // vblank line up to the next ly change, with stat and the stat line
+    // already where those dots leave them. UINT32_MAX while idle, 0 if the
+    // next dot does more
+    uint32_t quiet_dots() const;
+    // dots at once, no more than quiet_dots()
+    void skip(const uint32_t dots);
+    // dots from here that can't raise the IF bits set in enabled (vblank
+    // and stat), UINT32_MAX if it can't raise them at all
+    uint32_t dots_until_interrupt(const uint8_t enabled) const;
+
+    uint8_t get_pixel_shade(
+        uint8_t pixel,
+        uint8_t palette = 2); // 2 means get BGP (non sprite palette)
+
+    // per-dot state
+
+    // 2 fifos
+    std::vector<uint8_t> background_fifo{};       // 2 bits
+    std::vector<sprite_fifo_pixel> sprite_fifo{}; // the whole pixel
+
+    std::vector<oam_entry> sprite_buffer{}; // sprite buffer
+
+    std::vector<oam_entry> sprites_to_fetch{};
+    // oam_entry *sprite_to_fetch{nullptr};
+
+    interrupt &gb_interrupt;
+
     uint16_t ticks{0}; // tick counter
     uint16_t fetcher_ticks{
         0}; // pixel fetcher ticking for accurate 2 tick counts
     uint16_t sprite_ticks{0}; // sprite fetcher ticks
     uint16_t mode3_ticks{0};  // how many ticks mode 3 drawing takes
     uint16_t mode0_ticks{0};  // how many ticks mode 0 hblank takes
-    void reset_ticks();
 
     // separate from the other ticks, aligns interrupt with T-cycles
     uint16_t interrupt_ticks{0};
 
-    // 2 fifos
-    std::vector<uint8_t> background_fifo{}; // 2 bits
+    uint16_t mode_change_ticks{0};
+    uint16_t ppu_total_ticks{0};
+
+    // save the high byte address from fetch low byte step
+    uint16_t bg_high_byte_address{};
+    // save the high byte address from fetch low byte step
+    uint16_t sprite_high_byte_address{};
+
+    // setting stat.mode might be delayed
+    ppu_mode current_mode{ppu_mode::OAM_Scan};
+    // setting last_mode
+    ppu_mode last_mode{ppu_mode::OAM_Scan};
+
+    fetcher_mode current_fetcher_mode{fetcher_mode::FetchTileNo};
+
+    // lcd x position
+    uint8_t lcd_x{0};
 
     uint8_t oam_search_counter{0}; // count oam searched
 
@@ -46,15 +144,11 @@ class ppu {
     // saved low byte and high byte for processing
     uint8_t bg_low_byte{};
     uint8_t bg_high_byte{};
-    // save the high byte address from fetch low byte step
-    uint16_t bg_high_byte_address{};
 
     uint8_t sprite_tile_id{0}; // saved tile_id for grabbing
     // saved low byte and high byte for processing
     uint8_t sprite_low_byte{};
     uint8_t sprite_high_byte{};
-    // save the high byte address from fetch low byte step
-    uint16_t sprite_high_byte_address{};
 
     // dummy fetch once per scanline
     bool dummy_fetch{true};
@@ -66,56 +160,10 @@ class ppu {
     // boolean value which VBlank checks to end the frame
     bool end_frame{false};
 
-    struct oam_entry {
-        uint8_t x{};       // x position
-        uint8_t y{};       // y position
-        uint8_t tile_id{}; // tile #
-        uint8_t flags{};   // sprite flags
-    };
-
-    struct sprite_fifo_pixel {
-        uint8_t x{};
-        uint8_t color_id{};
-        uint8_t flags{};
-    };
-
-    std::vector<sprite_fifo_pixel> sprite_fifo{}; // the whole pixel
-
     // interrupts, stat handling
     bool current_interrupt_line{false}; // 0x48 interrupt (LCD)
 
-    void increment_ly();
-
-    // calculate t and m cycles of current tick
-    // std::tuple<uint8_t, uint8_t> get_current_cycle();
-
     bool vblank_start{false};
-    void interrupt_line_check();
-
-    enum class ppu_mode {
-        OAM_Scan = 2,
-        Drawing = 3,
-        HBlank = 0,
-        VBlank = 1,
-        LCDToggledOn = 4
-    };
-
-    enum class fetcher_mode {
-        FetchTileNo,
-        FetchTileDataLow,
-        FetchTileDataHigh,
-        PushToFIFO
-    };
-
-    // sprite fetch tile data low function
-    void sprite_fetch_tile_data_low(oam_entry sprite);
-    // sprite push to fifo function
-    void sprite_push_to_fifo(oam_entry sprite);
-
-    // setting stat.mode might be delayed
-    ppu_mode current_mode{ppu_mode::OAM_Scan};
-    // setting last_mode
-    ppu_mode last_mode{ppu_mode::OAM_Scan};
 
     bool extend_oam_write_block{false};
 
@@ -124,16 +172,6 @@ class ppu {
     // the M-cycle group (1-114) that mode changed
     uint8_t mode_m_cycle{0};
 
-    fetcher_mode current_fetcher_mode{fetcher_mode::FetchTileNo};
-
-    std::vector<oam_entry> sprite_buffer{}; // sprite buffer
-
-    std::vector<oam_entry> sprites_to_fetch{};
-    // oam_entry *sprite_to_fetch{nullptr};
-
-    // fetch sprite method so i can control the precise timing, returns total
-    // stall
-    void fetch_sprites();
     // uint8_t sprite_fetch_stall_cycles{0};
     uint8_t sprite_fetch_stall_cycles{0};
     // sprite_accumulated_offset;
@@ -142,17 +180,6 @@ class ppu {
     // part
     uint8_t sprite_compensation_offset{0};
 
-    // update ppu mode
-    void update_ppu_mode(ppu_mode mode);
-    uint16_t mode_change_ticks{0};
-    uint16_t ppu_total_ticks{0};
-
-    // lcd x position
-    uint8_t lcd_x{0};
-
-    // keep track of each scanline
-    void reset_scanline();
-
     // lcd was reset
     bool lcd_reset{false};
 
@@ -170,16 +197,6 @@ class ppu {
     uint8_t wx_ff4b{0};
     uint8_t wy_ff4a{0};
 
-    // vram
-    // bg_map_data_2 - 0x9C00 - 0x9FFF
-    uint8_t bg_map_data_2[(0x9fff - 0x9c00) + 1]{};
-    // bg_map_data_1 - 0x9800 - 0x9bff
-    uint8_t bg_map_data_1[(0x9bff - 0x9800) + 1]{};
-    // character ram - 0x8000 - 0x97ff
-    uint8_t character_ram[(0x97ff - 0x8000) + 1]{};
-    // oam ram - 0xfe00 - 0xfe9f
-    uint8_t oam_ram[(0xfe9f - 0xfe00) + 1]{};
-
     // oam and vram blocking
     bool oam_read_block{false};
     bool vram_read_block{false};
@@ -198,18 +215,48 @@ class ppu {
     bool dma_mode{false};
     bool dma_delay{false}; // delay dma start by one cycle
 
-    // pixel drawing
-    sf::Image lcd_frame_image{};
-    sf::Texture lcd_frame{};
+    // the rest, from a new cache line
+
+    struct video_memory {
+        // vram
+        // bg_map_data_2 - 0x9C00 - 0x9FFF
+        uint8_t bg_map_data_2[(0x9fff - 0x9c00) + 1]{};
+        // bg_map_data_1 - 0x9800 - 0x9bff
+        uint8_t bg_map_data_1[(0x9bff - 0x9800) + 1]{};
+        // character ram - 0x8000 - 0x97ff
+        uint8_t character_ram[(0x97ff - 0x8000) + 1]{};
+        // oam ram - 0xfe00 - 0xfe9f
+        uint8_t oam_ram[(0xfe9f - 0xfe00) + 1]{};
+    };
+    alignas(64) std::unique_ptr<video_memory> memory{};
+
+    // the arrays in memory, by their old names
+    uint8_t (&bg_map_data_2)[sizeof(video_memory::bg_map_data_2)];
+    uint8_t (&bg_map_data_1)[sizeof(video_memory::bg_map_data_1)];
+    uint8_t (&character_ram)[sizeof(video_memory::character_ram)];
+    uint8_t (&oam_ram)[sizeof(video_memory::oam_ram)];
 
-    sf::Color get_pixel_color(
-        uint8_t pixel,
-        uint8_t palette = 2); // 2 means get BGP (non sprite palette)
+    sf::RenderWindow &window;
+
+    // set by the mmu, oam dma writes oam in bulk and this brings it up to
+    // date before the oam scan reads it
+    std::function<void()> oam_dma_catch_up{};
+
+    // pixel drawing, the shade (0 - 3) of every lcd pixel row by row, 2 bits
+    // each, 4 to a byte from the low bits. draw::present() turns them into
+    // colors at vblank
+    static constexpr unsigned int lcd_width{160};
+    static constexpr unsigned int lcd_height{144};
+    std::array<uint8_t, lcd_width * lcd_height / 4> lcd_frame{};
+    uint8_t lcd_shade(const unsigned int x, const unsigned int y) const {
+        const unsigned int pixel = y * lcd_width + x;
+        return (this->lcd_frame[pixel / 4] >> (2 * (pixel % 4))) & 3;
+    }
 
   private:
-    // palette
-    const std::array<uint8_t, 3> color_palette_white{181, 175, 66};
-    const std::array<uint8_t, 3> color_palette_light_gray{145, 155, 58};
-    const std::array<uint8_t, 3> color_palette_dark_gray{93, 120, 46};
-    const std::array<uint8_t, 3> color_palette_black{58, 81, 34};
-};
+    // the stat interrupt line as the stat bits and ly make it
+    bool _stat_line() const;
+    // the next dot sets stat, the stat line and wy_condition to what they
+    // already are
+    bool _settled() const;
+};
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+void profiler::_charge() {
+    // the fetch M-cycle, already counted, belongs to the next instruction
+    const uint64_t charged = this->pending ? this->pending - 1 : 0;
+    this->pending -= charged;
+
+    const uint64_t key =
+        (static_cast<uint64_t>(this->stack.empty() ? 0
+                                                   : this->stack.back().node)
+         << 32) |
+        this->address;
+    this->cycles[key] += charged;
+    this->opcode_cycles[this->index] += charged;
+}
+
+void profiler::instruction(const uint16_t bank, const uint16_t pc,
+                           const uint16_t index, const uint16_t sp) {
+    this->_charge();
+    this->_pop(sp);
+
+    const uint32_t address = (bank << 16) | pc;
+    if (this->calling && pc != this->return_pc) {
+        const uint32_t parent =
+            this->stack.empty() ? 0 : this->stack.back().node;
+        const uint64_t key =
+            (static_cast<uint64_t>(this->call) << 32) | address;
+        uint32_t child{0};
+        const auto found = this->nodes[parent].children.find(key);
+        if (found != this->nodes[parent].children.end()) {
+            child = found->second;
+        } else {
+            child = static_cast<uint32_t>(this->nodes.size());
+            this->nodes[parent].children.emplace(key, child);
+            this->nodes.push_back(node{parent, this->call, address, {}});
+        }
+        this->stack.push_back(frame{child, sp});
+    }
+
+    this->address = address;
+    this->index = index;
+    this->opcode_count[index]++;
+
+    // call imm16, call cc,imm16 and rst
+    const uint8_t opcode = index & 0xff;
+    this->calling = index < 256 &&
+                    (opcode == 0xcd || (opcode & 0xe7) == 0xc4 ||
+                     (opcode & 0xc7) == 0xc7);
+    this->call = address;
+    this->return_pc = pc + ((opcode & 0xc7) == 0xc7 ? 1 : 3);
+}
+
+void profiler::cb_opcode(const uint8_t cb_opcode) {
+    this->opcode_count[this->index]--;
+    this->index = 256 + cb_opcode;
+    this->opcode_count[this->index]++;
+}
+
+void profiler::interrupt(const uint16_t sp) {
+    // a dispatch straight after a return comes before the next fetch
+    this->_pop(sp);
+    this->calling = true;
+    this->call = no_call;
+    this->return_pc = UINT32_MAX;
+}
+
+void profiler::_pop(const uint16_t sp) {
+    // returns (and anything else resetting the stack) leave sp above the
+    // return address of the calls they came out of
+    while (!this->stack.empty() && sp > this->stack.back().sp) {
+        this->stack.pop_back();
+    }
+}
+
+namespace {
+
+// rgbds symbols, global labels only (locals have a '.'), keyed by
+// bank << 16 | address. everything outside rom is bank 0
+std::map<uint32_t, std::string> load_symbols(const std::string &path) {
+    std::map<uint32_t, std::string> symbols{};
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        unsigned int bank{0};
+        unsigned int address{0};
+        char name[256]{};
+        if (line.empty() || line[0] == ';' ||
+            std::sscanf(line.c_str(), "%x:%x %255s", &bank, &address, name) !=
+                3 ||
+            std::string(name).find('.') != std::string::npos) {
+            continue;
+        }
+        if (address > 0x7fff) {
+            bank = 0;
+        }
+        symbols.emplace((bank << 16) | address, name);
+    }
+    return symbols;
+}
+
+std::string hex_address(const uint32_t address) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "%02x:%04x", address >> 16,
+                  address & 0xffff);
+    return text;
+}
+
+// the function address is in, the closest global label at or before it
+std::string function_name(const std::map<uint32_t, std::string> &symbols,
+                          const uint32_t address) {
+    auto found = symbols.upper_bound(address);
+    if (found == symbols.begin()) {
+        return hex_address(address);
+    }
+    --found;
+    if ((found->first >> 16) != (address >> 16)) {
+        return hex_address(address);
+    }
+    return found->second;
+}
+
+} // namespace
+
+void profiler::dump(const std::string &rom) {
+    this->_charge();
+
+    const std::size_t slash = rom.find_last_of("/\\");
+    const std::size_t dot = rom.find_last_of('.');
+    const std::string base =
+        dot != std::string::npos && (slash == std::string::npos || dot > slash)
+            ? rom.substr(0, dot)
+            : rom;
+
+    const std::map<uint32_t, std::string> symbols =
+        load_symbols(base + ".sym");
+
+    // frames are named after the function they called. with symbols the
+    // function each call was made from, and the instruction's own function,
+    // go in between when they tell apart (code reached with jp)
+    std::map<std::string, uint64_t> stacks{};
+    for (const auto &[key, m_cycles] : this->cycles) {
+        if (!m_cycles) {
+            continue;
+        }
+        std::vector<uint32_t> chain{};
+        for (uint32_t n = key >> 32; n != 0; n = this->nodes[n].parent) {
+            chain.push_back(n);
+        }
+        std::reverse(chain.begin(), chain.end());
+
+        std::vector<std::string> frames{"root"};
+        const auto add = [&frames](const std::string &name) {
+            if (name != frames.back()) {
+                frames.push_back(name);
+            }
+        };
+        for (const uint32_t n : chain) {
+            if (!symbols.empty() && this->nodes[n].call != no_call) {
+                add(function_name(symbols, this->nodes[n].call));
+            }
+            frames.push_back(function_name(symbols, this->nodes[n].address));
+        }
+        if (!symbols.empty()) {
+            add(function_name(symbols, static_cast<uint32_t>(key)));
+        }
+
+        std::string stack = frames.front();
+        for (std::size_t i = 1; i < frames.size(); ++i) {
+            stack += ';' + frames[i];
+        }
+        stacks[stack] += m_cycles;
+    }
+
+    std::ofstream folded(base + ".folded");
+    for (const auto &[stack, m_cycles] : stacks) {
+        folded << stack << ' ' << m_cycles << '\n';
+    }
+
+    // most M-cycles first
+    std::vector<uint16_t> order{};
+    for (uint16_t i = 0; i < 512; ++i) {
+        if (this->opcode_count[i]) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](uint16_t a, uint16_t b) {
+        return this->opcode_cycles[a] > this->opcode_cycles[b];
+    });
+
+    std::ofstream histogram(base + ".opcodes.txt");
+    histogram << "opcode       count     m-cycles\n";
+    for (const uint16_t i : order) {
+        char line[64];
+        std::snprintf(line, sizeof(line), "%s%02x %12llu %12llu\n",
+                      i >= 256 ? "cb " : "   ", i & 0xff,
+                      static_cast<unsigned long long>(this->opcode_count[i]),
+                      static_cast<unsigned long long>(this->opcode_cycles[i]));
+        histogram << line;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// guest code profiler (RICEBOY_PROFILER builds only). M-cycles are charged to
+// the instruction at (bank, pc) the cpu is running, under a shadow call stack
+// built from taken calls, rsts and interrupt dispatches. dump() aggregates
+// them into functions and writes collapsed stacks (flamegraph.pl, speedscope)
+// and an opcode histogram
+class profiler {
+  public:
+    // an instruction is fetched at pc, sp is the stack pointer at the fetch.
+    // index is the opcode, or 256 + the cb opcode
+    void instruction(const uint16_t bank, const uint16_t pc,
+                     const uint16_t index, const uint16_t sp);
+
+    // the instruction turned out to be cb prefixed (opcode fetched over the
+    // bus, the cb opcode comes one M-cycle later)
+    void cb_opcode(const uint8_t cb_opcode);
+
+    // an interrupt dispatch pushed PC, the next instruction is the handler.
+    // sp is the stack pointer before the push
+    void interrupt(const uint16_t sp);
+
+    // one M-cycle of the cpu
+    void cycle() { this->pending++; }
+
+    // M-cycles the cpu sat out in a halt or a polling loop, or ran a copy or
+    // fill loop in bulk
+    void idle(const uint32_t m_cycles) { this->pending += m_cycles; }
+
+    // write <rom>.folded and <rom>.opcodes.txt next to the rom, functions are
+    // named from <rom>.sym (rgbds) when there is one
+    void dump(const std::string &rom);
+
+  private:
+    // call tree, node 0 is the root. addresses are bank << 16 | pc of the
+    // call and of the first instruction called (no call for interrupts)
+    static constexpr uint32_t no_call{UINT32_MAX};
+    struct node {
+        uint32_t parent{0};
+        uint32_t call{no_call};
+        uint32_t address{0};
+        std::unordered_map<uint64_t, uint32_t> children{};
+    };
+    std::vector<node> nodes{node{}};
+
+    // frames on the shadow stack, popped once sp moves above the return
+    // address the call pushed
+    struct frame {
+        uint32_t node{0};
+        uint16_t sp{0};
+    };
+    std::vector<frame> stack{};
+
+    // the instruction being charged, and its M-cycles so far
+    uint32_t address{0};
+    uint16_t index{0};
+    uint64_t pending{0};
+
+    // the last instruction was a call or rst, it was taken if the next one is
+    // not at return_pc (always for interrupts)
+    bool calling{false};
+    uint32_t call{no_call};
+    uint32_t return_pc{0};
+
+    void _pop(const uint16_t sp);
+
+    // M-cycles per (call tree node << 32 | bank << 16 | pc)
+    std::unordered_map<uint64_t, uint64_t> cycles{};
+    std::array<uint64_t, 512> opcode_count{};
+    std::array<uint64_t, 512> opcode_cycles{};
+
+    void _charge();
+};
@@ -7,21 +7,24 @@ void timer::intialize_values() {
     this->ticks = 3;
 }
 
+uint8_t timer::_div_bit() const {
+    switch (this->tac_ff07 & 3) {
+    case 1: return 3;
+    case 2: return 5;
+    case 3: return 7;
+    }
+    return 9;
+}
+
 void timer::falling_edge() {
     // falling edge should be run on: write to div, write to tac, and increment
     // div TIMA increments in the case of a falling edge occuring
     uint8_t timer_enable_bit = (this->tac_ff07 & 4) >> 2;
-    uint8_t tac_freq_bit = tac_ff07 & 3;
 
-    assert(tac_freq_bit <= 3 && "tac freq bit abnormal!");
+    assert((tac_ff07 & 3) <= 3 && "tac freq bit abnormal!");
     assert(timer_enable_bit <= 1 && "tac timer bit abnormal!");
 
-    uint8_t div_bit{9};
-    switch (tac_freq_bit) {
-    case 1: div_bit = 3; break;
-    case 2: div_bit = 5; break;
-    case 3: div_bit = 7; break;
-    }
+    uint8_t div_bit = _div_bit();
 
     uint8_t div_state = ((this->sysclock >> div_bit) & 1) & (timer_enable_bit);
 
@@ -58,3 +61,70 @@ void timer::tick() {
         this->lock_tima_write = false;
     }
 }
+
+uint32_t timer::m_cycles_until_overflow() const {
+    if (this->tima_overflow || this->tima_overflow_standby) {
+        return 0;
+    }
+
+    if (!((this->tac_ff07 >> 2) & 1)) {
+        return UINT32_MAX; // disabled, tima never increments
+    }
+
+    // tima increments when the div bit falls, i.e. when sysclock reaches a
+    // multiple of the bit's period
+    const uint32_t period = 2u << _div_bit();
+    const uint32_t sysclock = this->sysclock;
+    if (this->last_div_state != ((sysclock >> _div_bit()) & 1)) {
+        return 0;
+    }
+
+    assert(sysclock % 4 == 0 && "sysclock is not M-cycle aligned!");
+
+    const uint32_t increments = 0x100 - this->tima_ff05;
+    const uint32_t overflow_at =
+        (sysclock / period + increments) * period; // the last falling edge
+    return (overflow_at - sysclock) / 4;
+}
+
+uint32_t timer::m_cycles_unchanged(const uint16_t address) const {
+    if (address == 0xff04) {
+        // div is the high byte of sysclock, each step adds 4
+        return (0xff - (this->sysclock & 0xff)) / 4;
+    }
+    if (address != 0xff05) {
+        return UINT32_MAX;
+    }
+
+    const uint32_t until = m_cycles_until_overflow();
+    if (until == 0 || until == UINT32_MAX) {
+        return until;
+    }
+    // the step before the next falling edge
+    const uint32_t period = 2u << _div_bit();
+    const uint32_t next = (this->sysclock / period + 1) * period;
+    return (next - this->sysclock) / 4 - 1;
+}
+
+void timer::skip(const uint32_t m_cycles) {
+    if (m_cycles == 0) {
+        return;
+    }
+
+    assert(m_cycles < m_cycles_until_overflow() &&
+           "skipping over a tima overflow!");
+
+    const uint8_t enabled = (this->tac_ff07 >> 2) & 1;
+    const uint32_t period = 2u << _div_bit();
+    const uint32_t from = this->sysclock;
+    const uint32_t to = from + m_cycles * 4;
+
+    if (enabled) {
+        this->tima_ff05 += static_cast<uint8_t>(to / period - from / period);
+    }
+
+    // sysclock wraps at a multiple of every period
+    this->sysclock = static_cast<uint16_t>(to);
+    this->last_div_state = ((this->sysclock >> _div_bit()) & 1) & enabled;
+    this->lock_tima_write = false;
+}
@@ -1,7 +1,8 @@
 #pragma once
 #include <cstdint>
 
-class timer {
+// all of it is per-tick state, kept to one cache line of its own
+class alignas(64) timer {
   public:
     uint16_t ticks{0};
     // initialize sysclock to be 4
@@ -21,4 +22,17 @@ class timer {
     void falling_edge();
 
     void intialize_values();
+
+    // M-cycle steps until one of them overflows tima (that step sets
+    // tima_overflow), 0 if it can't be computed (overflow in flight or the
+    // edge detector is out of sync), UINT32_MAX if the timer is disabled
+    uint32_t m_cycles_until_overflow() const;
+    // M-cycle steps that leave div (ff04) or tima (ff05) reading what it
+    // reads now, UINT32_MAX for any other address
+    uint32_t m_cycles_unchanged(const uint16_t address) const;
+    // do m_cycles steps at once, they must not overflow tima
+    void skip(const uint32_t m_cycles);
+
+  private:
+    uint8_t _div_bit() const;
 };
\ No newline at end of file
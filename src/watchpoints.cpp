@@ -0,0 +1,42 @@
+#include "watchpoints.h"
+
+void watchpoints::check(const uint16_t address, const uint16_t bank,
+                        const uint8_t value, const uint8_t access) {
+    bool stop{false};
+    bool covered{false};
+    for (const watchpoint &watch : this->list) {
+        if (!(watch.access & access) || address < watch.first ||
+            address > watch.last) {
+            continue;
+        }
+        if (watch.bank != any_bank &&
+            (address > 0x7fff || watch.bank != bank)) {
+            continue;
+        }
+        covered = true;
+        stop = stop || watch.stop;
+    }
+    if (!covered) {
+        return; // another address on a flagged page
+    }
+
+    // one hit per access, however many watchpoints cover it
+    if (this->hits.empty()) {
+        this->hits.resize(ring_size);
+    }
+    hit &entry = this->hits[this->hit_count % ring_size];
+    entry.cycle = this->clock ? *this->clock : 0;
+    entry.pc = this->pc ? *this->pc : 0;
+    entry.address = address;
+    entry.bank = bank;
+    entry.value = value;
+    entry.access = access;
+    this->hit_count++;
+
+    if (stop) {
+        this->stopped = true;
+        if (this->stop) {
+            this->stop();
+        }
+    }
+}
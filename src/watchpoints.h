@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// debugger watchpoints on the cpu's reads, writes and instruction fetches.
+// they are set through mmu::add_watchpoint(), which flags the pages they
+// cover: only accesses to flagged pages leave the fast paths and get checked
+// here, with none set nothing is checked at all
+class watchpoints {
+  public:
+    static constexpr uint8_t read{1};
+    static constexpr uint8_t write{2};
+    static constexpr uint8_t execute{4}; // an instruction starts there
+
+    // rom addresses in whichever bank is mapped
+    static constexpr uint16_t any_bank{0xffff};
+
+    struct watchpoint {
+        uint16_t first{0};
+        uint16_t last{0};
+        uint8_t access{0};       // read | write | execute
+        uint16_t bank{any_bank}; // rom addresses (0000 - 7fff) in this bank
+        bool stop{false};        // stop the run loop when hit
+    };
+    std::vector<watchpoint> list{};
+
+    struct hit {
+        uint64_t cycle{0}; // gameboy::clock, the M-cycle's start in fast mode
+        uint16_t pc{0};    // PC at the access (past the opcode for data)
+        uint16_t address{0};
+        uint16_t bank{0}; // rom bank for rom addresses, 0 anywhere else
+        uint8_t value{0}; // read, written or the opcode
+        uint8_t access{0};
+    };
+    // the last ring_size hits, hit n at hits[n % ring_size]. allocated with
+    // the first hit, instances that never watch anything don't carry it
+    static constexpr std::size_t ring_size{256};
+    std::vector<hit> hits{};
+    uint64_t hit_count{0};
+
+    // a stop watchpoint was hit, cleared by whoever looks at the hits
+    bool stopped{false};
+
+    // the owner's PC and clock for the hits, and how it stops its run loop
+    const uint16_t *pc{nullptr};
+    const uint64_t *clock{nullptr};
+    std::function<void()> stop{};
+
+    // an access to a flagged page, recorded if a watchpoint covers it
+    void check(const uint16_t address, const uint16_t bank,
+               const uint8_t value, const uint8_t access);
+};
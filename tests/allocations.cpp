@@ -0,0 +1,137 @@
+#include "../src/gameboy.h"
+#include "fixtures.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <memory>
+#include <new>
+#include <vector>
+
+// every allocation in this binary goes through here and is counted while
+// counting is set: plain, array and over-aligned (alignas types) new alike.
+// the block malloc returned is kept just below the aligned one for delete
+namespace {
+bool counting{false};
+std::size_t allocations{0};
+
+void *allocate(const std::size_t size, const std::size_t alignment) {
+    if (counting) {
+        allocations++;
+    }
+    void *base = std::malloc(size + alignment + sizeof(void *));
+    if (!base) {
+        throw std::bad_alloc();
+    }
+    std::uintptr_t start =
+        reinterpret_cast<std::uintptr_t>(base) + sizeof(void *);
+    start = (start + alignment - 1) & ~(std::uintptr_t{alignment} - 1);
+    reinterpret_cast<void **>(start)[-1] = base;
+    return reinterpret_cast<void *>(start);
+}
+
+void release(void *block) noexcept {
+    if (block) {
+        std::free(static_cast<void **>(block)[-1]);
+    }
+}
+} // namespace
+
+void *operator new(std::size_t size) {
+    return allocate(size, alignof(std::max_align_t));
+}
+void *operator new[](std::size_t size) {
+    return allocate(size, alignof(std::max_align_t));
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *block) noexcept { release(block); }
+void operator delete[](void *block) noexcept { release(block); }
+void operator delete(void *block, std::size_t) noexcept { release(block); }
+void operator delete[](void *block, std::size_t) noexcept { release(block); }
+void operator delete(void *block, std::align_val_t) noexcept {
+    release(block);
+}
+void operator delete[](void *block, std::align_val_t) noexcept {
+    release(block);
+}
+void operator delete(void *block, std::size_t, std::align_val_t) noexcept {
+    release(block);
+}
+void operator delete[](void *block, std::size_t, std::align_val_t) noexcept {
+    release(block);
+}
+
+sf::RenderWindow window(sf::VideoMode({160 * draw::SCALE, 144 * draw::SCALE}),
+                        "RiceBoy");
+
+namespace {
+
+constexpr uint32_t frame_t_cycles{70224};
+constexpr int frames{60};
+
+// allocations during frames frames of the loop program as a rom, after a
+// first frame to warm up. the lcd runs the background, the window and 40
+// sprites, 10 to a line (the oam scan sorts them), the timer runs too
+std::size_t frame_allocations(const gameboy::execution_mode mode) {
+    std::unique_ptr<gameboy> instance = boot_instance(loop_rom());
+    instance->mode = mode;
+
+    instance->gb_ppu.lcdc_ff40 |= 0x22; // window and sprites on
+    instance->gb_ppu.wx_ff4b = 87;
+    instance->gb_ppu.wy_ff4a = 72;
+    for (uint8_t sprite = 0; sprite < 40; ++sprite) {
+        // right to left, so the scan has to put them in order
+        instance->gb_ppu.oam_ram[sprite * 4] = 16 + (sprite % 4) * 30;
+        instance->gb_ppu.oam_ram[sprite * 4 + 1] = 160 - sprite * 4;
+    }
+    instance->gb_timer.tac_ff07 = 0xfd; // on, every 16 T-cycles
+
+    instance->run(frame_t_cycles);
+
+    allocations = 0;
+    counting = true;
+    for (int frame = 0; frame < frames; ++frame) {
+        instance->run(frame_t_cycles);
+    }
+    counting = false;
+    return allocations;
+}
+
+} // namespace
+
+// the counter sees every kind of new
+TEST(allocations, counted) {
+    struct alignas(64) wide {
+        uint8_t bytes[64];
+    };
+    allocations = 0;
+    counting = true;
+    void *volatile single = new uint8_t{0};
+    void *volatile array = new uint8_t[16];
+    void *volatile aligned = new wide{};
+    void *volatile aligned_array = new wide[2];
+    counting = false;
+
+    EXPECT_EQ(allocations, 4u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned_array) % 64, 0u);
+    delete static_cast<uint8_t *>(single);
+    delete[] static_cast<uint8_t *>(array);
+    delete static_cast<wide *>(aligned);
+    delete[] static_cast<wide *>(aligned_array);
+}
+
+TEST(allocations, accurate_frames) {
+    EXPECT_EQ(frame_allocations(gameboy::execution_mode::accurate), 0u);
+}
+
+TEST(allocations, fast_frames) {
+    EXPECT_EQ(frame_allocations(gameboy::execution_mode::fast), 0u);
+}
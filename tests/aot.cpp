@@ -0,0 +1,287 @@
+#include "../src/aot.h"
+#include "../src/aot_ops.h"
+#include "../src/cpu.h"
+#include "../src/gameboy.h"
+#include "../src/interrupt.h"
+#include "../src/mmu.h"
+#include "../src/ppu.h"
+#include "../src/timer.h"
+#include "fixtures.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <vector>
+using json = nlohmann::json;
+
+timer test_timer{};
+interrupt test_interrupt{};
+
+sf::RenderWindow window(sf::VideoMode({160 * draw::SCALE, 144 * draw::SCALE}),
+                        "RiceBoy");
+
+ppu test_ppu{test_interrupt, window};
+
+joypad test_joypad{};
+
+flat_mmu test_mmu{test_timer, test_interrupt, test_ppu, test_joypad};
+
+cpu test_cpu = cpu(test_mmu, test_timer, test_interrupt);
+
+namespace {
+
+using aot_ops::registers;
+
+// r[z] of the opcode, (hl) isn't register only
+uint8_t &r8(registers &r, const uint8_t z) {
+    switch (z) {
+    case 0: return r.B;
+    case 1: return r.C;
+    case 2: return r.D;
+    case 3: return r.E;
+    case 4: return r.H;
+    case 5: return r.L;
+    default: return r.A;
+    }
+}
+
+void alu(registers &r, const uint8_t y, const uint8_t value) {
+    switch (y) {
+    case 0: aot_ops::alu<aot_ops::add>(r, value); break;
+    case 1: aot_ops::alu<aot_ops::adc>(r, value); break;
+    case 2: aot_ops::alu<aot_ops::sub>(r, value); break;
+    case 3: aot_ops::alu<aot_ops::sbc>(r, value); break;
+    case 4: aot_ops::alu<aot_ops::logic_and>(r, value); break;
+    case 5: aot_ops::alu<aot_ops::logic_xor>(r, value); break;
+    case 6: aot_ops::alu<aot_ops::logic_or>(r, value); break;
+    default: aot_ops::alu<aot_ops::cp>(r, value); break;
+    }
+}
+
+uint8_t rot(registers &r, const uint8_t y, const uint8_t value) {
+    switch (y) {
+    case 0: return aot_ops::rot<aot_ops::rlc>(r, value);
+    case 1: return aot_ops::rot<aot_ops::rrc>(r, value);
+    case 2: return aot_ops::rot<aot_ops::rl>(r, value);
+    case 3: return aot_ops::rot<aot_ops::rr>(r, value);
+    case 4: return aot_ops::rot<aot_ops::sla>(r, value);
+    case 5: return aot_ops::rot<aot_ops::sra>(r, value);
+    case 6: return aot_ops::rot<aot_ops::swap>(r, value);
+    default: return aot_ops::rot<aot_ops::srl>(r, value);
+    }
+}
+
+// runs the opcode (256 + cb for cb opcodes) with aot_ops the way riceboy-aot
+// writes it, n is its immediate. false if it isn't one of theirs
+bool run_op(registers &r, const uint16_t index, const uint8_t n) {
+    const uint8_t opcode = index & 0xff;
+    const uint8_t x = opcode >> 6;
+    const uint8_t y = (opcode >> 3) & 7;
+    const uint8_t z = opcode & 7;
+
+    if (index >= 256) {
+        if (z == 6 || x > 1) {
+            return false; // (hl), res and set don't use aot_ops
+        }
+        if (x == 0) {
+            r8(r, z) = rot(r, y, r8(r, z));
+        } else {
+            aot_ops::bit(r, y, r8(r, z));
+        }
+        return true;
+    }
+
+    if (x == 2 && z != 6) {
+        alu(r, y, r8(r, z));
+    } else if (x == 3 && z == 6) {
+        alu(r, y, n);
+    } else if (x == 0 && z == 4 && y != 6) {
+        r8(r, y) = aot_ops::inc(r, r8(r, y));
+    } else if (x == 0 && z == 5 && y != 6) {
+        r8(r, y) = aot_ops::dec(r, r8(r, y));
+    } else if (x == 0 && z == 1 && y % 2 == 1) {
+        const uint16_t pairs[4]{r.BC, r.DE, r.HL, r.SP};
+        aot_ops::add_hl(r, pairs[y / 2]);
+    } else if (opcode == 0xe8) {
+        r.SP = aot_ops::add_sp(r, n);
+    } else if (opcode == 0xf8) {
+        r.HL = aot_ops::add_sp(r, n);
+    } else if (x == 0 && z == 7) {
+        switch (y) {
+        case 0: aot_ops::rot_a<aot_ops::rlc>(r); break;
+        case 1: aot_ops::rot_a<aot_ops::rrc>(r); break;
+        case 2: aot_ops::rot_a<aot_ops::rl>(r); break;
+        case 3: aot_ops::rot_a<aot_ops::rr>(r); break;
+        case 4: aot_ops::daa(r); break;
+        case 5: aot_ops::cpl(r); break;
+        case 6: aot_ops::scf(r); break;
+        default: aot_ops::ccf(r); break;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string vector_file(const uint16_t index) {
+    std::stringstream ss;
+    ss << "sm83/v1/" << (index >= 256 ? "cb " : "") << std::hex
+       << std::setfill('0') << std::setw(2) << (index & 0xff) << ".json";
+    return ss.str();
+}
+
+} // namespace
+
+class AotOpsTest : public testing::TestWithParam<uint16_t> {};
+
+// aot_ops against the cpu's handlers and the sm83 vectors
+TEST_P(AotOpsTest, opcode) {
+    const uint16_t index = GetParam();
+    registers probe{};
+    if (!run_op(probe, index, 0)) {
+        GTEST_SKIP() << "not written with aot_ops";
+    }
+
+    std::ifstream f(vector_file(index));
+    const json data = json::parse(f);
+    for (const json &test : data) {
+        load_state(test_mmu, test_cpu, test.at("initial"));
+
+        registers r{};
+        r.AF = test_cpu.AF;
+        r.BC = test_cpu.BC;
+        r.DE = test_cpu.DE;
+        r.HL = test_cpu.HL;
+        r.SP = test_cpu.SP;
+        run_op(r, index, test_mmu.memory[static_cast<uint16_t>(
+                             test_cpu.PC + 1)]);
+
+        test_cpu.identify_opcode(test_cpu._get(test_cpu.PC));
+        while (!test_cpu.M_operations.empty()) {
+            test_cpu.execute_M_operations();
+        }
+        test_cpu.sync_flags();
+
+        SCOPED_TRACE(test.at("name").get<std::string>());
+        EXPECT_EQ(r.AF, test_cpu.AF);
+        EXPECT_EQ(r.BC, test_cpu.BC);
+        EXPECT_EQ(r.DE, test_cpu.DE);
+        EXPECT_EQ(r.HL, test_cpu.HL);
+        EXPECT_EQ(r.SP, test_cpu.SP);
+
+        const json &final = test.at("final");
+        EXPECT_EQ(r.A, final.at("a"));
+        EXPECT_EQ(r.F, final.at("f").get<uint8_t>() & 0xf0);
+        EXPECT_EQ(r.B, final.at("b"));
+        EXPECT_EQ(r.C, final.at("c"));
+        EXPECT_EQ(r.D, final.at("d"));
+        EXPECT_EQ(r.E, final.at("e"));
+        EXPECT_EQ(r.H, final.at("h"));
+        EXPECT_EQ(r.L, final.at("l"));
+        EXPECT_EQ(r.SP, final.at("sp"));
+    }
+}
+
+std::string opcode_param_to_string(
+    const testing::TestParamInfo<AotOpsTest::ParamType> &info) {
+    std::stringstream ss;
+    ss << (info.param >= 256 ? "cb_" : "") << std::hex << std::setfill('0')
+       << std::setw(2) << (info.param & 0xff);
+    return ss.str();
+}
+
+INSTANTIATE_TEST_SUITE_P(aot, AotOpsTest, testing::Range<uint16_t>(0, 512),
+                         opcode_param_to_string);
+
+// riceboy-aot --emit-only on a small rom writes the blocks it reaches and
+// builds nothing
+TEST(riceboy_aot, emit_only) {
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / "riceboy_aot_emit_only";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path rom = directory / "small.gb";
+
+    // halts everywhere but 0100: nop; jp 0150 and 0150: ld a, 1; add a, b;
+    // inc c; jr 0150
+    std::vector<char> bytes(0x8000, 0x76);
+    const uint8_t entry[]{0x00, 0xc3, 0x50, 0x01};
+    const uint8_t loop[]{0x3e, 0x01, 0x80, 0x0c, 0x18, 0xfa};
+    std::copy(std::begin(entry), std::end(entry), bytes.begin() + 0x100);
+    std::copy(std::begin(loop), std::end(loop), bytes.begin() + 0x150);
+    std::ofstream(rom, std::ios::binary).write(bytes.data(), bytes.size());
+
+    const std::string command = std::string("\"") + RICEBOY_AOT_TOOL +
+                                "\" \"" + rom.string() + "\" --emit-only";
+    ASSERT_EQ(std::system(command.c_str()), 0);
+
+    const std::filesystem::path plugin = aot::plugin_path(rom.string());
+    std::ifstream source(plugin.parent_path() /
+                         (plugin.stem().string() + ".cpp"));
+    ASSERT_TRUE(source);
+    const std::string text((std::istreambuf_iterator<char>(source)),
+                           std::istreambuf_iterator<char>());
+    EXPECT_NE(text.find("riceboy_aot_entry_count = 2;"), std::string::npos);
+    EXPECT_NE(text.find("{0x00, 0x0100, 2, block_00_0100},"),
+              std::string::npos);
+    EXPECT_NE(text.find("{0x00, 0x0150, 4, block_00_0150},"),
+              std::string::npos);
+    EXPECT_NE(text.find("alu<add>(*r, r->B);"), std::string::npos);
+    EXPECT_FALSE(std::filesystem::exists(plugin));
+
+    std::filesystem::remove_all(directory);
+}
+
+#ifdef RICEBOY_AOT
+// a timer interrupt coming in while a plugin block runs is taken at the same
+// instruction as in the interpreter, not once the block is done, in both
+// modes
+TEST(riceboy_aot, interrupt_in_block) {
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / "riceboy_aot_interrupt";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path rom = directory / "interrupted.gb";
+    const std::vector<char> bytes = rom_with(interrupted_loop_program());
+    std::ofstream(rom, std::ios::binary).write(bytes.data(), bytes.size());
+
+    const std::string command =
+        std::string("\"") + RICEBOY_AOT_TOOL + "\" \"" + rom.string() + "\"";
+    ASSERT_EQ(std::system(command.c_str()), 0);
+    ASSERT_TRUE(std::filesystem::exists(aot::plugin_path(rom.string())));
+
+    for (const gameboy::execution_mode mode :
+         {gameboy::execution_mode::accurate, gameboy::execution_mode::fast}) {
+        SCOPED_TRACE(mode == gameboy::execution_mode::fast ? "fast"
+                                                           : "accurate");
+        // load_rom() picks up the plugin, load_cartridge() alone doesn't
+        std::unique_ptr<gameboy> compiled = std::make_unique<gameboy>(window);
+        compiled->gb_cpu.prepare_rom(rom.string());
+        compiled->gb_cpu.load_rom();
+        compiled->skip_bootrom();
+        std::unique_ptr<gameboy> interpreted = boot_instance(bytes);
+        compiled->mode = mode;
+        interpreted->mode = mode;
+        compiled->run(20000);
+        interpreted->run(20000);
+
+        // taken between inc b and inc c
+        EXPECT_EQ(interpreted->gb_cpu.PC, 0x0058);
+        EXPECT_NE(interpreted->gb_mmu.read_memory(0xc000),
+                  interpreted->gb_mmu.read_memory(0xc001));
+
+        EXPECT_EQ(compiled->gb_cpu.PC, 0x0058);
+        EXPECT_EQ(compiled->gb_mmu.read_memory(0xc000),
+                  interpreted->gb_mmu.read_memory(0xc000));
+        EXPECT_EQ(compiled->gb_mmu.read_memory(0xc001),
+                  interpreted->gb_mmu.read_memory(0xc001));
+    }
+
+    std::filesystem::remove_all(directory);
+}
+#endif
@@ -0,0 +1,143 @@
+#include "../src/batch_lanes.h"
+#include "../src/cpu.h"
+#include "../src/interrupt.h"
+#include "../src/mmu.h"
+#include "../src/ppu.h"
+#include "../src/timer.h"
+#include "fixtures.h"
+#include <array>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+// the lane kernels against each other and the cpu, for every lane opcode on
+// every A, operand and carry
+
+timer test_timer{};
+interrupt test_interrupt{};
+
+sf::RenderWindow window(sf::VideoMode({160 * draw::SCALE, 144 * draw::SCALE}),
+                        "RiceBoy");
+
+ppu test_ppu{test_interrupt, window};
+
+joypad test_joypad{};
+
+flat_mmu test_mmu{test_timer, test_interrupt, test_ppu, test_joypad};
+
+cpu test_cpu = cpu(test_mmu, test_timer, test_interrupt);
+
+namespace {
+
+// lane a * 2 + c starts with A = a and the carry c, z, n and h come from a's
+// low bits so the flags an opcode keeps are checked too
+constexpr std::size_t lanes{512};
+
+// B, C, D, E, H, L, (hl) unused, A and F of every lane
+struct lane_state {
+    std::array<std::vector<uint8_t>, 8> r8{};
+    std::vector<uint8_t> f{};
+
+    explicit lane_state(const uint8_t operand) {
+        for (std::vector<uint8_t> &r : this->r8) {
+            r.assign(lanes, operand);
+        }
+        this->f.assign(lanes, 0);
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            const uint8_t a = lane / 2;
+            this->r8[7][lane] = a;
+            this->f[lane] = ((a & 7) << 5) | ((lane % 2) << 4);
+        }
+    }
+
+    lane_registers registers(const std::vector<uint8_t> &mask) {
+        return {{this->r8[0].data(), this->r8[1].data(), this->r8[2].data(),
+                 this->r8[3].data(), this->r8[4].data(), this->r8[5].data(),
+                 nullptr, this->r8[7].data()},
+                this->f.data(),
+                mask.data(),
+                lanes};
+    }
+};
+
+std::vector<uint8_t> lane_opcodes() {
+    std::vector<uint8_t> opcodes{};
+    for (unsigned int opcode = 0; opcode < 256; ++opcode) {
+        if (lane_opcode(opcode)) {
+            opcodes.push_back(opcode);
+        }
+    }
+    return opcodes;
+}
+
+} // namespace
+
+class LaneTest : public testing::TestWithParam<uint8_t> {};
+
+TEST_P(LaneTest, kernels) {
+    const uint8_t opcode = GetParam();
+    const std::vector<uint8_t> mask(lanes, 0xff);
+#ifdef RICEBOY_BATCH_AVX2
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    test_mmu.memory[0x0100] = opcode;
+    for (unsigned int operand = 0; operand < 256; ++operand) {
+        test_mmu.memory[0x0101] = operand;
+
+        lane_state scalar(operand);
+        lane_execute_scalar(scalar.registers(mask), opcode, operand);
+
+#ifdef RICEBOY_BATCH_AVX2
+        if (avx2) {
+            lane_state wide(operand);
+            lane_execute_avx2(wide.registers(mask), opcode, operand);
+            ASSERT_EQ(wide.r8, scalar.r8) << "operand " << operand;
+            ASSERT_EQ(wide.f, scalar.f) << "operand " << operand;
+        }
+#endif
+
+        const lane_state initial(operand);
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            test_cpu.B = initial.r8[0][lane];
+            test_cpu.C = initial.r8[1][lane];
+            test_cpu.D = initial.r8[2][lane];
+            test_cpu.E = initial.r8[3][lane];
+            test_cpu.H = initial.r8[4][lane];
+            test_cpu.L = initial.r8[5][lane];
+            test_cpu.A = initial.r8[7][lane];
+            test_cpu.sync_flags(); // drop flags left pending by the last lane
+            test_cpu.F = initial.f[lane];
+            test_cpu.PC = 0x0100;
+
+            test_cpu.identify_opcode(test_cpu._get(test_cpu.PC));
+            while (!test_cpu.M_operations.empty()) {
+                test_cpu.execute_M_operations();
+            }
+            test_cpu.sync_flags();
+
+            const std::array<uint8_t, 9> expected{
+                test_cpu.B, test_cpu.C, test_cpu.D, test_cpu.E, test_cpu.H,
+                test_cpu.L, 0,          test_cpu.A, test_cpu.F};
+            const std::array<uint8_t, 9> actual{
+                scalar.r8[0][lane], scalar.r8[1][lane], scalar.r8[2][lane],
+                scalar.r8[3][lane], scalar.r8[4][lane], scalar.r8[5][lane],
+                0,                  scalar.r8[7][lane], scalar.f[lane]};
+            ASSERT_EQ(actual, expected)
+                << "operand " << operand << " lane " << lane;
+            ASSERT_EQ(test_cpu.PC, 0x0100 + lane_opcode_length(opcode));
+        }
+    }
+}
+
+std::string opcode_param_to_string(
+    const testing::TestParamInfo<LaneTest::ParamType> &info) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0') << std::setw(2)
+       << static_cast<int>(info.param);
+    return ss.str();
+}
+
+INSTANTIATE_TEST_SUITE_P(batch, LaneTest, testing::ValuesIn(lane_opcodes()),
+                         opcode_param_to_string);
@@ -0,0 +1,144 @@
+#pragma once
+#include "../src/cpu.h"
+#include "../src/gameboy.h"
+#include "../src/interrupt.h"
+#include "../src/mmu.h"
+#include "../src/ppu.h"
+#include "../src/timer.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// what the test and benchmark binaries share
+
+// each binary defines the window its ppus draw to
+extern sf::RenderWindow window;
+
+// flat 64 KiB memory, code is fetched from it too
+class flat_mmu : public mmu {
+  public:
+    flat_mmu(timer &gb_timer, interrupt &gb_interrupt, ppu &gb_ppu,
+             joypad &gb_joypad)
+        : mmu(gb_timer, gb_interrupt, gb_ppu, gb_joypad) {
+        this->map_flat(0x0000, sizeof(this->memory), this->memory,
+                       this->memory);
+    };
+
+    uint8_t memory[0x10000]{};
+};
+
+// an sm83 vector's "initial" state: its ram into memory, its registers into
+// the cpu. a template so binaries without nlohmann::json can include this
+template <typename json>
+void load_state(flat_mmu &memory, cpu &test_cpu, const json &state) {
+    for (const json &byte : state.at("ram")) {
+        memory.memory[byte[0].template get<uint16_t>()] =
+            byte[1].template get<uint8_t>();
+    }
+    test_cpu.PC = state.at("pc");
+    test_cpu.SP = state.at("sp");
+    test_cpu.A = state.at("a");
+    test_cpu.B = state.at("b");
+    test_cpu.C = state.at("c");
+    test_cpu.D = state.at("d");
+    test_cpu.E = state.at("e");
+    test_cpu.H = state.at("h");
+    test_cpu.L = state.at("l");
+    test_cpu.sync_flags(); // drop flags left pending by the last test
+    test_cpu.F = state.at("f").template get<uint8_t>() & 0xf0;
+}
+
+// code at its address in a rom, the rest is nop
+using code = std::vector<std::pair<uint16_t, std::vector<uint8_t>>>;
+
+// a 32 KiB rom without an mbc holding the program
+inline std::vector<char> rom_with(const code &program) {
+    std::vector<char> rom(0x8000);
+    for (const std::pair<uint16_t, std::vector<uint8_t>> &part : program) {
+        std::copy(part.second.begin(), part.second.end(),
+                  rom.begin() + part.first);
+    }
+    return rom;
+}
+
+// an instance with the rom loaded and the boot rom marked done, nothing else
+// set up
+inline std::unique_ptr<gameboy>
+load_instance(const std::vector<char> &rom = std::vector<char>(0x8000)) {
+    std::unique_ptr<gameboy> instance = std::make_unique<gameboy>(window);
+    instance->gb_mmu.load_cartridge(rom.data(), rom.size());
+    instance->gb_mmu.set_load_rom_complete();
+    return instance;
+}
+
+// an instance with the rom loaded, in the state the boot rom leaves behind
+inline std::unique_ptr<gameboy> boot_instance(const std::vector<char> &rom) {
+    std::unique_ptr<gameboy> instance = std::make_unique<gameboy>(window);
+    instance->gb_mmu.load_cartridge(rom.data(), rom.size());
+    instance->skip_bootrom();
+    return instance;
+}
+
+// cpu bound loop: loads, alu, cb, stack, call/ret and relative jumps
+inline constexpr std::array<uint8_t, 0x26> loop_program{
+    0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+    0x21, 0x00, 0xc0, // 0103: ld hl, c000
+    0x7e,             // 0106: ld a, (hl)
+    0x80,             // 0107: add a, b
+    0x22,             // 0108: ld (hl+), a
+    0x04,             // 0109: inc b
+    0xa9,             // 010a: xor c
+    0x4f,             // 010b: ld c, a
+    0xcb, 0x11,       // 010c: rl c
+    0xc5,             // 010e: push bc
+    0xd1,             // 010f: pop de
+    0xcd, 0x20, 0x01, // 0110: call 0120
+    0x26, 0xc0,       // 0113: ld h, c0
+    0x18, 0xef,       // 0115: jr 0106
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xfe, 0x80, // 0120: cp 80
+    0x30, 0x01, // 0122: jr nc, 0125
+    0x3c,       // 0124: inc a
+    0xc9,       // 0125: ret
+};
+
+// loop_program at 0100 of a 32 KiB rom without an mbc
+inline std::vector<char> loop_rom() {
+    std::vector<char> rom(0x8000);
+    std::copy(loop_program.begin(), loop_program.end(), rom.begin() + 0x0100);
+    return rom;
+}
+
+// a register only loop at 0150 (inc b, 20 nops, inc c) the timer interrupts
+// after 4096 T-cycles. the handler stores B and C to c000 and c001 and stays
+// at 0058, B is ahead of C if it came in between the two
+inline code interrupted_loop_program() {
+    std::vector<uint8_t> loop{0x04};             // 0150: inc b
+    loop.insert(loop.end(), 20, 0x00);           // 0151: nop (20)
+    loop.insert(loop.end(), {0x0c, 0x18, 0xe8}); // 0165: inc c, jr 0150
+    return {
+        {0x0050,
+         {
+             0x78,             // 0050: ld a, b
+             0xea, 0x00, 0xc0, // 0051: ld (c000), a
+             0x79,             // 0054: ld a, c
+             0xea, 0x01, 0xc0, // 0055: ld (c001), a
+             0x18, 0xfe,       // 0058: jr 0058
+         }},
+        {0x0100,
+         {
+             0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+             0x3e, 0x04,       // 0103: ld a, 04
+             0xe0, 0xff,       // 0105: ldh (ff), a, timer
+             0x3e, 0x05,       // 0107: ld a, 05
+             0xe0, 0x07,       // 0109: ldh (07), a, every 16 T-cycles
+             0x01, 0x00, 0x00, // 010b: ld bc, 0000
+             0xfb,             // 010e: ei
+             0xc3, 0x50, 0x01, // 010f: jp 0150
+         }},
+        {0x0150, loop},
+    };
+}
@@ -0,0 +1,116 @@
+#include "../src/gameboy.h"
+#include "fixtures.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+// the i/o handler table (ff00 - ff7f): what each register reads back after a
+// write, the bits that always read 1 and the boot rom disable
+
+namespace {
+
+bool unused(const uint16_t address) {
+    return address == 0xff03 || (address >= 0xff08 && address <= 0xff0e) ||
+           address == 0xff15 || address == 0xff1f ||
+           (address >= 0xff27 && address <= 0xff2f) ||
+           (address >= 0xff4d && address != 0xff50);
+}
+
+} // namespace
+
+// unused registers read 0xff whatever is written, the plain bytes (serial,
+// apu, wave ram) read back what was
+TEST(io, unused_and_plain) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    for (uint16_t address = 0xff00; address <= 0xff7f; ++address) {
+        if (!unused(address) && address != 0xff01 && address != 0xff02 &&
+            (address < 0xff10 || address > 0xff3f)) {
+            continue; // claimed
+        }
+        for (const uint8_t value : {0x00, 0x5a, 0xff}) {
+            gb_mmu.bus_write_memory(address, value);
+            ASSERT_EQ(gb_mmu.bus_read_memory(address),
+                      unused(address) ? 0xff : value)
+                << std::hex << address;
+            ASSERT_EQ(gb_mmu.read_memory(address),
+                      unused(address) ? 0xff : value)
+                << std::hex << address;
+        }
+    }
+}
+
+// registers with unused bits, and ly which drops writes
+TEST(io, masks) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    gb_mmu.write_memory(0xff0f, 0x00);
+    EXPECT_EQ(gb_mmu.read_memory(0xff0f), 0xe0);
+    EXPECT_EQ(instance->gb_interrupt.interrupt_flags, 0x00);
+    gb_mmu.write_memory(0xff0f, 0x15);
+    EXPECT_EQ(gb_mmu.read_memory(0xff0f), 0xf5);
+    EXPECT_EQ(instance->gb_interrupt.interrupt_flags, 0x15);
+
+    const uint8_t ly = gb_mmu.read_memory(0xff44);
+    gb_mmu.write_memory(0xff44, ly + 1);
+    EXPECT_EQ(gb_mmu.read_memory(0xff44), ly);
+
+    // registers that store what's written
+    for (const uint16_t address :
+         {0xff06, 0xff42, 0xff43, 0xff45, 0xff47, 0xff48, 0xff49, 0xff4a,
+          0xff4b}) {
+        gb_mmu.bus_write_memory(address, 0xa5);
+        EXPECT_EQ(gb_mmu.bus_read_memory(address), 0xa5) << std::hex << address;
+    }
+}
+
+// ff50 sticks at 0xff once anything is written, even 0
+TEST(io, boot_rom_disable) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    EXPECT_EQ(gb_mmu.read_memory(0xff50), 0x00);
+    gb_mmu.write_memory(0xff50, 0x01);
+    EXPECT_EQ(gb_mmu.read_memory(0xff50), 0xff);
+    gb_mmu.write_memory(0xff50, 0x00);
+    EXPECT_EQ(gb_mmu.read_memory(0xff50), 0xff);
+    gb_mmu.bus_write_memory(0xff50, 0x00);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xff50), 0xff);
+}
+
+// a register claimed with map_io gets every access, its unused bits read 1
+TEST(io, map_io) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    static uint8_t serial{0};
+    static unsigned int writes{0};
+    gb_mmu.map_io(
+        0xff02,
+        [](const mmu &, const uint16_t address) -> uint8_t {
+            EXPECT_EQ(address, 0xff02);
+            return serial;
+        },
+        [](mmu &, const uint16_t address, const uint8_t value) {
+            EXPECT_EQ(address, 0xff02);
+            serial = value;
+            writes++;
+        },
+        0x7e);
+
+    gb_mmu.bus_write_memory(0xff02, 0x81);
+    gb_mmu.write_memory(0xff02, 0x01);
+    EXPECT_EQ(writes, 2);
+    EXPECT_EQ(serial, 0x01);
+    EXPECT_EQ(gb_mmu.read_memory(0xff02), 0x7f);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xff02), 0x7f);
+
+    // back to a plain byte
+    gb_mmu.map_io(0xff02, nullptr, nullptr);
+    gb_mmu.write_memory(0xff02, 0x42);
+    EXPECT_EQ(gb_mmu.read_memory(0xff02), 0x42);
+    EXPECT_EQ(serial, 0x01);
+}
@@ -0,0 +1,204 @@
+#include "../src/cpu.h"
+#include "../src/gameboy.h"
+#include "../src/interrupt.h"
+#include "../src/jit.h"
+#include "../src/mmu.h"
+#include "../src/ppu.h"
+#include "../src/timer.h"
+#include "fixtures.h"
+#include "opcodes.h" // import all opcodes
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <vector>
+using json = nlohmann::json;
+
+// every opcode the jit compiles, run as a block of its own and through the
+// interpreter from each sm83 vector's initial state
+
+timer test_timer{};
+interrupt test_interrupt{};
+
+sf::RenderWindow window(sf::VideoMode({160 * draw::SCALE, 144 * draw::SCALE}),
+                        "RiceBoy");
+
+ppu test_ppu{test_interrupt, window};
+
+joypad test_joypad{};
+
+flat_mmu test_mmu{test_timer, test_interrupt, test_ppu, test_joypad};
+
+cpu interpreted = cpu(test_mmu, test_timer, test_interrupt);
+cpu compiled = cpu(test_mmu, test_timer, test_interrupt);
+
+jit native{};
+
+class JitTest : public testing::TestWithParam<uint8_t> {
+  public:
+    json data{};
+    // M-cycles as the block cache decodes them: branch taken
+    uint8_t m_cycles{0};
+
+    void SetUp() override {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0') << std::setw(2)
+           << static_cast<int>(GetParam());
+        std::ifstream f("sm83/v1/" + ss.str() + ".json");
+        this->data = json::parse(f);
+
+        for (const json &test : this->data) {
+            this->m_cycles = std::max<uint8_t>(this->m_cycles,
+                                               test.at("cycles").size());
+        }
+    }
+};
+
+TEST_P(JitTest, block) {
+    const uint8_t opcode = GetParam();
+    const uint8_t length = cpu::instruction_length(opcode);
+    bool compiles{false};
+
+    for (const json &test : this->data) {
+        load_state(test_mmu, interpreted, test.at("initial"));
+        load_state(test_mmu, compiled, test.at("initial"));
+        const uint16_t pc = compiled.PC;
+
+        // immediates must not cross into the next bank, the jit leaves those
+        // to the interpreter
+        if ((pc >> 14) != ((pc + length - 1) >> 14)) {
+            continue;
+        }
+
+        block_cache::decoded_block decoded{};
+        decoded.instructions.push_back(
+            {pc, opcode, opcode, length, this->m_cycles});
+        block_cache::block block{};
+        block.decoded = &decoded;
+        native.flush();
+        ASSERT_TRUE(native.compile(compiled, block, 0));
+        if (!block.native) {
+            // not compiled, interpreter only
+            ASSERT_FALSE(compiles) << test.at("name");
+            GTEST_SKIP();
+        }
+        compiles = true;
+        ASSERT_EQ(block.native_length, 1);
+
+        // interpreter, counting the fetch
+        uint8_t cycles{1};
+        interpreted.identify_opcode(interpreted._get(interpreted.PC));
+        while (!interpreted.M_operations.empty()) {
+            interpreted.execute_M_operations();
+            cycles++;
+        }
+        interpreted.sync_flags();
+
+        const uint8_t native_cycles =
+            reinterpret_cast<jit::block_function>(block.native)(&compiled);
+        compiled.sync_flags();
+
+        SCOPED_TRACE(test.at("name").get<std::string>());
+        EXPECT_EQ(native_cycles, cycles);
+        EXPECT_EQ(native_cycles, test.at("cycles").size());
+        EXPECT_EQ(compiled.PC, interpreted.PC);
+        EXPECT_EQ(compiled.SP, interpreted.SP);
+        EXPECT_EQ(compiled.A, interpreted.A);
+        EXPECT_EQ(compiled.F, interpreted.F);
+        EXPECT_EQ(compiled.B, interpreted.B);
+        EXPECT_EQ(compiled.C, interpreted.C);
+        EXPECT_EQ(compiled.D, interpreted.D);
+        EXPECT_EQ(compiled.E, interpreted.E);
+        EXPECT_EQ(compiled.H, interpreted.H);
+        EXPECT_EQ(compiled.L, interpreted.L);
+
+        const json &final = test.at("final");
+        EXPECT_EQ(compiled.PC, final.at("pc"));
+        EXPECT_EQ(compiled.SP, final.at("sp"));
+        EXPECT_EQ(compiled.A, final.at("a"));
+        EXPECT_EQ(compiled.F, final.at("f").get<uint8_t>() & 0xf0);
+        EXPECT_EQ(compiled.B, final.at("b"));
+        EXPECT_EQ(compiled.C, final.at("c"));
+        EXPECT_EQ(compiled.D, final.at("d"));
+        EXPECT_EQ(compiled.E, final.at("e"));
+        EXPECT_EQ(compiled.H, final.at("h"));
+        EXPECT_EQ(compiled.L, final.at("l"));
+    }
+}
+
+std::string opcode_param_to_string(
+    const testing::TestParamInfo<JitTest::ParamType> &info) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0') << std::setw(2)
+       << static_cast<int>(info.param);
+    return ss.str();
+}
+
+INSTANTIATE_TEST_SUITE_P(jit, JitTest, testing::ValuesIn(opcodes),
+                         opcode_param_to_string);
+
+#ifdef __linux__
+// the code buffer is never writable and executable at once
+TEST(jit, w_xor_x) {
+    test_mmu.memory[0x0100] = 0x3c; // inc a
+    compiled.PC = 0x0100;
+    compiled.A = 0x41;
+    block_cache::decoded_block decoded{};
+    decoded.instructions.push_back({0x0100, 0x3c, 0x3c, 1, 1});
+    block_cache::block block{};
+    block.decoded = &decoded;
+    native.flush();
+    ASSERT_TRUE(native.compile(compiled, block, 0));
+    ASSERT_NE(block.native, nullptr);
+    EXPECT_EQ(reinterpret_cast<jit::block_function>(block.native)(&compiled),
+              1);
+    EXPECT_EQ(compiled.A, 0x42);
+
+    std::ifstream maps("/proc/self/maps");
+    std::string line{};
+    while (std::getline(maps, line)) {
+        std::istringstream fields(line);
+        std::string range{};
+        std::string permissions{};
+        fields >> range >> permissions;
+        EXPECT_NE(permissions.substr(0, 3), "rwx") << line;
+    }
+}
+#endif
+
+// a timer interrupt coming in while a hot block runs is taken at the same
+// instruction as in the interpreter, not once the block is done, in both
+// modes. the loop runs through the jit, the same rom with an execute
+// watchpoint on its page only through the interpreter
+TEST(jit, interrupt_in_block) {
+    const std::vector<char> rom = rom_with(interrupted_loop_program());
+    for (const gameboy::execution_mode mode :
+         {gameboy::execution_mode::accurate, gameboy::execution_mode::fast}) {
+        SCOPED_TRACE(mode == gameboy::execution_mode::fast ? "fast"
+                                                           : "accurate");
+        std::unique_ptr<gameboy> jitted = boot_instance(rom);
+        std::unique_ptr<gameboy> interpreted = boot_instance(rom);
+        jitted->mode = mode;
+        interpreted->mode = mode;
+        interpreted->gb_mmu.add_watchpoint(
+            {0x01ff, 0x01ff, watchpoints::execute});
+        jitted->run(20000);
+        interpreted->run(20000);
+
+        // taken between inc b and inc c
+        EXPECT_EQ(interpreted->gb_cpu.PC, 0x0058);
+        EXPECT_NE(interpreted->gb_mmu.read_memory(0xc000),
+                  interpreted->gb_mmu.read_memory(0xc001));
+
+        EXPECT_EQ(jitted->gb_cpu.PC, 0x0058);
+        EXPECT_EQ(jitted->gb_mmu.read_memory(0xc000),
+                  interpreted->gb_mmu.read_memory(0xc000));
+        EXPECT_EQ(jitted->gb_mmu.read_memory(0xc001),
+                  interpreted->gb_mmu.read_memory(0xc001));
+        EXPECT_EQ(jitted->gb_cpu.SP, interpreted->gb_cpu.SP);
+    }
+}
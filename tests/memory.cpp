@@ -0,0 +1,217 @@
+#include "../src/gameboy.h"
+#include "fixtures.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// the page table against what each area of the address space does: echo ram,
+// the unusable area, hram, ie, the rom banks an mbc switches in and what oam
+// dma holds
+
+// e000 - fdff is c000 - ddff, both ways and through both paths
+TEST(memory, echo_ram) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    for (uint32_t address = 0xc000; address <= 0xddff; ++address) {
+        gb_mmu.write_memory(address, static_cast<uint8_t>(address * 3));
+    }
+    for (uint32_t address = 0xe000; address <= 0xfdff; ++address) {
+        ASSERT_EQ(gb_mmu.read_memory(address),
+                  static_cast<uint8_t>((address - 0x2000) * 3))
+            << std::hex << address;
+        ASSERT_EQ(gb_mmu.bus_read_memory(address),
+                  static_cast<uint8_t>((address - 0x2000) * 3))
+            << std::hex << address;
+    }
+
+    // writes to echo ram land in wram, and decode the wram page again
+    const uint32_t version = gb_mmu.page_versions[0xd1];
+    gb_mmu.bus_write_memory(0xf123, 0x5a);
+    EXPECT_EQ(gb_mmu.read_memory(0xd123), 0x5a);
+    gb_mmu.write_memory(0xfdff, 0xa5);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xddff), 0xa5);
+    EXPECT_EQ(gb_mmu.page_versions[0xd1], version + 1);
+
+    // de00 - dfff isn't mirrored, fe00 is oam
+    gb_mmu.write_memory(0xde00, 0x77);
+    EXPECT_EQ(gb_mmu.read_memory(0xfe00), 0);
+    EXPECT_EQ(instance->gb_ppu.oam_ram[0], 0);
+}
+
+// fea0 - feff reads 0 and drops writes, oam below it is still oam
+TEST(memory, unusable) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    for (uint32_t address = 0xfea0; address <= 0xfeff; ++address) {
+        gb_mmu.write_memory(address, 0xff);
+        gb_mmu.bus_write_memory(address, 0xff);
+        ASSERT_EQ(gb_mmu.read_memory(address), 0) << std::hex << address;
+        ASSERT_EQ(gb_mmu.bus_read_memory(address), 0) << std::hex << address;
+    }
+
+    gb_mmu.write_memory(0xfe9f, 0x42);
+    EXPECT_EQ(instance->gb_ppu.oam_ram[0x9f], 0x42);
+    EXPECT_EQ(gb_mmu.read_memory(0xfe9f), 0x42);
+}
+
+// hram is mapped, i/o next to it and ie after it keep their handlers
+TEST(memory, high_page) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+
+    const uint32_t version = gb_mmu.page_versions[0xff];
+    for (uint32_t address = 0xff80; address <= 0xfffe; ++address) {
+        gb_mmu.bus_write_memory(address, static_cast<uint8_t>(address ^ 0x5a));
+    }
+    EXPECT_EQ(gb_mmu.page_versions[0xff], version + 0x7f);
+    for (uint32_t address = 0xff80; address <= 0xfffe; ++address) {
+        ASSERT_EQ(gb_mmu.read_memory(address),
+                  static_cast<uint8_t>(address ^ 0x5a))
+            << std::hex << address;
+        ASSERT_EQ(gb_mmu.bus_read_memory(address),
+                  static_cast<uint8_t>(address ^ 0x5a))
+            << std::hex << address;
+    }
+
+    // ie, only the low 5 bits read back
+    gb_mmu.bus_write_memory(0xffff, 0xff);
+    EXPECT_EQ(instance->gb_interrupt.interrupt_enable_flag, 0xff);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xffff), 0x1f);
+    gb_mmu.write_memory(0xffff, 0x05);
+    EXPECT_EQ(gb_mmu.read_memory(0xffff), 0x05);
+    EXPECT_EQ(gb_mmu.read_memory(0xfffe), static_cast<uint8_t>(0xfffe ^ 0x5a));
+
+    // i/o goes to the registers, not hram
+    gb_mmu.bus_write_memory(0xff42, 0x33);
+    EXPECT_EQ(instance->gb_ppu.scy_ff42, 0x33);
+    gb_mmu.bus_write_memory(0xff0f, 0x00);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xff0f), 0xe0);
+    EXPECT_EQ(gb_mmu.read_memory(0xff80), static_cast<uint8_t>(0xff80 ^ 0x5a));
+}
+
+// writes to the mbc switch the bank the table maps at 4000 - 7fff
+TEST(memory, bank_switching) {
+    // 128 KiB mbc1 rom, every byte of bank n is n
+    std::vector<char> rom(0x20000);
+    for (std::size_t i = 0; i < rom.size(); ++i) {
+        rom[i] = static_cast<char>(i >> 14);
+    }
+    rom[0x0147] = 1; // mbc1
+    rom[0x0148] = 2; // 128 KiB, 8 banks
+    rom[0x0149] = 0; // no ram
+    std::unique_ptr<gameboy> instance = load_instance(rom);
+    mmu &gb_mmu = instance->gb_mmu;
+
+    EXPECT_EQ(gb_mmu.read_memory(0x4000), 1);
+    // bank 0 asks for bank 1, the bank number is masked to the rom's 8 banks
+    for (const auto &select :
+         {std::pair<uint8_t, uint8_t>{2, 2}, {7, 7}, {0, 1}, {0x0b, 3},
+          {5, 5}}) {
+        gb_mmu.bus_write_memory(0x2000, select.first);
+        for (const uint16_t address : {0x4000, 0x5a5a, 0x7fff}) {
+            EXPECT_EQ(gb_mmu.read_memory(address), select.second)
+                << std::hex << address;
+            EXPECT_EQ(gb_mmu.bus_read_memory(address), select.second)
+                << std::hex << address;
+        }
+        EXPECT_EQ(gb_mmu.code_span_at(0x4000).data[0], select.second);
+        EXPECT_EQ(gb_mmu.rom_bank(0x4000), select.second);
+        // bank 0 stays
+        EXPECT_EQ(gb_mmu.read_memory(0x3fff), 0);
+    }
+}
+
+// oam dma from wram: mid-transfer the cpu still reads hram and i/o, the bus
+// being copied from and oam read the byte in flight, and oam itself (as the
+// handlers and the ppu see it) has every byte copied so far
+TEST(memory, oam_dma) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+    ppu &gb_ppu = instance->gb_ppu;
+
+    for (uint16_t i = 0; i < 0xa0; ++i) {
+        gb_mmu.write_memory(0xc100 + i, static_cast<uint8_t>(0x20 + i));
+        gb_mmu.write_memory(0xfe00 + i, 0x11);
+    }
+    for (uint32_t address = 0xff80; address <= 0xfffe; ++address) {
+        gb_mmu.write_memory(address, static_cast<uint8_t>(address));
+    }
+
+    gb_mmu.bus_write_memory(0xff46, 0xc1);
+    gb_mmu.set_oam_dma();
+    for (uint16_t i = 0; i < 0xa0; ++i) {
+        gb_mmu.dma_transfer();
+        if (i == 0x9f) {
+            break;
+        }
+
+        // hram and i/o, these don't copy the bytes waiting yet
+        EXPECT_EQ(gb_mmu.bus_read_memory(0xff80 + i % 0x7f),
+                  static_cast<uint8_t>(0xff80 + i % 0x7f));
+        EXPECT_EQ(gb_mmu.bus_read_memory(0xff46), 0xc1);
+        gb_mmu.bus_write_memory(0xfffe, 0x42);
+        EXPECT_EQ(gb_mmu.bus_read_memory(0xfffe), 0x42);
+        gb_mmu.bus_write_memory(0xfffe, 0xfe);
+        EXPECT_EQ(gb_ppu.oam_ram[i], 0x11) << i;
+
+        // oam through the handlers, then as the ppu reads it
+        EXPECT_EQ(gb_mmu.read_memory(0xfe00 + i), 0x20 + i);
+        EXPECT_EQ(gb_mmu.read_memory(0xfe00 + i + 1), 0x11);
+        EXPECT_EQ(gb_ppu._get(0xfe00 + i), 0x20 + i);
+        EXPECT_EQ(gb_ppu.oam_ram[i], 0x20 + i) << i;
+        EXPECT_EQ(gb_ppu.oam_ram[i + 1], 0x11) << i;
+
+        // wram and oam are held, the cpu reads the byte being copied
+        EXPECT_EQ(gb_mmu.bus_read_memory(0xd000), 0x20 + i + 1);
+        EXPECT_EQ(gb_mmu.bus_read_memory(0xfe50), 0x20 + i + 1);
+    }
+
+    // done, everything reads normally again
+    EXPECT_FALSE(gb_ppu.dma_mode);
+    for (uint16_t i = 0; i < 0xa0; ++i) {
+        ASSERT_EQ(gb_ppu.oam_ram[i], 0x20 + i) << i;
+        ASSERT_EQ(gb_mmu.bus_read_memory(0xfe00 + i), 0x20 + i) << i;
+        ASSERT_EQ(gb_mmu.read_memory(0xfe00 + i), 0x20 + i) << i;
+    }
+    for (uint32_t address = 0xff80; address <= 0xfffe; ++address) {
+        ASSERT_EQ(gb_mmu.bus_read_memory(address),
+                  static_cast<uint8_t>(address));
+    }
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xd000), 0x00);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xc150), 0x70);
+}
+
+// oam dma from vram leaves wram to the cpu once the bytes copied so far are
+// in oam
+TEST(memory, oam_dma_from_vram) {
+    std::unique_ptr<gameboy> instance = load_instance();
+    mmu &gb_mmu = instance->gb_mmu;
+    ppu &gb_ppu = instance->gb_ppu;
+
+    for (uint16_t i = 0; i < 0xa0; ++i) {
+        gb_ppu.character_ram[0x200 + i] = static_cast<uint8_t>(0x40 + i);
+    }
+    gb_mmu.write_memory(0xc000, 0x99);
+
+    gb_mmu.bus_write_memory(0xff46, 0x82);
+    gb_mmu.set_oam_dma();
+    for (uint16_t i = 0; i < 0x10; ++i) {
+        gb_mmu.dma_transfer();
+    }
+    EXPECT_EQ(gb_ppu.oam_ram[0], 0x00);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xc000), 0x99);
+    EXPECT_EQ(gb_ppu.oam_ram[0x0f], 0x4f);
+    EXPECT_EQ(gb_ppu.oam_ram[0x10], 0x00);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0x8000), 0x50);
+
+    for (uint16_t i = 0x10; i < 0xa0; ++i) {
+        gb_mmu.dma_transfer();
+    }
+    EXPECT_FALSE(gb_ppu.dma_mode);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0xfe9f), 0xdf);
+    EXPECT_EQ(gb_mmu.bus_read_memory(0x8000), 0x00);
+}
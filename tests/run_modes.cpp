@@ -0,0 +1,398 @@
+#include "../src/gameboy.h"
+#include "fixtures.h"
+#include <array>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// fast mode and the skips (halt, polling loops, copy and fill loops) against
+// stepping every T-cycle with gameboy::tick(): the cpu, memory, timer, IF and
+// the lcd must end up the same
+
+namespace {
+
+constexpr uint32_t frame_t_cycles{70224};
+
+// how an instance is run
+enum class stepping {
+    ticks,    // gameboy::tick() every T-cycle, nothing skipped
+    accurate, // run() in accurate mode
+    fast      // run() in fast mode
+};
+
+std::unique_ptr<gameboy> boot(const code &program, const stepping how) {
+    std::unique_ptr<gameboy> instance = boot_instance(rom_with(program));
+    instance->mode = how == stepping::fast ? gameboy::execution_mode::fast
+                                           : gameboy::execution_mode::accurate;
+
+    // something for the lcd to draw: tiles, a background, the window and
+    // sprites
+    for (std::size_t i = 0; i < sizeof(instance->gb_ppu.character_ram); ++i) {
+        instance->gb_ppu.character_ram[i] = static_cast<uint8_t>(i * 7);
+    }
+    for (std::size_t i = 0; i < sizeof(instance->gb_ppu.bg_map_data_1); ++i) {
+        instance->gb_ppu.bg_map_data_1[i] = static_cast<uint8_t>(i);
+    }
+    instance->gb_ppu.lcdc_ff40 |= 0x22; // window and sprites on
+    instance->gb_ppu.wx_ff4b = 87;
+    instance->gb_ppu.wy_ff4a = 72;
+    for (uint8_t sprite = 0; sprite < 40; ++sprite) {
+        instance->gb_ppu.oam_ram[sprite * 4] = 16 + (sprite % 4) * 30;
+        instance->gb_ppu.oam_ram[sprite * 4 + 1] = 160 - sprite * 4;
+        instance->gb_ppu.oam_ram[sprite * 4 + 2] = sprite;
+    }
+    return instance;
+}
+
+void advance(gameboy &instance, const stepping how, const uint32_t t_cycles) {
+    if (how != stepping::ticks) {
+        instance.run(t_cycles);
+        return;
+    }
+    for (uint32_t i = 0; i < t_cycles; ++i) {
+        instance.tick();
+    }
+    instance.clock += t_cycles;
+}
+
+// wram, then i/o, hram and ie as read_memory() sees them
+std::vector<uint8_t> memory(const gameboy &instance) {
+    std::vector<uint8_t> bytes{};
+    for (uint32_t address = 0xc000; address <= 0xdfff; ++address) {
+        bytes.push_back(instance.gb_mmu.read_memory(address));
+    }
+    for (uint32_t address = 0xff00; address <= 0xffff; ++address) {
+        bytes.push_back(instance.gb_mmu.read_memory(address));
+    }
+    return bytes;
+}
+
+void expect_same(gameboy &expected, gameboy &actual) {
+    expected.gb_cpu.sync_flags();
+    actual.gb_cpu.sync_flags();
+    EXPECT_EQ(actual.clock, expected.clock);
+    EXPECT_EQ(actual.gb_cpu.AF, expected.gb_cpu.AF);
+    EXPECT_EQ(actual.gb_cpu.BC, expected.gb_cpu.BC);
+    EXPECT_EQ(actual.gb_cpu.DE, expected.gb_cpu.DE);
+    EXPECT_EQ(actual.gb_cpu.HL, expected.gb_cpu.HL);
+    EXPECT_EQ(actual.gb_cpu.SP, expected.gb_cpu.SP);
+    EXPECT_EQ(actual.gb_cpu.PC, expected.gb_cpu.PC);
+    EXPECT_EQ(actual.gb_cpu.halt, expected.gb_cpu.halt);
+
+    EXPECT_EQ(actual.gb_interrupt.interrupt_flags,
+              expected.gb_interrupt.interrupt_flags);
+    EXPECT_EQ(actual.gb_interrupt.ime, expected.gb_interrupt.ime);
+
+    EXPECT_EQ(actual.gb_timer.sysclock, expected.gb_timer.sysclock);
+    EXPECT_EQ(actual.gb_timer.tima_ff05, expected.gb_timer.tima_ff05);
+
+    EXPECT_EQ(actual.gb_ppu.ly_ff44, expected.gb_ppu.ly_ff44);
+    EXPECT_EQ(actual.gb_ppu.stat_ff41, expected.gb_ppu.stat_ff41);
+    EXPECT_TRUE(actual.gb_ppu.lcd_frame == expected.gb_ppu.lcd_frame);
+
+    EXPECT_EQ(memory(actual), memory(expected));
+}
+
+// cpu bound loop over wram with a vblank and a timer interrupt
+const code busy_program{
+    {0x0040,
+     {
+         0xf5,       // 0040: push af
+         0xf0, 0x80, // 0041: ldh a, (80)
+         0x3c,       // 0043: inc a
+         0xe0, 0x80, // 0044: ldh (80), a
+         0xf1,       // 0046: pop af
+         0xd9,       // 0047: reti
+     }},
+    {0x0050,
+     {
+         0xf5,       // 0050: push af
+         0xf0, 0x81, // 0051: ldh a, (81)
+         0x3c,       // 0053: inc a
+         0xe0, 0x81, // 0054: ldh (81), a
+         0xf0, 0x44, // 0056: ldh a, (44)
+         0xe0, 0x82, // 0058: ldh (82), a, ly when it came
+         0xf1,       // 005a: pop af
+         0xd9,       // 005b: reti
+     }},
+    {0x0100,
+     {
+         0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+         0x3e, 0x05,       // 0103: ld a, 05
+         0xe0, 0xff,       // 0105: ldh (ff), a, vblank and timer
+         0x3e, 0x05,       // 0107: ld a, 05
+         0xe0, 0x07,       // 0109: ldh (07), a, every 16 T-cycles
+         0xfb,             // 010b: ei
+         0x21, 0x00, 0xc0, // 010c: ld hl, c000
+         0x7e,             // 010f: ld a, (hl)
+         0x80,             // 0110: add a, b
+         0x22,             // 0111: ld (hl+), a
+         0x04,             // 0112: inc b
+         0xa9,             // 0113: xor c
+         0x4f,             // 0114: ld c, a
+         0xcb, 0x11,       // 0115: rl c
+         0xc5,             // 0117: push bc
+         0xd1,             // 0118: pop de
+         0x7c,             // 0119: ld a, h
+         0xfe, 0xc1,       // 011a: cp c1
+         0x20, 0xf1,       // 011c: jr nz, 010f
+         0x26, 0xc0,       // 011e: ld h, c0
+         0x18, 0xed,       // 0120: jr 010f
+     }},
+};
+
+// halts until the timer (every 8192 T-cycles, ime off so it just wakes) and
+// records DIV, TIMA, LY and IF after waking, with the lcd on or turned off.
+// lcd_interrupts also wakes it on vblank, hblank and ly == 90
+code halt_program(const bool lcd_off, const bool lcd_interrupts = false) {
+    std::vector<uint8_t> lcd{0x00, 0x00, 0x00}; // 0114: nop, nop, nop
+    if (lcd_off) {
+        lcd = {0xaf, 0xe0, 0x40}; // 0114: xor a, ldh (40), a
+    } else if (lcd_interrupts) {
+        lcd = {0xcd, 0x50, 0x01}; // 0114: call 0150
+    }
+    std::vector<uint8_t> setup{
+        0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+        0x21, 0x00, 0xc0, // 0103: ld hl, c000
+        0x3e, 0x04,       // 0106: ld a, 04
+        0xe0, 0xff,       // 0108: ldh (ff), a, timer
+        0x3e, 0x04,       // 010a: ld a, 04
+        0xe0, 0x07,       // 010c: ldh (07), a, every 1024 T-cycles
+        0x3e, 0xf8,       // 010e: ld a, f8
+        0xe0, 0x06,       // 0110: ldh (06), a
+        0xe0, 0x05,       // 0112: ldh (05), a
+    };
+    setup.insert(setup.end(), lcd.begin(), lcd.end());
+    const std::vector<uint8_t> loop{
+        0xaf,       // 0117: xor a
+        0xe0, 0x0f, // 0118: ldh (0f), a
+        0x76,       // 011a: halt
+        0xf0, 0x04, // 011b: ldh a, (04)
+        0x22,       // 011d: ld (hl+), a
+        0xf0, 0x05, // 011e: ldh a, (05)
+        0x22,       // 0120: ld (hl+), a
+        0xf0, 0x44, // 0121: ldh a, (44)
+        0x22,       // 0123: ld (hl+), a
+        0xf0, 0x0f, // 0124: ldh a, (0f)
+        0x22,       // 0126: ld (hl+), a
+        0x18, 0xee, // 0127: jr 0117
+    };
+    const std::vector<uint8_t> interrupts{
+        0x3e, 0x48, // 0150: ld a, 48
+        0xe0, 0x41, // 0152: ldh (41), a, hblank and lyc
+        0x3e, 0x5a, // 0154: ld a, 5a
+        0xe0, 0x45, // 0156: ldh (45), a
+        0x3e, 0x07, // 0158: ld a, 07
+        0xe0, 0xff, // 015a: ldh (ff), a, vblank, stat and timer
+        0xc9,       // 015c: ret
+    };
+    return {{0x0100, setup}, {0x0117, loop}, {0x0150, interrupts}};
+}
+
+// polls LY for line 144 and then for the line after it, recording DIV in
+// between, with or without a timer interrupt (every 4096 T-cycles) coming in
+// while it polls
+code polling_program(const bool timer) {
+    const uint8_t ei = timer ? 0xfb : 0x00; // ei or nop
+    return {{0x0050,
+             {
+                 0xf5,       // 0050: push af
+                 0xf0, 0x81, // 0051: ldh a, (81)
+                 0x3c,       // 0053: inc a
+                 0xe0, 0x81, // 0054: ldh (81), a
+                 0xf1,       // 0056: pop af
+                 0xd9,       // 0057: reti
+             }},
+            {0x0100,
+             {
+                 0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+                 0x21, 0x00, 0xc0, // 0103: ld hl, c000
+                 0x3e, 0x04,       // 0106: ld a, 04
+                 0xe0, 0xff,       // 0108: ldh (ff), a, timer
+                 0x3e, 0x05,       // 010a: ld a, 05
+                 0xe0, 0x07,       // 010c: ldh (07), a
+                 ei,               // 010e: ei
+                 0xf0, 0x44,       // 010f: ldh a, (44)
+                 0xfe, 0x90,       // 0111: cp 90
+                 0x20, 0xfa,       // 0113: jr nz, 010f
+                 0xf0, 0x04,       // 0115: ldh a, (04)
+                 0x22,             // 0117: ld (hl+), a
+                 0xf0, 0x44,       // 0118: ldh a, (44)
+                 0xfe, 0x90,       // 011a: cp 90
+                 0x28, 0xfa,       // 011c: jr z, 0118
+                 0x18, 0xef,       // 011e: jr 010f
+             }}};
+}
+
+// polls DIV for 40, records TIMA, polls TIMA (every 256 T-cycles) for 80 and
+// records DIV, over and over
+const code timer_polling_program{
+    {0x0100,
+     {
+         0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+         0x21, 0x00, 0xc0, // 0103: ld hl, c000
+         0x3e, 0x07,       // 0106: ld a, 07
+         0xe0, 0x07,       // 0108: ldh (07), a
+         0xf0, 0x04,       // 010a: ldh a, (04)
+         0xfe, 0x40,       // 010c: cp 40
+         0x20, 0xfa,       // 010e: jr nz, 010a
+         0xf0, 0x05,       // 0110: ldh a, (05)
+         0x22,             // 0112: ld (hl+), a
+         0xf0, 0x05,       // 0113: ldh a, (05)
+         0xfe, 0x80,       // 0115: cp 80
+         0x20, 0xfa,       // 0117: jr nz, 0113
+         0xf0, 0x04,       // 0119: ldh a, (04)
+         0x22,             // 011b: ld (hl+), a
+         0x18, 0xec,       // 011c: jr 010a
+     }},
+};
+
+// copies 256 bytes of rom to c000 (dec c counter), 2 KiB of wram from c000
+// to d000 (dec bc; ld a,b; or c counter), and fills d800-d8ff with the
+// number of timer interrupts so far, over and over. the timer interrupts
+// every 4096 T-cycles, with the lcd on or turned off
+code bulk_program(const bool lcd_off) {
+    std::vector<uint8_t> lcd{0x00, 0x00, 0x00}; // 010c: nop, nop, nop
+    if (lcd_off) {
+        lcd = {0xaf, 0xe0, 0x40}; // 010c: xor a, ldh (40), a
+    }
+    std::vector<uint8_t> setup{
+        0x31, 0xfe, 0xff, // 0100: ld sp, fffe
+        0x3e, 0x04,       // 0103: ld a, 04
+        0xe0, 0xff,       // 0105: ldh (ff), a, timer
+        0x3e, 0x05,       // 0107: ld a, 05
+        0xe0, 0x07,       // 0109: ldh (07), a, every 16 T-cycles
+        0xfb,             // 010b: ei
+    };
+    setup.insert(setup.end(), lcd.begin(), lcd.end());
+    const std::vector<uint8_t> loops{
+        0x21, 0x00, 0x01, // 010f: ld hl, 0100
+        0x11, 0x00, 0xc0, // 0112: ld de, c000
+        0x0e, 0x00,       // 0115: ld c, 00
+        0x2a,             // 0117: ld a, (hl+)
+        0x12,             // 0118: ld (de), a
+        0x13,             // 0119: inc de
+        0x0d,             // 011a: dec c
+        0x20, 0xfa,       // 011b: jr nz, 0117
+        0x21, 0x00, 0xc0, // 011d: ld hl, c000
+        0x11, 0x00, 0xd0, // 0120: ld de, d000
+        0x01, 0x00, 0x08, // 0123: ld bc, 0800
+        0x2a,             // 0126: ld a, (hl+)
+        0x12,             // 0127: ld (de), a
+        0x13,             // 0128: inc de
+        0x0b,             // 0129: dec bc
+        0x78,             // 012a: ld a, b
+        0xb1,             // 012b: or c
+        0x20, 0xf8,       // 012c: jr nz, 0126
+        0xf0, 0x81,       // 012e: ldh a, (81)
+        0x21, 0x00, 0xd8, // 0130: ld hl, d800
+        0x06, 0x00,       // 0133: ld b, 00
+        0x22,             // 0135: ld (hl+), a
+        0x05,             // 0136: dec b
+        0x20, 0xfc,       // 0137: jr nz, 0135
+        0x18, 0xd4,       // 0139: jr 010f
+    };
+    return {{0x0050,
+             {
+                 0xf5,       // 0050: push af
+                 0xf0, 0x81, // 0051: ldh a, (81)
+                 0x3c,       // 0053: inc a
+                 0xe0, 0x81, // 0054: ldh (81), a
+                 0xf1,       // 0056: pop af
+                 0xd9,       // 0057: reti
+             }},
+            {0x0100, setup},
+            {0x010f, loops}};
+}
+
+// runs the program stepping every T-cycle, in accurate mode and in fast mode,
+// comparing them every t_cycles
+void expect_same_runs(const code &program, const uint32_t t_cycles,
+                      const int times) {
+    std::unique_ptr<gameboy> ticks = boot(program, stepping::ticks);
+    std::unique_ptr<gameboy> accurate = boot(program, stepping::accurate);
+    std::unique_ptr<gameboy> fast = boot(program, stepping::fast);
+
+    for (int i = 0; i < times; ++i) {
+        SCOPED_TRACE(i);
+        advance(*ticks, stepping::ticks, t_cycles);
+        advance(*accurate, stepping::accurate, t_cycles);
+        advance(*fast, stepping::fast, t_cycles);
+        expect_same(*ticks, *accurate);
+        expect_same(*ticks, *fast);
+    }
+}
+
+} // namespace
+
+// the same rom in accurate and fast mode, compared after every frame
+TEST(run_modes, fast_matches_accurate) {
+    std::unique_ptr<gameboy> accurate =
+        boot(busy_program, stepping::accurate);
+    std::unique_ptr<gameboy> fast = boot(busy_program, stepping::fast);
+
+    for (int frame = 0; frame < 10; ++frame) {
+        SCOPED_TRACE(frame);
+        advance(*accurate, stepping::accurate, frame_t_cycles);
+        advance(*fast, stepping::fast, frame_t_cycles);
+        expect_same(*accurate, *fast);
+    }
+
+    // both interrupts were taken
+    EXPECT_GT(accurate->gb_mmu.read_memory(0xff80), 0);
+    EXPECT_GT(accurate->gb_mmu.read_memory(0xff81), 0);
+}
+
+// halted with the lcd on: straight over the rest of hblank and vblank lines,
+// the cpu wakes on the same M-cycle
+TEST(run_modes, halt_lcd_on) {
+    expect_same_runs(halt_program(false), 10007, 70);
+}
+
+// woken by vblank, the stat line and the timer, the skips stop on the
+// M-cycle each raises IF
+TEST(run_modes, halt_lcd_interrupts) {
+    expect_same_runs(halt_program(false, true), 10007, 70);
+    expect_same_runs(halt_program(false, true), 997, 700);
+}
+
+// halted with the lcd off: straight to the M-cycle before tima overflows
+TEST(run_modes, halt_lcd_off) {
+    expect_same_runs(halt_program(true), 10007, 70);
+}
+
+// a polling loop stops being skipped on the M-cycle its read changes or an
+// interrupt is taken, and the cpu is where running it would have left it
+// (PC, A, the flags) at any point in between, M-cycle boundary or not
+TEST(run_modes, polling_loop) {
+    expect_same_runs(polling_program(false), 10007, 70);
+    expect_same_runs(polling_program(false), 997, 700);
+}
+
+TEST(run_modes, polling_loop_interrupted) {
+    expect_same_runs(polling_program(true), 10007, 70);
+    expect_same_runs(polling_program(true), 997, 700);
+}
+
+// polling div or tima jumps up to the M-cycle before the read changes
+TEST(run_modes, polling_timer) {
+    expect_same_runs(timer_polling_program, 10007, 70);
+    expect_same_runs(timer_polling_program, 997, 700);
+}
+
+// copy and fill loops with the lcd on run all at once over the rest of hblank
+// and vblank lines, otherwise an iteration at a time while the timer and ppu
+// step, the interrupts land on the same M-cycle
+TEST(run_modes, bulk_loops_lcd_on) {
+    expect_same_runs(bulk_program(false), 10007, 70);
+    expect_same_runs(bulk_program(false), 997, 700);
+}
+
+// with the lcd off they run all at once up to the M-cycle before tima
+// overflows
+TEST(run_modes, bulk_loops_lcd_off) {
+    expect_same_runs(bulk_program(true), 10007, 70);
+    expect_same_runs(bulk_program(true), 997, 700);
+}
@@ -1,8 +1,10 @@
 #include "../src/cpu.h"
+#include "../src/gameboy.h"
 #include "../src/mmu.h"
 #include "../src/timer.h"
 #include "../src/interrupt.h"
 #include "../src/ppu.h"
+#include "fixtures.h"
 #include "opcodes.h" // import all opcodes
 #include <array>
 #include <fstream>
@@ -10,22 +12,6 @@
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
-class sst_mmu : public mmu {
-  public:
-    sst_mmu(timer &gb_timer, interrupt &gb_interrupt, ppu &gb_ppu, joypad &gb_joypad) : mmu(gb_timer, gb_interrupt, gb_ppu, gb_joypad) {};
-
-    uint8_t memory[0xffff]{};
-
-    uint8_t bus_read_memory(uint16_t address) override {
-        return memory[address];
-    };
-
-    void bus_write_memory(uint16_t address, uint8_t value) override {
-        memory[address] = value;
-    };
-};
-
-
 timer test_timer{};
 interrupt test_interrupt{};
 
@@ -36,7 +22,7 @@ ppu test_ppu{test_interrupt, window};
 
 joypad test_joypad{};
 
-sst_mmu test_mmu{test_timer, test_interrupt, test_ppu, test_joypad};
+flat_mmu test_mmu{test_timer, test_interrupt, test_ppu, test_joypad};
 
 cpu test_cpu = cpu(test_mmu, test_timer, test_interrupt);
 
@@ -111,14 +97,8 @@ void test_setup(cpu &test_cpu, sst::cpu_state &initial) {
     test_cpu.E = initial.e;
     test_interrupt.ime = initial.ime;
 
-    std::array<bool, 4> znhc{}; // flags array
-    for (unsigned int i = 0; i < znhc.size(); ++i) {
-        znhc[i] = (initial.f >> (7 - i)) & 1;
-    }
-    test_cpu.Zf = znhc[0] == 1;
-    test_cpu.Nf = znhc[1] == 1;
-    test_cpu.Hf = znhc[2] == 1;
-    test_cpu.Cf = znhc[3] == 1;
+    test_cpu.sync_flags(); // drop flags left pending by the last test
+    test_cpu.F = initial.f & 0xf0; // the 4 LSBs of F are always 0
 
     test_cpu.H = initial.h;
     test_cpu.L = initial.l;
@@ -139,14 +119,16 @@ void compare_final(cpu &test_cpu, sst::cpu_state &final) {
     EXPECT_EQ(test_cpu.E, final.e);
     EXPECT_EQ(test_interrupt.ime, final.ime);
 
+    test_cpu.sync_flags();
     std::array<bool, 4> znhc{}; // flags array
     for (unsigned int i = 0; i < znhc.size(); ++i) {
         znhc[i] = (final.f >> (7 - i)) & 1;
     }
-    EXPECT_EQ(znhc[0], test_cpu.Zf);
-    EXPECT_EQ(znhc[1], test_cpu.Nf);
-    EXPECT_EQ(znhc[2], test_cpu.Hf);
-    EXPECT_EQ(znhc[3], test_cpu.Cf);
+    EXPECT_EQ(znhc[0], (test_cpu.F & cpu::flag_z) != 0);
+    EXPECT_EQ(znhc[1], (test_cpu.F & cpu::flag_n) != 0);
+    EXPECT_EQ(znhc[2], (test_cpu.F & cpu::flag_h) != 0);
+    EXPECT_EQ(znhc[3], (test_cpu.F & cpu::flag_c) != 0);
+    EXPECT_EQ(test_cpu.F & 0x0f, 0);
 
     EXPECT_EQ(test_cpu.H, final.h);
     EXPECT_EQ(test_cpu.L, final.l);
@@ -242,3 +224,73 @@ INSTANTIATE_TEST_SUITE_P(cpu, OpcodeTest, testing::ValuesIn(opcodes),
 
 INSTANTIATE_TEST_SUITE_P(cpu, CBOpcodeTest, testing::ValuesIn(cb_opcodes),
                          opcode_param_to_string);
+
+// what one more instance costs, in bytes. the rom and the code decoded from
+// it are shared between instances (shared_rom, shared_code):
+//   mmu  28 KiB: wram 8 KiB, cartridge ram 8 KiB, page table 6 KiB, i/o
+//                registers 3 KiB, page versions 1 KiB
+//   ppu   6 KiB: lcd frame 5.6 KiB (2 bits a pixel)
+//   cpu, timer, interrupt and joypad: under 1 KiB together
+// plus the heap: vram and oam (8.2 KiB, out of line so the ppu's per-dot
+// state stays apart from them), and what its block cache grows to, a few KiB
+// for decoded wram/hram code and the rom blocks it has run
+TEST(footprint, instance_budget) {
+    EXPECT_LE(sizeof(mmu), 28 * 1024);
+    EXPECT_LE(sizeof(ppu), 6 * 1024);
+    EXPECT_LE(sizeof(cpu) + sizeof(timer) + sizeof(interrupt) + sizeof(joypad),
+              1024);
+    EXPECT_LE(sizeof(gameboy), 36 * 1024);
+}
+
+TEST(footprint, shared_rom) {
+    // 64 KiB mbc1 rom, every byte of bank n is n
+    std::vector<char> rom(0x10000);
+    for (std::size_t i = 0; i < rom.size(); ++i) {
+        rom[i] = static_cast<char>(i >> 14);
+    }
+    rom[0x0147] = 1; // mbc1
+    rom[0x0148] = 1; // 64 KiB
+    rom[0x0149] = 0; // no ram
+
+    std::unique_ptr<gameboy> first = load_instance(rom);
+    std::unique_ptr<gameboy> second = load_instance(rom);
+
+    // one copy of the rom between them
+    EXPECT_EQ(first->gb_mmu.code_span_at(0x4000).data,
+              second->gb_mmu.code_span_at(0x4000).data);
+    EXPECT_EQ(first->gb_mmu.read_memory(0x4000), 1);
+
+    // banking stays per instance
+    first->gb_mmu.write_memory(0x2000, 2);
+    EXPECT_EQ(first->gb_mmu.read_memory(0x4000), 2);
+    EXPECT_EQ(second->gb_mmu.read_memory(0x4000), 1);
+}
+
+// decoded rom code is per rom image, shared while a cpu holds it
+TEST(footprint, shared_code) {
+    std::vector<char> bytes(0x8000, 0x00);
+    const shared_rom::image rom = shared_rom::load(bytes.data(), bytes.size());
+    bytes[0x0150] = 0x3c;
+    const shared_rom::image other =
+        shared_rom::load(bytes.data(), bytes.size());
+
+    std::shared_ptr<shared_code> code = shared_code::of(rom);
+    EXPECT_EQ(shared_code::of(shared_rom::load(bytes.data(), 0x8000)).get(),
+              shared_code::of(other).get());
+    EXPECT_NE(shared_code::of(other).get(), code.get());
+
+    block_cache::decoded_block decoded{};
+    decoded.instructions.push_back({0x0150, 0x00, 0x00, 1, 1});
+    const block_cache::decoded_block *block =
+        code->insert(1, 0x0150, std::move(decoded));
+    EXPECT_EQ(shared_code::of(rom)->find(1, 0x0150), block);
+    EXPECT_EQ(code->insert(1, 0x0150, block_cache::decoded_block{}), block);
+    EXPECT_EQ(code->find(0, 0x0150), nullptr);
+    EXPECT_EQ(shared_code::of(other)->find(1, 0x0150), nullptr);
+
+    // gone with the last holder, the next one starts over
+    const std::weak_ptr<shared_code> held = code;
+    code.reset();
+    EXPECT_TRUE(held.expired());
+    EXPECT_EQ(shared_code::of(rom)->find(1, 0x0150), nullptr);
+}
@@ -0,0 +1,177 @@
+#include "../src/gameboy.h"
+#include "fixtures.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// read, write and execute watchpoints on a running instance, in both modes:
+// what the hits record, stopping run() and code the block cache has to leave
+// to the cpu
+
+namespace {
+
+// 0100: nop; jp 0150
+// 0150: ld a, (c000); inc a; ld (c001), a; call 4000; jr 0150
+// 4000: ld a, (4100); ret
+// every byte of 4100 - 41ff is 0x99
+std::unique_ptr<gameboy> boot(const gameboy::execution_mode mode) {
+    const code program{
+        {0x0100, {0x00, 0xc3, 0x50, 0x01}},
+        {0x0150,
+         {0xfa, 0x00, 0xc0, 0x3c, 0xea, 0x01, 0xc0, 0xcd, 0x00, 0x40, 0x18,
+          0xf4}},
+        {0x4000, {0xfa, 0x00, 0x41, 0xc9}},
+        {0x4100, std::vector<uint8_t>(0x100, 0x99)},
+    };
+
+    std::unique_ptr<gameboy> instance = boot_instance(rom_with(program));
+    instance->mode = mode;
+    instance->gb_mmu.write_memory(0xc000, 0x41);
+    return instance;
+}
+
+// T-cycles around the loop at 0150: 16 + 4 + 16 + 24 + 12, and 16 + 16 at
+// 4000
+constexpr uint32_t loop_t_cycles{104};
+
+// the hits recorded so far, oldest first
+std::vector<watchpoints::hit> hits(const gameboy &instance) {
+    const watchpoints &watches = instance.gb_mmu.watches;
+    std::vector<watchpoints::hit> recorded{};
+    for (uint64_t n = 0; n < watches.hit_count; ++n) {
+        recorded.push_back(watches.hits[n % watchpoints::ring_size]);
+    }
+    return recorded;
+}
+
+class WatchpointTest
+    : public testing::TestWithParam<gameboy::execution_mode> {};
+
+} // namespace
+
+TEST_P(WatchpointTest, read_and_write) {
+    std::unique_ptr<gameboy> instance = boot(GetParam());
+    instance->gb_mmu.add_watchpoint({0xc000, 0xc001, watchpoints::read});
+    instance->gb_mmu.add_watchpoint({0xc001, 0xc001, watchpoints::write});
+    instance->run(40 * loop_t_cycles);
+
+    // a read of c000 then a write of c001 each time around
+    const std::vector<watchpoints::hit> recorded = hits(*instance);
+    ASSERT_GE(recorded.size(), 70);
+    for (std::size_t n = 0; n + 1 < recorded.size(); n += 2) {
+        const watchpoints::hit &read = recorded[n];
+        const watchpoints::hit &write = recorded[n + 1];
+        EXPECT_EQ(read.access, watchpoints::read);
+        EXPECT_EQ(read.address, 0xc000);
+        EXPECT_EQ(read.pc, 0x0153); // past the immediate
+        EXPECT_EQ(read.value, 0x41);
+        EXPECT_EQ(read.bank, 0);
+
+        EXPECT_EQ(write.access, watchpoints::write);
+        EXPECT_EQ(write.address, 0xc001);
+        EXPECT_EQ(write.pc, 0x0157);
+        EXPECT_EQ(write.value, 0x42);
+
+        // ld a, (c000) ends 4 T-cycles before inc a and ld (c001), a's write
+        EXPECT_EQ(write.cycle - read.cycle, 20);
+        if (n >= 2) {
+            EXPECT_EQ(read.cycle - recorded[n - 2].cycle, loop_t_cycles);
+        }
+    }
+}
+
+TEST_P(WatchpointTest, rom_bank) {
+    std::unique_ptr<gameboy> instance = boot(GetParam());
+    // 4000 - 7fff is bank 1 without an mbc
+    instance->gb_mmu.add_watchpoint({0x4100, 0x41ff, watchpoints::read, 2});
+    instance->run(10 * loop_t_cycles);
+    EXPECT_EQ(instance->gb_mmu.watches.hit_count, 0);
+
+    instance->gb_mmu.add_watchpoint({0x4100, 0x41ff, watchpoints::read, 1});
+    instance->run(10 * loop_t_cycles);
+    const std::vector<watchpoints::hit> recorded = hits(*instance);
+    ASSERT_EQ(recorded.size(), 10);
+    for (const watchpoints::hit &hit : recorded) {
+        EXPECT_EQ(hit.address, 0x4100);
+        EXPECT_EQ(hit.bank, 1);
+        EXPECT_EQ(hit.pc, 0x4003);
+        EXPECT_EQ(hit.value, 0x99);
+    }
+}
+
+// code on an execute-watched page runs through the cpu one instruction at a
+// time, even once it was in the block cache
+TEST_P(WatchpointTest, execute) {
+    std::unique_ptr<gameboy> instance = boot(GetParam());
+    instance->run(10 * loop_t_cycles);
+    const uint64_t start = instance->clock;
+
+    instance->gb_mmu.add_watchpoint({0x0153, 0x0153, watchpoints::execute});
+    instance->run(10 * loop_t_cycles);
+    std::vector<watchpoints::hit> recorded = hits(*instance);
+    ASSERT_EQ(recorded.size(), 10);
+    for (std::size_t n = 0; n < recorded.size(); ++n) {
+        EXPECT_EQ(recorded[n].access, watchpoints::execute);
+        EXPECT_EQ(recorded[n].address, 0x0153);
+        EXPECT_EQ(recorded[n].pc, 0x0153);
+        EXPECT_EQ(recorded[n].value, 0x3c); // inc a
+        EXPECT_GE(recorded[n].cycle, start);
+        if (n) {
+            EXPECT_EQ(recorded[n].cycle - recorded[n - 1].cycle,
+                      loop_t_cycles);
+        }
+    }
+
+    // a second one on the same page
+    instance->gb_mmu.add_watchpoint({0x015a, 0x015a, watchpoints::execute});
+    instance->run(10 * loop_t_cycles);
+    recorded = hits(*instance);
+    ASSERT_EQ(recorded.size(), 30);
+    for (std::size_t n = 11; n < recorded.size(); ++n) {
+        EXPECT_NE(recorded[n].address, recorded[n - 1].address);
+        if (recorded[n].address == 0x015a) {
+            EXPECT_EQ(recorded[n].value, 0x18); // jr 0150
+            EXPECT_EQ(recorded[n].pc, 0x015a);
+        }
+    }
+
+    // and cached again once the watchpoints are gone
+    instance->gb_mmu.clear_watchpoints();
+    instance->run(10 * loop_t_cycles);
+    EXPECT_EQ(instance->gb_mmu.watches.hit_count, 30);
+}
+
+// a stop watchpoint ends run() where it's hit, the next run() goes on
+TEST_P(WatchpointTest, stop) {
+    std::unique_ptr<gameboy> instance = boot(GetParam());
+    watchpoints::watchpoint watch{0xc001, 0xc001, watchpoints::write};
+    watch.stop = true;
+    instance->gb_mmu.add_watchpoint(watch);
+
+    instance->run(100 * loop_t_cycles);
+    ASSERT_EQ(instance->gb_mmu.watches.hit_count, 1);
+    EXPECT_TRUE(instance->gb_mmu.watches.stopped);
+    const watchpoints::hit first = instance->gb_mmu.watches.hits[0];
+    EXPECT_LT(instance->clock, 2 * loop_t_cycles);
+    EXPECT_GE(instance->clock, first.cycle);
+    EXPECT_LE(instance->clock - first.cycle, 4); // the rest of the M-cycle
+
+    instance->gb_mmu.watches.stopped = false;
+    instance->run(100 * loop_t_cycles);
+    ASSERT_EQ(instance->gb_mmu.watches.hit_count, 2);
+    EXPECT_EQ(instance->gb_mmu.watches.hits[1].cycle - first.cycle,
+              loop_t_cycles);
+    EXPECT_LE(instance->clock - instance->gb_mmu.watches.hits[1].cycle, 4);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    watchpoints, WatchpointTest,
+    testing::Values(gameboy::execution_mode::accurate,
+                    gameboy::execution_mode::fast),
+    [](const testing::TestParamInfo<gameboy::execution_mode> &info) {
+        return std::string(info.param == gameboy::execution_mode::fast
+                               ? "fast"
+                               : "accurate");
+    });
@@ -0,0 +1,586 @@
+// riceboy-aot - ahead-of-time recompiler for RICEBOY_AOT builds. follows the
+// code reachable from a rom's entry points, writes the register only prefix of
+// every block it finds as C++ (<rom>.aot.cpp) and builds <rom>.aot.so from it
+//
+// usage: riceboy-aot <rom> [--emit-only]
+//
+// the plugin is built with $CXX (or the compiler riceboy-aot was built with),
+// which has to take gcc style options
+//
+// a block is what the cpu's block cache would decode at the same (bank, pc):
+// it ends at a jump, call, return, rst, halt or stop and at the end of a page.
+// blocks are translated up to the first instruction touching memory (or
+// interrupts), the interpreter runs the rest
+
+#include "aot.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifndef RICEBOY_AOT_CXX
+#define RICEBOY_AOT_CXX "c++"
+#endif
+#ifndef RICEBOY_AOT_INCLUDE
+#define RICEBOY_AOT_INCLUDE "."
+#endif
+
+namespace {
+
+constexpr uint32_t bank_size{0x4000};
+
+// same limit as the jit, keeps the cycle count in a byte and bounds how late
+// an interrupt can be taken
+constexpr uint8_t max_block_instructions{64};
+
+// the rom with a bank mapped in at 0x4000, bank 0 below
+struct rom_image {
+    std::vector<char> bytes{};
+    uint16_t banks{0};
+
+    // -1 past the end of the rom
+    int read(const uint16_t bank, const uint16_t pc) const {
+        const uint32_t offset = bank * bank_size + (pc & (bank_size - 1));
+        if (offset >= this->bytes.size()) {
+            return -1;
+        }
+        return static_cast<uint8_t>(this->bytes[offset]);
+    }
+};
+
+// byte lengths, as the cpu's instruction table has them (stop is 1)
+uint8_t length(const uint8_t opcode) {
+    switch (opcode) {
+    case 0x01: case 0x08: case 0x11: case 0x21: case 0x31:
+    case 0xc2: case 0xc3: case 0xc4: case 0xca: case 0xcc: case 0xcd:
+    case 0xd2: case 0xd4: case 0xda: case 0xdc: case 0xea: case 0xfa:
+        return 3;
+    case 0x06: case 0x0e: case 0x16: case 0x1e: case 0x26: case 0x2e:
+    case 0x36: case 0x3e: case 0x18: case 0x20: case 0x28: case 0x30:
+    case 0x38: case 0xc6: case 0xce: case 0xd6: case 0xde: case 0xe6:
+    case 0xee: case 0xf6: case 0xfe: case 0xe0: case 0xf0: case 0xe8:
+    case 0xf8: case 0xcb:
+        return 2;
+    default: return 1;
+    }
+}
+
+// instructions that may leave straight-line code, they end a block
+bool ends_block(const uint8_t opcode) {
+    return opcode == 0x10 || opcode == 0x18 || (opcode & 0xe7) == 0x20 ||
+           opcode == 0x76 || (opcode & 0xe7) == 0xc0 || opcode == 0xc9 ||
+           opcode == 0xd9 || opcode == 0xe9 || (opcode & 0xe7) == 0xc2 ||
+           opcode == 0xc3 || (opcode & 0xe7) == 0xc4 || opcode == 0xcd ||
+           (opcode & 0xc7) == 0xc7;
+}
+
+// never falls through to the next instruction
+bool unconditional(const uint8_t opcode) {
+    return opcode == 0x18 || opcode == 0xc3 || opcode == 0xc9 ||
+           opcode == 0xd9 || opcode == 0xe9;
+}
+
+// the cpu locks up on these
+bool invalid(const uint8_t opcode) {
+    switch (opcode) {
+    case 0xd3: case 0xdb: case 0xdd: case 0xe3: case 0xe4: case 0xeb:
+    case 0xec: case 0xed: case 0xf4: case 0xfc: case 0xfd:
+        return true;
+    default: return false;
+    }
+}
+
+uint32_t key(const uint16_t bank, const uint16_t pc) {
+    return (bank << 16) | pc;
+}
+
+// block starts reachable from the entry points: branch targets, whatever
+// follows a block ending instruction, and the first instruction on a new page
+class explorer {
+  public:
+    explicit explorer(const rom_image &rom) : rom(rom) {}
+
+    std::set<uint32_t> explore() {
+        // reset, rst and interrupt vectors, the cartridge entry point
+        for (uint16_t vector = 0; vector <= 0x60; vector += 8) {
+            this->_start(0, vector);
+        }
+        this->_start(0, 0x0100);
+
+        while (!this->work.empty()) {
+            const uint32_t next = this->work.back();
+            this->work.pop_back();
+            this->_walk(next >> 16, next & 0xffff);
+        }
+        return this->starts;
+    }
+
+  private:
+    const rom_image &rom;
+    std::set<uint32_t> starts{};
+    std::set<uint32_t> visited{};
+    std::vector<uint32_t> work{};
+
+    // the bank is only known for code within a switchable bank, code in
+    // bank 0 reaching into it could land in any of them
+    void _start(const uint16_t bank, const uint16_t pc) {
+        if (pc > 0x7fff) {
+            return; // ram, left to the interpreter
+        }
+        if (pc >= 0x4000 && bank == 0) {
+            for (uint16_t b = 1; b < this->rom.banks; ++b) {
+                this->_start(b, pc);
+            }
+            return;
+        }
+        const uint32_t start = key(pc < 0x4000 ? 0 : bank, pc);
+        if (this->starts.insert(start).second) {
+            this->work.push_back(start);
+        }
+    }
+
+    void _walk(const uint16_t bank, uint16_t pc) {
+        while (this->visited.insert(key(bank, pc)).second) {
+            const int opcode = this->rom.read(bank, pc);
+            if (opcode < 0 || invalid(opcode)) {
+                return;
+            }
+            const uint8_t bytes = length(opcode);
+            // operands must not run out of the bank
+            if ((pc >> 14) != ((pc + bytes - 1) >> 14)) {
+                return;
+            }
+            const int n = this->rom.read(bank, pc + 1);
+            const uint16_t nn =
+                (n & 0xff) | (this->rom.read(bank, pc + 2) << 8);
+            const uint16_t next = pc + bytes;
+
+            if (opcode == 0x18 || (opcode & 0xe7) == 0x20) {
+                this->_start(bank, next + static_cast<int8_t>(n));
+            } else if (opcode == 0xc3 || (opcode & 0xe7) == 0xc2 ||
+                       opcode == 0xcd || (opcode & 0xe7) == 0xc4) {
+                this->_start(bank, nn);
+            } else if ((opcode & 0xc7) == 0xc7) {
+                this->_start(0, opcode & 0x38);
+            }
+
+            if (ends_block(opcode)) {
+                if (!unconditional(opcode)) {
+                    this->_start(bank, next);
+                }
+                return;
+            }
+            if ((next >> 8) != (pc >> 8)) {
+                this->_start(bank, next);
+                return;
+            }
+            pc = next;
+        }
+    }
+};
+
+const char *const r8[8]{"B", "C", "D", "E", "H", "L", nullptr, "A"};
+const char *const rp[4]{"BC", "DE", "HL", "SP"};
+const char *const alu_names[8]{"add", "adc", "sub", "sbc", "logic_and",
+                               "logic_xor", "logic_or", "cp"};
+const char *const rot_names[8]{"rlc", "rrc", "rl", "rr",
+                               "sla", "sra", "swap", "srl"};
+// Z/NZ/C/NC from y & 3, as C++ on the registers
+const char *const conditions[4]{"!(r->F & flag_z)", "r->F & flag_z",
+                                "!(r->F & flag_c)", "r->F & flag_c"};
+
+std::string format(const char *pattern, ...) {
+    char text[256];
+    va_list arguments;
+    va_start(arguments, pattern);
+    std::vsnprintf(text, sizeof(text), pattern, arguments);
+    va_end(arguments);
+    return text;
+}
+
+// one instruction as C++. false if it is not register only. branches write
+// their own exits and set exited
+struct translation {
+    std::string code{};
+    uint8_t m_cycles{0}; // including the fetch, branch not taken
+    bool exited{false};
+};
+
+bool translate(const rom_image &rom, const uint16_t bank, const uint16_t pc,
+               const uint8_t cycles, translation &out) {
+    const uint8_t opcode = rom.read(bank, pc);
+    const uint8_t x = (opcode >> 6) & 3;
+    const uint8_t y = (opcode >> 3) & 7;
+    const uint8_t z = opcode & 7;
+    const uint8_t p = y >> 1;
+    const uint8_t q = y % 2;
+    const uint8_t n = rom.read(bank, pc + 1);
+    const uint16_t nn = n | (rom.read(bank, pc + 2) << 8);
+    const uint16_t next = pc + length(opcode);
+
+    // PC and the M-cycles at an exit
+    const auto exit = [&](const uint16_t target, const uint8_t m_cycles) {
+        return format("r->PC = 0x%04x; return %d;", target,
+                      cycles + m_cycles);
+    };
+    const auto branch = [&](const uint8_t cc, const uint16_t target,
+                            const uint8_t taken, const uint8_t not_taken) {
+        out.code = format("if (%s) { %s }\n    %s", conditions[cc],
+                          exit(target, taken).c_str(),
+                          exit(next, not_taken).c_str());
+        out.exited = true;
+    };
+
+    out.m_cycles = 1;
+    switch (x) {
+    case 0:
+        switch (z) {
+        case 0:
+            if (y == 0) {
+                out.code = "// nop";
+                return true;
+            }
+            if (y == 3) {
+                out.code = exit(next + static_cast<int8_t>(n), 3);
+                out.exited = true;
+                return true;
+            }
+            if (y >= 4) {
+                branch(y - 4, next + static_cast<int8_t>(n), 3, 2);
+                return true;
+            }
+            return false; // ld (a16), sp and stop
+
+        case 1:
+            out.m_cycles = q == 0 ? 3 : 2;
+            out.code = q == 0 ? format("r->%s = 0x%04x;", rp[p], nn)
+                              : format("add_hl(*r, r->%s);", rp[p]);
+            return true;
+
+        case 3:
+            out.m_cycles = 2;
+            out.code = format("r->%s%s;", rp[p], q == 0 ? "++" : "--");
+            return true;
+
+        case 4:
+        case 5:
+            if (y == 6) {
+                return false;
+            }
+            out.code = format("r->%s = %s(*r, r->%s);", r8[y],
+                              z == 4 ? "inc" : "dec", r8[y]);
+            return true;
+
+        case 6:
+            if (y == 6) {
+                return false;
+            }
+            out.m_cycles = 2;
+            out.code = format("r->%s = 0x%02x;", r8[y], n);
+            return true;
+
+        case 7: {
+            const char *const ops[8]{"rot_a<rlc>", "rot_a<rrc>", "rot_a<rl>",
+                                     "rot_a<rr>",  "daa",        "cpl",
+                                     "scf",        "ccf"};
+            out.code = format("%s(*r);", ops[y]);
+            return true;
+        }
+
+        default: return false; // loads through (bc), (de), (hl+), (hl-)
+        }
+
+    case 1:
+        // halt, ld (hl), r8 and ld r8, (hl) touch the bus
+        if (y == 6 || z == 6) {
+            return false;
+        }
+        out.code = format("r->%s = r->%s;", r8[y], r8[z]);
+        return true;
+
+    case 2:
+        if (z == 6) {
+            return false;
+        }
+        out.code = format("alu<%s>(*r, r->%s);", alu_names[y], r8[z]);
+        return true;
+
+    case 3:
+        switch (z) {
+        case 0:
+            if (y == 5) {
+                out.m_cycles = 4;
+                out.code = format("r->SP = add_sp(*r, 0x%02x);", n);
+                return true;
+            }
+            if (y == 7) {
+                out.m_cycles = 3;
+                out.code = format("r->HL = add_sp(*r, 0x%02x);", n);
+                return true;
+            }
+            return false;
+
+        case 1:
+            if (opcode == 0xe9) {
+                out.code = format("r->PC = r->HL; return %d;", cycles + 1);
+                out.exited = true;
+                return true;
+            }
+            if (opcode == 0xf9) {
+                out.m_cycles = 2;
+                out.code = "r->SP = r->HL;";
+                return true;
+            }
+            return false;
+
+        case 2:
+            if (y < 4) {
+                branch(y, nn, 4, 3);
+                return true;
+            }
+            return false;
+
+        case 3:
+            if (opcode == 0xc3) {
+                out.code = exit(nn, 4);
+                out.exited = true;
+                return true;
+            }
+            if (opcode == 0xcb) {
+                const uint8_t cb_y = (n >> 3) & 7;
+                const uint8_t cb_z = n & 7;
+                if (cb_z == 6) {
+                    return false;
+                }
+                out.m_cycles = 2;
+                switch (n >> 6) {
+                case 0:
+                    out.code = format("r->%s = rot<%s>(*r, r->%s);", r8[cb_z],
+                                      rot_names[cb_y], r8[cb_z]);
+                    break;
+                case 1:
+                    out.code = format("bit(*r, %d, r->%s);", cb_y, r8[cb_z]);
+                    break;
+                case 2:
+                    out.code = format("r->%s &= 0x%02x;", r8[cb_z],
+                                      static_cast<uint8_t>(~(1 << cb_y)));
+                    break;
+                case 3:
+                    out.code = format("r->%s |= 0x%02x;", r8[cb_z], 1 << cb_y);
+                    break;
+                }
+                return true;
+            }
+            return false; // di, ei
+
+        case 6:
+            out.m_cycles = 2;
+            out.code = format("alu<%s>(*r, 0x%02x);", alu_names[y], n);
+            return true;
+
+        default: return false; // calls, returns, pushes, pops, rst, ldh
+        }
+    }
+    return false;
+}
+
+// the C++ function for the block at (bank, pc), empty if its first
+// instruction is not register only
+std::string compile_block(const rom_image &rom, const uint16_t bank,
+                          const uint16_t start, uint8_t &instructions) {
+    const uint8_t page = start >> 8;
+    std::string body{};
+    uint8_t cycles{0};
+    uint16_t pc = start;
+    uint16_t end = start; // past the last instruction translated
+    instructions = 0;
+    bool exited{false};
+
+    while (instructions < max_block_instructions) {
+        const int opcode = rom.read(bank, pc);
+        if (opcode < 0) {
+            break;
+        }
+        const uint8_t bytes = length(opcode);
+        if ((pc >> 14) != ((pc + bytes - 1) >> 14)) {
+            break;
+        }
+        // the cpu leaves a cb opcode split over two pages out of the block
+        if (opcode == 0xcb && ((pc + 1) >> 8) != page) {
+            break;
+        }
+
+        translation t{};
+        if (!translate(rom, bank, pc, cycles, t)) {
+            break;
+        }
+        instructions++;
+
+        // address, opcode and M-cycles
+        const std::string text =
+            opcode == 0xcb ? format("cb %02x", rom.read(bank, pc + 1))
+                           : format("%02x", opcode);
+        body += t.exited ? format("    // %04x: %s, exits\n", pc, text.c_str())
+                         : format("    // %04x: %s, %d M-cycle%s\n", pc,
+                                  text.c_str(), t.m_cycles,
+                                  t.m_cycles == 1 ? "" : "s");
+        body += "    " + t.code + "\n";
+        if (t.exited) {
+            exited = true;
+            break;
+        }
+
+        cycles += t.m_cycles;
+        end = pc + bytes;
+        if (ends_block(opcode) || (end >> 8) != page || cycles > 0xff - 4) {
+            break;
+        }
+        pc = end;
+    }
+
+    if (!instructions) {
+        return {};
+    }
+    if (!exited) {
+        body += format("    r->PC = 0x%04x;\n    return %d;\n", end, cycles);
+    }
+    return format("uint8_t block_%02x_%04x(aot::registers *r) {\n", bank,
+                  start) +
+           body + "}\n";
+}
+
+// runs the compiler with the arguments as they are, no shell sees the paths
+bool run(const std::vector<std::string> &arguments) {
+#ifdef _WIN32
+    // _spawnvp joins the arguments into one command line again, quote them
+    // and refuse quotes inside them
+    std::vector<std::string> quoted{};
+    for (const std::string &argument : arguments) {
+        if (argument.find('"') != std::string::npos) {
+            std::cerr << "riceboy-aot: " << argument << ": quote in a path\n";
+            return false;
+        }
+        quoted.push_back('"' + argument + '"');
+    }
+    std::vector<const char *> argv{};
+    for (const std::string &argument : quoted) {
+        argv.push_back(argument.c_str());
+    }
+    argv.push_back(nullptr);
+    return _spawnvp(_P_WAIT, arguments[0].c_str(), argv.data()) == 0;
+#else
+    std::vector<char *> argv{};
+    for (const std::string &argument : arguments) {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+    const pid_t child = fork();
+    if (child == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status{0};
+    return child > 0 && waitpid(child, &status, 0) == child &&
+           WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: riceboy-aot <rom> [--emit-only]\n";
+        return 1;
+    }
+    const std::string path = argv[1];
+    const bool emit_only = argc > 2 && std::string(argv[2]) == "--emit-only";
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << path << ": can't open\n";
+        return 1;
+    }
+    rom_image rom{};
+    rom.bytes.assign(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+    rom.banks = static_cast<uint16_t>(rom.bytes.size() / bank_size);
+    if (rom.banks < 2) {
+        std::cerr << path << ": too small for a rom\n";
+        return 1;
+    }
+
+    const std::set<uint32_t> starts = explorer(rom).explore();
+
+    const std::string plugin = aot::plugin_path(path);
+    const std::string source = plugin.substr(0, plugin.find_last_of('.')) +
+                               ".cpp";
+    std::ofstream out(source);
+    out << "// generated by riceboy-aot from " << path << ", do not edit\n"
+        << "#include \"aot_ops.h\"\n\nusing namespace aot_ops;\n\n"
+        << "namespace {\n\n";
+
+    std::vector<std::string> table{};
+    for (const uint32_t start : starts) {
+        const uint16_t bank = start >> 16;
+        const uint16_t pc = start & 0xffff;
+        uint8_t instructions{0};
+        const std::string function = compile_block(rom, bank, pc, instructions);
+        if (function.empty()) {
+            continue;
+        }
+        out << function << '\n';
+        table.push_back(format("    {0x%02x, 0x%04x, %d, block_%02x_%04x},",
+                               bank, pc, instructions, bank, pc));
+    }
+
+    out << "} // namespace\n\n"
+        << "RICEBOY_AOT_EXPORT const uint32_t riceboy_aot_abi = "
+           "aot::abi_version;\n"
+        << format("RICEBOY_AOT_EXPORT const uint64_t riceboy_aot_rom_hash = "
+                  "0x%016llxull;\n",
+                  static_cast<unsigned long long>(shared_code::rom_hash(
+                      rom.bytes.data(), rom.bytes.size())))
+        << "RICEBOY_AOT_EXPORT const uint32_t riceboy_aot_entry_count = "
+        << table.size() << ";\n"
+        << "RICEBOY_AOT_EXPORT const aot::entry riceboy_aot_entries[] = {\n";
+    for (const std::string &row : table) {
+        out << row << '\n';
+    }
+    if (table.empty()) {
+        out << "    {0, 0, 0, nullptr},\n";
+    }
+    out << "};\n";
+    out.close();
+
+    std::cout << source << ": " << table.size() << " blocks from "
+              << starts.size() << " block starts\n";
+    if (emit_only) {
+        return 0;
+    }
+
+    const char *cxx = std::getenv("CXX");
+    const std::vector<std::string> command{
+        cxx ? cxx : RICEBOY_AOT_CXX, "-std=c++17", "-O2", "-shared", "-fPIC",
+        std::string("-I") + RICEBOY_AOT_INCLUDE, "-o", plugin, source};
+    for (const std::string &argument : command) {
+        std::cout << argument << (&argument == &command.back() ? '\n' : ' ');
+    }
+    if (!run(command)) {
+        std::cerr << "riceboy-aot: compiling " << source << " failed\n";
+        return 1;
+    }
+    std::cout << plugin << '\n';
+    return 0;
+}